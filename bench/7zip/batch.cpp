@@ -0,0 +1,127 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	boost::filesystem::path generateArchive(size_t numFolders, size_t filesPerFolder, size_t fileSize)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("batch_%1%_%2%_%3%.7z") % numFolders % filesPerFolder % fileSize).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		std::string content(fileSize, 'x');
+
+		SevenZipWriter writer;
+		for (size_t folder = 0; folder < numFolders; ++folder)
+		{
+			for (size_t file = 0; file < filesPerFolder; ++file)
+			{
+				writer.addFile((boost::format("folder%1%/file%2%.dat") % folder % file).str(), content);
+			}
+
+			writer.endFolder();
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+
+	void countBytes(boost::atomic<size_t>* total, const string_type&, const FileView& view)
+	{
+		// Touch the data like a loader would
+		size_t sum = 0;
+		for (size_t i = 0; i < view.size(); i += 4096)
+		{
+			sum += static_cast<unsigned char>(view.data()[i]);
+		}
+
+		total->fetch_add(view.size() + (sum & 1), boost::memory_order_relaxed);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFolders = sizeArgument(argc, argv, 1, 32);
+	size_t filesPerFolder = sizeArgument(argc, argv, 2, 64);
+	size_t fileSize = sizeArgument(argc, argv, 3, 64 * 1024);
+
+	boost::filesystem::path archivePath = generateArchive(numFolders, filesPerFolder, fileSize);
+
+	std::vector<string_type> paths;
+	for (size_t file = 0; file < filesPerFolder; ++file)
+	{
+		// Requests in an order unrelated to the solid blocks
+		for (size_t folder = 0; folder < numFolders; ++folder)
+		{
+			paths.push_back((boost::format("folder%1%/file%2%.dat") % folder % file).str());
+		}
+	}
+
+	{
+		SevenZipFileSystem fs(archivePath);
+		fs.setCacheSize(numFolders * filesPerFolder * fileSize);
+
+		std::vector<char> buffer(fileSize);
+
+		// Decodes the folders on the calling thread
+		Stopwatch watch;
+		BOOST_FOREACH(const string_type& path, paths)
+		{
+			fs.getRootEntry()->getChild(path)->readAt(0, &buffer[0], buffer.size());
+		}
+		printResult("readAt of every file", paths.size(), watch.elapsedMilliseconds());
+	}
+
+	{
+		SevenZipFileSystem fs(archivePath);
+		fs.setCacheSize(numFolders * filesPerFolder * fileSize);
+
+		boost::atomic<size_t> total(0);
+
+		// The archive only contains stored folders which are viewed in the mapped archive
+		Stopwatch watch;
+		BOOST_FOREACH(const string_type& path, paths)
+		{
+			FileView view;
+			fs.getRootEntry()->getChild(path)->getView(view);
+
+			countBytes(&total, path, view);
+		}
+		printResult("getView of every file", paths.size(), watch.elapsedMilliseconds());
+	}
+
+	size_t threadCounts[] = { 1, 0 };
+	BOOST_FOREACH(size_t numThreads, threadCounts)
+	{
+		SevenZipFileSystem fs(archivePath);
+		fs.setCacheSize(numFolders * filesPerFolder * fileSize);
+
+		boost::atomic<size_t> total(0);
+
+		Stopwatch watch;
+		fs.extractFiles(paths, boost::bind(countBytes, &total, _1, _2), numThreads);
+
+		size_t threads = numThreads == 0 ? boost::thread::hardware_concurrency() : numThreads;
+		printResult((boost::format("extractFiles, %1% threads") % threads).str(), paths.size(), watch.elapsedMilliseconds());
+	}
+
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	const size_t FilesPerFolder = 256;
+
+	boost::filesystem::path generateArchive(size_t numFolders, size_t folderSize)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("cache_%1%_%2%.7z") % numFolders % folderSize).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		std::string content(folderSize / FilesPerFolder, 'x');
+
+		SevenZipWriter writer;
+		for (size_t folder = 0; folder < numFolders; ++folder)
+		{
+			for (size_t file = 0; file < FilesPerFolder; ++file)
+			{
+				writer.addFile((boost::format("folder%1%/file%2%.dat") % folder % file).str(), content);
+			}
+
+			writer.endFolder();
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+
+	// Reads one file of every folder in turn, which is the worst case for a single block cache
+	void readInterleaved(SevenZipFileSystem& fs, size_t numFolders, size_t numReads)
+	{
+		SevenZipFileEntry* root = fs.getRootEntry();
+
+		for (size_t i = 0; i < numReads; ++i)
+		{
+			size_t folder = i % numFolders;
+			size_t file = (i / numFolders) % FilesPerFolder;
+
+			boost::shared_ptr<std::streambuf> buffer = root->getChild((boost::format("folder%1%/file%2%.dat") % folder % file).str())->open();
+			buffer->pubseekoff(0, std::ios::end);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFolders = sizeArgument(argc, argv, 1, 4);
+	size_t folderSize = sizeArgument(argc, argv, 2, 8 * 1024 * 1024);
+	size_t numReads = sizeArgument(argc, argv, 3, 2000);
+
+	boost::filesystem::path archivePath = generateArchive(numFolders, folderSize);
+
+	size_t cacheSizes[] = { 0, numFolders * folderSize };
+
+	BOOST_FOREACH(size_t cacheSize, cacheSizes)
+	{
+		SevenZipFileSystem fs(archivePath);
+		fs.setCacheSize(cacheSize);
+
+		Stopwatch watch;
+		readInterleaved(fs, numFolders, numReads);
+		printResult((boost::format("interleaved reads, cache %1% bytes") % cacheSize).str(), numReads, watch.elapsedMilliseconds());
+
+		FolderCacheStatistics stats = fs.getCacheStatistics();
+		std::cout << "  hits " << stats.hits << ", misses " << stats.misses << ", evictions " << stats.evictions << std::endl;
+	}
+
+	return 0;
+}
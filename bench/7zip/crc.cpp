@@ -0,0 +1,79 @@
+#include <7zCrc.h>
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "common.hpp"
+
+using namespace vfspp::bench;
+
+namespace
+{
+	const char* implName(ECrcImpl impl)
+	{
+		switch (impl)
+		{
+		case CRC_IMPL_TABLE:
+			return "table";
+		case CRC_IMPL_CLMUL:
+			return "clmul";
+		}
+
+		return "unknown";
+	}
+
+	void measure(ECrcImpl impl, const std::vector<unsigned char>& data, size_t bufferSize, size_t totalBytes)
+	{
+		size_t iterations = std::max<size_t>(totalBytes / bufferSize, 1);
+
+		// Keeps the compiler from dropping the calculations
+		UInt32 checksum = 0;
+
+		Stopwatch watch;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			checksum += CrcCalc(&data[(i * 8) % 64], bufferSize);
+		}
+		double elapsed = watch.elapsedMilliseconds();
+
+		printResult((boost::format("%1% %2% bytes") % implName(impl) % bufferSize).str(), iterations, elapsed);
+		std::cout << "  " << (iterations * bufferSize) / (elapsed * 1000.0) << " MB/s (" << std::hex << checksum << std::dec << ")" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t totalBytes = sizeArgument(argc, argv, 1, 256 * 1024 * 1024);
+
+	CrcGenerateTable();
+
+	std::cout << "Default implementation: " << implName(CrcGetImpl()) << std::endl;
+
+	size_t bufferSizes[] = { 16, 64, 256, 1024, 4096, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+
+	std::vector<unsigned char> data(16 * 1024 * 1024 + 64);
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<unsigned char>(i * 2654435761U >> 24);
+	}
+
+	ECrcImpl impls[] = { CRC_IMPL_TABLE, CRC_IMPL_CLMUL };
+	for (size_t impl = 0; impl < sizeof(impls) / sizeof(impls[0]); ++impl)
+	{
+		if (!CrcSetImpl(impls[impl]))
+		{
+			std::cout << implName(impls[impl]) << " is not supported" << std::endl;
+			continue;
+		}
+
+		for (size_t size = 0; size < sizeof(bufferSizes) / sizeof(bufferSizes[0]); ++size)
+		{
+			measure(impls[impl], data, bufferSizes[size], totalBytes);
+		}
+	}
+
+	return 0;
+}
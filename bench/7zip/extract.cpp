@@ -0,0 +1,79 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "allocations.hpp"
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	boost::filesystem::path generateArchive(size_t numFiles, size_t fileSize)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("extract_%1%_%2%.7z") % numFiles % fileSize).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		std::string content(fileSize, 'x');
+
+		// All files are stored in a single solid block
+		SevenZipWriter writer;
+		for (size_t file = 0; file < numFiles; ++file)
+		{
+			writer.addFile((boost::format("file%1%.dat") % file).str(), content);
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 10000);
+	size_t fileSize = sizeArgument(argc, argv, 2, 4096);
+
+	boost::filesystem::path archivePath = generateArchive(numFiles, fileSize);
+
+	SevenZipFileSystem fs(archivePath);
+
+	std::vector<FileEntryPointer> entries;
+	fs.getRootEntry()->listChildren(entries);
+
+	std::vector<char> chunk(fileSize);
+
+	AllocationCounts before = allocationCounts();
+	Stopwatch watch;
+
+	BOOST_FOREACH(const FileEntryPointer& entry, entries)
+	{
+		boost::shared_ptr<std::streambuf> buffer = entry->open();
+
+		while (buffer->sgetn(&chunk[0], chunk.size()) > 0)
+		{
+		}
+	}
+
+	double elapsed = watch.elapsedMilliseconds();
+	AllocationCounts counts = allocationCounts() - before;
+
+	printResult("open and read every file", entries.size(), elapsed);
+	std::cout << "  " << counts.allocations << " allocations (" << static_cast<double>(counts.allocations) / entries.size()
+		<< " per file), " << counts.bytes << " bytes (" << static_cast<double>(counts.bytes) / entries.size() << " per file)" << std::endl;
+
+	FolderCacheStatistics stats = fs.getCacheStatistics();
+	std::cout << "  hits " << stats.hits << ", misses " << stats.misses << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "allocations.hpp"
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	// Three levels of directories with 100 entries each, so most of every path is a shared prefix
+	boost::filesystem::path generateArchive(size_t numFiles)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("footprint_%1%.7z") % numFiles).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		SevenZipWriter writer;
+		for (size_t file = 0; file < numFiles; ++file)
+		{
+			writer.addFile((boost::format("directory%1%/subdirectory%2%/file%3%.dat") % (file / 10000) % (file / 100 % 100) % file).str(), "x");
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 1000000);
+
+	boost::filesystem::path archivePath = generateArchive(numFiles);
+
+	// The archive database of the 7-zip library is allocated with malloc and not included
+	AllocationCounts before = allocationCounts();
+	Stopwatch watch;
+
+	SevenZipFileSystem fs(archivePath);
+
+	double milliseconds = watch.elapsedMilliseconds();
+	AllocationCounts counts = allocationCounts() - before;
+
+	printResult("opening archive", numFiles, milliseconds);
+	std::cout << "  " << counts.liveBytes << " bytes, " << counts.liveBytes / numFiles << " bytes per entry, "
+		<< counts.allocations / numFiles << " allocations per entry" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	boost::filesystem::path generateArchive(size_t numFiles, size_t fileSize)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("open_%1%_%2%.7z") % numFiles % fileSize).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		std::string content(fileSize, 'x');
+
+		// Folders of 16 MiB so the data is decoded in a few large blocks
+		size_t filesPerFolder = std::max<size_t>(16 * 1024 * 1024 / std::max<size_t>(fileSize, 1), 1);
+
+		SevenZipWriter writer;
+		for (size_t file = 0; file < numFiles; ++file)
+		{
+			writer.addFile((boost::format("dir%1%/file%2%.dat") % (file % 256) % file).str(), content);
+
+			if ((file + 1) % filesPerFolder == 0)
+			{
+				writer.endFolder();
+			}
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+
+	void run(const boost::filesystem::path& archivePath, bool mapArchive, const std::string& name, size_t repetitions)
+	{
+		Stopwatch watch;
+		for (size_t i = 0; i < repetitions; ++i)
+		{
+			SevenZipFileSystem fs(archivePath, mapArchive);
+		}
+		printResult(name + " open", repetitions, watch.elapsedMilliseconds());
+
+		SevenZipFileSystem fs(archivePath, mapArchive);
+
+		// Every folder is read through the input stream and decoded once
+		watch.restart();
+		bool valid = fs.verifyArchive(NULL, 1);
+		double milliseconds = watch.elapsedMilliseconds();
+
+		printResult(name + " decode", static_cast<size_t>(boost::filesystem::file_size(archivePath)), milliseconds);
+		std::cout << "  " << (boost::filesystem::file_size(archivePath) / (1024.0 * 1024.0)) / (milliseconds / 1000.0)
+			<< " MiB/s" << (valid ? "" : ", archive is corrupted") << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 100000);
+	size_t fileSize = sizeArgument(argc, argv, 2, 2048);
+	size_t repetitions = sizeArgument(argc, argv, 3, 10);
+
+	// An existing archive may be passed to measure LZMA blocks and compressed headers
+	boost::filesystem::path archivePath = argc > 4 ? boost::filesystem::path(argv[4]) : generateArchive(numFiles, fileSize);
+
+	run(archivePath, false, "buffered", repetitions);
+	run(archivePath, true, "mapped", repetitions);
+
+	return 0;
+}
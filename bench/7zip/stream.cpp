@@ -0,0 +1,90 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	boost::filesystem::path generateArchive(size_t blockSize, size_t numFiles)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("stream_%1%_%2%.7z") % blockSize % numFiles).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		std::string content(blockSize / numFiles, 'x');
+
+		SevenZipWriter writer;
+		for (size_t file = 0; file < numFiles; ++file)
+		{
+			writer.addFile((boost::format("file%1%.dat") % file).str(), content);
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+
+	void readEntry(SevenZipFileSystem& fs, const std::string& path, int mode, const std::string& name)
+	{
+		Stopwatch watch;
+
+		boost::shared_ptr<std::streambuf> buffer = fs.getRootEntry()->getChild(path)->open(mode);
+		buffer->sgetc();
+
+		double firstByte = watch.elapsedMilliseconds();
+
+		char chunk[4096];
+		size_t total = 0;
+		std::streamsize read;
+		while ((read = buffer->sgetn(chunk, sizeof(chunk))) > 0)
+		{
+			total += static_cast<size_t>(read);
+		}
+
+		printResult(name, total, watch.elapsedMilliseconds());
+		std::cout << "  first byte after " << firstByte << " ms, peak memory " << peakMemory() << " KiB" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t blockSize = sizeArgument(argc, argv, 1, 64 * 1024 * 1024);
+	size_t numFiles = sizeArgument(argc, argv, 2, 16);
+
+	// An existing archive and entry may be passed to measure LZMA blocks, the generated archive is stored
+	boost::filesystem::path archivePath;
+	std::string entryPath;
+	if (argc > 4)
+	{
+		archivePath = argv[3];
+		entryPath = argv[4];
+	}
+	else
+	{
+		archivePath = generateArchive(blockSize, numFiles);
+		entryPath = (boost::format("file%1%.dat") % (numFiles - 1)).str();
+	}
+
+	// Streaming runs first as the peak memory of the process can only grow
+	{
+		SevenZipFileSystem fs(archivePath);
+		readEntry(fs, entryPath, IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_STREAMED, "streamed read");
+	}
+	{
+		SevenZipFileSystem fs(archivePath);
+		readEntry(fs, entryPath, IFileSystemEntry::MODE_READ, "extracted read");
+	}
+
+	return 0;
+}
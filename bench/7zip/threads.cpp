@@ -0,0 +1,92 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	const size_t FilesPerFolder = 64;
+
+	boost::filesystem::path generateArchive(size_t numFolders, size_t folderSize)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("threads_%1%_%2%.7z") % numFolders % folderSize).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		std::string content(folderSize / FilesPerFolder, 'x');
+
+		SevenZipWriter writer;
+		for (size_t folder = 0; folder < numFolders; ++folder)
+		{
+			for (size_t file = 0; file < FilesPerFolder; ++file)
+			{
+				writer.addFile((boost::format("folder%1%/file%2%.dat") % folder % file).str(), content);
+			}
+
+			writer.endFolder();
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+
+	// Every thread reads all files of the folders assigned to it
+	void readFolders(SevenZipFileSystem* fs, size_t numFolders, size_t thread, size_t numThreads)
+	{
+		SevenZipFileEntry* root = fs->getRootEntry();
+
+		for (size_t folder = thread; folder < numFolders; folder += numThreads)
+		{
+			for (size_t file = 0; file < FilesPerFolder; ++file)
+			{
+				boost::shared_ptr<std::streambuf> buffer = root->getChild((boost::format("folder%1%/file%2%.dat") % folder % file).str())->open();
+				buffer->pubseekoff(0, std::ios::end);
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFolders = sizeArgument(argc, argv, 1, 64);
+	size_t folderSize = sizeArgument(argc, argv, 2, 4 * 1024 * 1024);
+	size_t maxThreads = sizeArgument(argc, argv, 3, std::max(1U, boost::thread::hardware_concurrency()));
+
+	boost::filesystem::path archivePath = generateArchive(numFolders, folderSize);
+
+	for (size_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		SevenZipFileSystem fs(archivePath);
+
+		Stopwatch watch;
+
+		boost::thread_group threads;
+		for (size_t i = 0; i < numThreads; ++i)
+		{
+			threads.create_thread(boost::bind(readFolders, &fs, numFolders, i, numThreads));
+		}
+		threads.join_all();
+
+		double milliseconds = watch.elapsedMilliseconds();
+
+		printResult((boost::format("read archive with %1% threads") % numThreads).str(), numFolders * FilesPerFolder, milliseconds);
+		std::cout << "  " << (numFolders * folderSize / (1024.0 * 1024.0)) / (milliseconds / 1000.0) << " MiB/s" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	boost::filesystem::path generateArchive(size_t numFolders, size_t filesPerFolder, size_t fileSize)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("verify_%1%_%2%_%3%.7z") % numFolders % filesPerFolder % fileSize).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		std::string content(fileSize, 'x');
+
+		SevenZipWriter writer;
+		for (size_t folder = 0; folder < numFolders; ++folder)
+		{
+			for (size_t file = 0; file < filesPerFolder; ++file)
+			{
+				// Different content for every file so a wrong offset can't go unnoticed
+				content[0] = static_cast<char>(file);
+				content[content.size() - 1] = static_cast<char>(folder);
+
+				writer.addFile((boost::format("folder%1%/file%2%.dat") % folder % file).str(), content);
+			}
+
+			writer.endFolder();
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFolders = sizeArgument(argc, argv, 1, 16);
+	size_t filesPerFolder = sizeArgument(argc, argv, 2, 64);
+	size_t fileSize = sizeArgument(argc, argv, 3, 64 * 1024);
+
+	boost::filesystem::path archivePath = generateArchive(numFolders, filesPerFolder, fileSize);
+
+	{
+		SevenZipFileSystem fs(archivePath);
+
+		std::vector<std::string> paths;
+		for (size_t folder = 0; folder < numFolders; ++folder)
+		{
+			for (size_t file = 0; file < filesPerFolder; ++file)
+			{
+				paths.push_back((boost::format("folder%1%/file%2%.dat") % folder % file).str());
+			}
+		}
+
+		// Every folder is decoded and checked once, all files are read from the cache
+		Stopwatch watch;
+		BOOST_FOREACH(const std::string& path, paths)
+		{
+			fs.getRootEntry()->getChild(path)->open()->sgetc();
+		}
+		printResult("first open of every file", paths.size(), watch.elapsedMilliseconds());
+
+		watch.restart();
+		BOOST_FOREACH(const std::string& path, paths)
+		{
+			fs.getRootEntry()->getChild(path)->open()->sgetc();
+		}
+		printResult("second open of every file", paths.size(), watch.elapsedMilliseconds());
+	}
+
+	size_t threadCounts[] = { 1, 0 };
+	BOOST_FOREACH(size_t numThreads, threadCounts)
+	{
+		SevenZipFileSystem fs(archivePath);
+
+		Stopwatch watch;
+		bool intact = fs.verifyArchive(NULL, numThreads);
+		double elapsed = watch.elapsedMilliseconds();
+
+		size_t threads = numThreads == 0 ? boost::thread::hardware_concurrency() : numThreads;
+		printResult((boost::format("verify archive, %1% threads") % threads).str(), numFolders, elapsed);
+		std::cout << "  " << (intact ? "intact" : "corrupted") << ", "
+			<< (numFolders * filesPerFolder * fileSize) / (elapsed * 1000.0) << " MB/s" << std::endl;
+	}
+
+	return 0;
+}
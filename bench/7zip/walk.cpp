@@ -0,0 +1,94 @@
+#include <VFSPP/7zip.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+using namespace vfspp::bench;
+
+namespace
+{
+	// Generates an archive with 100 files per directory in a three level hierarchy.
+	// No explicit directory entries are written so all directories are implicit.
+	boost::filesystem::path generateArchive(size_t numFiles)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("walk_%1%.7z") % numFiles).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		SevenZipWriter writer;
+		for (size_t i = 0; i < numFiles; ++i)
+		{
+			size_t leaf = i / 100;
+			size_t mid = leaf / 10;
+			size_t top = mid / 10;
+
+			writer.addFile((boost::format("top%1%/mid%2%/leaf%3%/file%4%.dat") % top % mid % leaf % i).str(), "0123456789abcdef");
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+
+	size_t walk(IFileSystemEntry* entry)
+	{
+		size_t count = 1;
+
+		if (entry->getType() == DIRECTORY)
+		{
+			std::vector<FileEntryPointer> children;
+			entry->listChildren(children);
+
+			BOOST_FOREACH(const FileEntryPointer& child, children)
+			{
+				count += walk(child.get());
+			}
+		}
+
+		return count;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<size_t> sizes;
+	if (argc > 1)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			sizes.push_back(sizeArgument(argc, argv, i, 0));
+		}
+	}
+	else
+	{
+		sizes.push_back(10000);
+		sizes.push_back(30000);
+		sizes.push_back(100000);
+		sizes.push_back(300000);
+	}
+
+	BOOST_FOREACH(size_t numFiles, sizes)
+	{
+		boost::filesystem::path archivePath = generateArchive(numFiles);
+
+		Stopwatch watch;
+		SevenZipFileSystem fs(archivePath);
+		printResult((boost::format("open %1% files") % numFiles).str(), numFiles, watch.elapsedMilliseconds());
+
+		watch.restart();
+		size_t entries = walk(fs.getRootEntry());
+		printResult((boost::format("walk %1% files") % numFiles).str(), entries, watch.elapsedMilliseconds());
+	}
+
+	return 0;
+}
@@ -0,0 +1,345 @@
+#include "SevenZipWriter.hpp"
+
+extern "C"
+{
+#include <7zCrc.h>
+}
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <VFSPP/core.hpp>
+
+namespace
+{
+	typedef std::string ByteBuffer;
+
+	void writeByte(ByteBuffer& out, unsigned char b)
+	{
+		out.push_back(static_cast<char>(b));
+	}
+
+	void writeUInt32(ByteBuffer& out, unsigned int value)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			writeByte(out, static_cast<unsigned char>(value >> (8 * i)));
+		}
+	}
+
+	void writeUInt64(ByteBuffer& out, unsigned long long value)
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			writeByte(out, static_cast<unsigned char>(value >> (8 * i)));
+		}
+	}
+
+	// 7-zip variable length number encoding, see 7zFormat.txt
+	void writeNumber(ByteBuffer& out, unsigned long long value)
+	{
+		unsigned char firstByte = 0;
+		unsigned char mask = 0x80;
+		int i;
+
+		for (i = 0; i < 8; i++)
+		{
+			if (value < (1ULL << (7 * (i + 1))))
+			{
+				firstByte |= static_cast<unsigned char>(value >> (8 * i));
+				break;
+			}
+			firstByte |= mask;
+			mask >>= 1;
+		}
+
+		writeByte(out, firstByte);
+
+		for (; i > 0; i--)
+		{
+			writeByte(out, static_cast<unsigned char>(value));
+			value >>= 8;
+		}
+	}
+
+	void writeBoolVector(ByteBuffer& out, const std::vector<bool>& values)
+	{
+		unsigned char b = 0;
+		unsigned char mask = 0x80;
+
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			if (values[i])
+			{
+				b |= mask;
+			}
+
+			mask >>= 1;
+			if (mask == 0)
+			{
+				writeByte(out, b);
+				mask = 0x80;
+				b = 0;
+			}
+		}
+
+		if (mask != 0x80)
+		{
+			writeByte(out, b);
+		}
+	}
+
+	void writeProperty(ByteBuffer& out, unsigned char id, const ByteBuffer& data)
+	{
+		writeByte(out, id);
+		writeNumber(out, data.size());
+		out.append(data);
+	}
+
+	unsigned int crc(const void* data, size_t size)
+	{
+		return CrcCalc(data, size);
+	}
+
+	enum
+	{
+		kEnd = 0x00,
+		kHeader = 0x01,
+		kMainStreamsInfo = 0x04,
+		kFilesInfo = 0x05,
+		kPackInfo = 0x06,
+		kUnpackInfo = 0x07,
+		kSubStreamsInfo = 0x08,
+		kSize = 0x09,
+		kCRC = 0x0A,
+		kFolder = 0x0B,
+		kCodersUnpackSize = 0x0C,
+		kNumUnpackStream = 0x0D,
+		kEmptyStream = 0x0E,
+		kEmptyFile = 0x0F,
+		kName = 0x11,
+		kMTime = 0x14
+	};
+
+	const unsigned long long WriteTime = 130763520000000000ULL; // Fixed modification time as Windows file time
+}
+
+namespace vfspp
+{
+	namespace bench
+	{
+		SevenZipWriter::SevenZipWriter()
+		{
+			CrcGenerateTable();
+		}
+
+		void SevenZipWriter::addDirectory(const std::string& name)
+		{
+			Entry entry;
+			entry.name = name;
+			entry.isDir = true;
+			entry.size = 0;
+			entry.crc = 0;
+
+			entries.push_back(entry);
+		}
+
+		void SevenZipWriter::addFile(const std::string& name, const std::string& content)
+		{
+			Entry entry;
+			entry.name = name;
+			entry.isDir = false;
+			entry.size = content.size();
+			entry.crc = crc(content.data(), content.size());
+
+			entries.push_back(entry);
+
+			if (content.empty())
+			{
+				// Empty files have no stream
+				return;
+			}
+
+			if (folders.empty())
+			{
+				folders.push_back(Folder());
+			}
+
+			Folder& folder = folders.back();
+			folder.data.append(content);
+			folder.sizes.push_back(content.size());
+			folder.crcs.push_back(entry.crc);
+		}
+
+		void SevenZipWriter::endFolder()
+		{
+			if (!folders.empty() && !folders.back().sizes.empty())
+			{
+				folders.push_back(Folder());
+			}
+		}
+
+		void SevenZipWriter::write(const boost::filesystem::path& path) const
+		{
+			std::vector<const Folder*> usedFolders;
+			for (size_t i = 0; i < folders.size(); ++i)
+			{
+				if (!folders[i].sizes.empty())
+				{
+					usedFolders.push_back(&folders[i]);
+				}
+			}
+
+			ByteBuffer packed;
+			for (size_t i = 0; i < usedFolders.size(); ++i)
+			{
+				packed.append(usedFolders[i]->data);
+			}
+
+			ByteBuffer header;
+			writeByte(header, kHeader);
+
+			if (!usedFolders.empty())
+			{
+				writeByte(header, kMainStreamsInfo);
+
+				writeByte(header, kPackInfo);
+				writeNumber(header, 0);
+				writeNumber(header, usedFolders.size());
+				writeByte(header, kSize);
+				for (size_t i = 0; i < usedFolders.size(); ++i)
+				{
+					writeNumber(header, usedFolders[i]->data.size());
+				}
+				writeByte(header, kEnd);
+
+				writeByte(header, kUnpackInfo);
+				writeByte(header, kFolder);
+				writeNumber(header, usedFolders.size());
+				writeByte(header, 0); // not external
+				for (size_t i = 0; i < usedFolders.size(); ++i)
+				{
+					writeNumber(header, 1); // one coder
+					writeByte(header, 0x01); // simple coder with an id of one byte
+					writeByte(header, 0x00); // copy method
+				}
+				writeByte(header, kCodersUnpackSize);
+				for (size_t i = 0; i < usedFolders.size(); ++i)
+				{
+					writeNumber(header, usedFolders[i]->data.size());
+				}
+				writeByte(header, kEnd);
+
+				writeByte(header, kSubStreamsInfo);
+				writeByte(header, kNumUnpackStream);
+				for (size_t i = 0; i < usedFolders.size(); ++i)
+				{
+					writeNumber(header, usedFolders[i]->sizes.size());
+				}
+				writeByte(header, kSize);
+				for (size_t i = 0; i < usedFolders.size(); ++i)
+				{
+					for (size_t j = 0; j + 1 < usedFolders[i]->sizes.size(); ++j)
+					{
+						writeNumber(header, usedFolders[i]->sizes[j]);
+					}
+				}
+				writeByte(header, kCRC);
+				writeByte(header, 1); // all defined
+				for (size_t i = 0; i < usedFolders.size(); ++i)
+				{
+					for (size_t j = 0; j < usedFolders[i]->crcs.size(); ++j)
+					{
+						writeUInt32(header, usedFolders[i]->crcs[j]);
+					}
+				}
+				writeByte(header, kEnd);
+
+				writeByte(header, kEnd);
+			}
+
+			writeByte(header, kFilesInfo);
+			writeNumber(header, entries.size());
+
+			std::vector<bool> emptyStreams;
+			std::vector<bool> emptyFiles;
+			bool hasEmptyStreams = false;
+			for (size_t i = 0; i < entries.size(); ++i)
+			{
+				bool empty = entries[i].isDir || entries[i].size == 0;
+
+				emptyStreams.push_back(empty);
+				if (empty)
+				{
+					hasEmptyStreams = true;
+					emptyFiles.push_back(!entries[i].isDir);
+				}
+			}
+
+			if (hasEmptyStreams)
+			{
+				ByteBuffer data;
+				writeBoolVector(data, emptyStreams);
+				writeProperty(header, kEmptyStream, data);
+
+				data.clear();
+				writeBoolVector(data, emptyFiles);
+				writeProperty(header, kEmptyFile, data);
+			}
+
+			{
+				ByteBuffer data;
+				writeByte(data, 0); // not external
+				for (size_t i = 0; i < entries.size(); ++i)
+				{
+					const std::string& name = entries[i].name;
+
+					// Only ASCII names are generated so a simple widening is enough
+					for (size_t j = 0; j < name.size(); ++j)
+					{
+						writeByte(data, static_cast<unsigned char>(name[j]));
+						writeByte(data, 0);
+					}
+					writeByte(data, 0);
+					writeByte(data, 0);
+				}
+				writeProperty(header, kName, data);
+			}
+
+			{
+				ByteBuffer data;
+				writeByte(data, 1); // all defined
+				writeByte(data, 0); // not external
+				for (size_t i = 0; i < entries.size(); ++i)
+				{
+					writeUInt64(data, WriteTime);
+				}
+				writeProperty(header, kMTime, data);
+			}
+
+			writeByte(header, kEnd);
+
+			writeByte(header, kEnd);
+
+			ByteBuffer startHeader;
+			writeUInt64(startHeader, packed.size());
+			writeUInt64(startHeader, header.size());
+			writeUInt32(startHeader, crc(header.data(), header.size()));
+
+			ByteBuffer signature;
+			const unsigned char signatureBytes[] = { '7', 'z', 0xBC, 0xAF, 0x27, 0x1C, 0, 3 };
+			signature.append(reinterpret_cast<const char*>(signatureBytes), sizeof(signatureBytes));
+			writeUInt32(signature, crc(startHeader.data(), startHeader.size()));
+			signature.append(startHeader);
+
+			boost::filesystem::ofstream out(path, std::ios::binary | std::ios::trunc);
+			if (!out)
+			{
+				throw FileSystemException("Failed to write archive " + path.string());
+			}
+
+			out.write(signature.data(), signature.size());
+			out.write(packed.data(), packed.size());
+			out.write(header.data(), header.size());
+		}
+	}
+}
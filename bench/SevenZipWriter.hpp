@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+namespace vfspp
+{
+	namespace bench
+	{
+		// Writes uncompressed 7-zip archives (copy method, unencoded header) for generating benchmark data.
+		// Every call to endFolder() starts a new solid block.
+		class SevenZipWriter
+		{
+		private:
+			struct Entry
+			{
+				std::string name;
+				bool isDir;
+				unsigned long long size;
+				unsigned int crc;
+			};
+
+			struct Folder
+			{
+				std::string data;
+				std::vector<unsigned long long> sizes;
+				std::vector<unsigned int> crcs;
+			};
+
+			std::vector<Entry> entries;
+			std::vector<Folder> folders;
+
+		public:
+			SevenZipWriter();
+
+			void addDirectory(const std::string& name);
+
+			void addFile(const std::string& name, const std::string& content);
+
+			void endFolder();
+
+			size_t numEntries() const { return entries.size(); }
+
+			void write(const boost::filesystem::path& path) const;
+		};
+	}
+}
@@ -0,0 +1,102 @@
+#include "allocations.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#include <boost/atomic.hpp>
+
+namespace
+{
+	boost::atomic<size_t> numAllocations(0);
+	boost::atomic<size_t> numBytes(0);
+	boost::atomic<size_t> numLiveBytes(0);
+
+	// Every allocation is prefixed with its size so freeing can update the live bytes
+	const size_t HeaderSize = 16;
+
+	void* allocate(size_t size)
+	{
+		numAllocations.fetch_add(1, boost::memory_order_relaxed);
+		numBytes.fetch_add(size, boost::memory_order_relaxed);
+		numLiveBytes.fetch_add(size, boost::memory_order_relaxed);
+
+		char* ptr = static_cast<char*>(std::malloc(size + HeaderSize));
+		if (ptr == NULL)
+		{
+			throw std::bad_alloc();
+		}
+
+		*reinterpret_cast<size_t*>(ptr) = size;
+
+		return ptr + HeaderSize;
+	}
+
+	void deallocate(void* ptr)
+	{
+		if (ptr == NULL)
+		{
+			return;
+		}
+
+		char* block = static_cast<char*>(ptr) - HeaderSize;
+		numLiveBytes.fetch_sub(*reinterpret_cast<size_t*>(block), boost::memory_order_relaxed);
+
+		std::free(block);
+	}
+}
+
+void* operator new(size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return allocate(size);
+}
+
+void operator delete(void* ptr) throw()
+{
+	deallocate(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+	deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) throw()
+{
+	deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) throw()
+{
+	deallocate(ptr);
+}
+
+namespace vfspp
+{
+	namespace bench
+	{
+		AllocationCounts allocationCounts()
+		{
+			AllocationCounts counts;
+			counts.allocations = numAllocations.load(boost::memory_order_relaxed);
+			counts.bytes = numBytes.load(boost::memory_order_relaxed);
+			counts.liveBytes = numLiveBytes.load(boost::memory_order_relaxed);
+
+			return counts;
+		}
+
+		AllocationCounts operator-(const AllocationCounts& left, const AllocationCounts& right)
+		{
+			AllocationCounts counts;
+			counts.allocations = left.allocations - right.allocations;
+			counts.bytes = left.bytes - right.bytes;
+			counts.liveBytes = left.liveBytes - right.liveBytes;
+
+			return counts;
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+namespace vfspp
+{
+	namespace bench
+	{
+		// Totals of the global operator new since the start of the program. Only available in
+		// benchmarks which compile allocations.cpp as it replaces the global allocation functions.
+		struct AllocationCounts
+		{
+			size_t allocations;
+			size_t bytes;
+
+			// Bytes allocated and not freed yet
+			size_t liveBytes;
+		};
+
+		AllocationCounts allocationCounts();
+
+		AllocationCounts operator-(const AllocationCounts& left, const AllocationCounts& right);
+	}
+}
@@ -0,0 +1,84 @@
+#include "common.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace vfspp
+{
+	namespace bench
+	{
+		double Stopwatch::elapsedMilliseconds() const
+		{
+			boost::chrono::duration<double, boost::milli> elapsed = boost::chrono::steady_clock::now() - start;
+
+			return elapsed.count();
+		}
+
+		boost::filesystem::path writePath(const std::string& name)
+		{
+			return boost::filesystem::path(BENCH_WRITE_DIR) / name;
+		}
+
+		size_t sizeArgument(int argc, char** argv, int index, size_t defaultValue)
+		{
+			if (index >= argc)
+			{
+				return defaultValue;
+			}
+
+			return static_cast<size_t>(std::strtoul(argv[index], NULL, 10));
+		}
+
+		void printResult(const std::string& name, size_t items, double milliseconds)
+		{
+			double perItem = items > 0 ? (milliseconds * 1000000.0) / items : 0.0;
+
+			std::cout << std::left << std::setw(40) << name << std::right
+				<< std::setw(10) << items << " items "
+				<< std::setw(12) << std::fixed << std::setprecision(3) << milliseconds << " ms "
+				<< std::setw(12) << std::setprecision(1) << perItem << " ns/item" << std::endl;
+		}
+
+		long peakMemory()
+		{
+#ifndef WIN32
+			rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+
+			return usage.ru_maxrss;
+#else
+			return 0;
+#endif
+		}
+
+		long currentMemory()
+		{
+			long pages = 0;
+
+#ifndef WIN32
+			// The second field is the number of resident pages
+			FILE* statm = fopen("/proc/self/statm", "r");
+			if (statm != NULL)
+			{
+				if (fscanf(statm, "%*s %ld", &pages) != 1)
+				{
+					pages = 0;
+				}
+
+				fclose(statm);
+			}
+
+			return pages * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+			return pages;
+#endif
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include <boost/chrono.hpp>
+#include <boost/filesystem/path.hpp>
+
+namespace vfspp
+{
+	namespace bench
+	{
+		class Stopwatch
+		{
+		private:
+			boost::chrono::steady_clock::time_point start;
+
+		public:
+			Stopwatch() : start(boost::chrono::steady_clock::now()) {}
+
+			void restart() { start = boost::chrono::steady_clock::now(); }
+
+			double elapsedMilliseconds() const;
+		};
+
+		// Returns a path inside the directory the benchmarks may write their data files to
+		boost::filesystem::path writePath(const std::string& name);
+
+		// Parses a command line argument as a number, returns the default if it was not specified
+		size_t sizeArgument(int argc, char** argv, int index, size_t defaultValue);
+
+		void printResult(const std::string& name, size_t items, double milliseconds);
+
+		// Peak resident set size of the process in KiB, this never decreases
+		long peakMemory();
+
+		// Current resident set size of the process in KiB, 0 if it isn't known
+		long currentMemory();
+	}
+}
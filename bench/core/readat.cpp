@@ -0,0 +1,112 @@
+#include <VFSPP/memory.hpp>
+#include <VFSPP/system.hpp>
+
+#ifdef VFSPP_7ZIP_SUPPORT
+#include <VFSPP/7zip.hpp>
+#include "SevenZipWriter.hpp"
+#endif
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+#include <vector>
+
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::bench;
+
+namespace
+{
+	const size_t ReadSize = 64;
+
+	// Cheap deterministic offsets so every variant reads the same ranges
+	std::vector<size_t> randomOffsets(size_t numReads, size_t fileSize)
+	{
+		std::vector<size_t> offsets(numReads);
+
+		boost::uint32_t state = 12345;
+		for (size_t i = 0; i < numReads; ++i)
+		{
+			state = state * 1664525u + 1013904223u;
+			offsets[i] = state % (fileSize - ReadSize);
+		}
+
+		return offsets;
+	}
+
+	void readStreams(const std::string& name, IFileSystemEntry* entry, const std::vector<size_t>& offsets)
+	{
+		char buffer[ReadSize];
+
+		Stopwatch watch;
+		for (size_t i = 0; i < offsets.size(); ++i)
+		{
+			boost::shared_ptr<std::streambuf> stream = entry->open(IFileSystemEntry::MODE_READ);
+			stream->pubseekpos(offsets[i], std::ios::in);
+			stream->sgetn(buffer, ReadSize);
+		}
+		printResult(name + ", open + seek", offsets.size(), watch.elapsedMilliseconds());
+	}
+
+	void readPositional(const std::string& name, IFileSystemEntry* entry, const std::vector<size_t>& offsets)
+	{
+		char buffer[ReadSize];
+
+		Stopwatch watch;
+		for (size_t i = 0; i < offsets.size(); ++i)
+		{
+			entry->readAt(offsets[i], buffer, ReadSize);
+		}
+		printResult(name + ", readAt", offsets.size(), watch.elapsedMilliseconds());
+	}
+
+	void compare(const std::string& name, IFileSystemEntry* entry, const std::vector<size_t>& offsets)
+	{
+		readStreams(name, entry, offsets);
+		readPositional(name, entry, offsets);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t fileSize = sizeArgument(argc, argv, 1, 4 * 1024 * 1024);
+	size_t numReads = sizeArgument(argc, argv, 2, 100000);
+
+	std::string content(fileSize, 'x');
+	std::vector<size_t> offsets = randomOffsets(numReads, fileSize);
+
+	{
+		boost::filesystem::path filePath = writePath("readat.dat");
+		boost::filesystem::ofstream out(filePath, std::ios::binary);
+		out.write(content.data(), content.size());
+		out.close();
+
+		system::PhysicalFileSystem fs(filePath);
+		compare("physical", fs.getRootEntry(), offsets);
+	}
+	{
+		memory::MemoryFileSystem fs;
+		FileEntryPointer entry = fs.getRootEntry()->addChild("readat.dat", vfspp::FILE, 0, &content[0], content.size());
+
+		compare("memory", entry.get(), offsets);
+	}
+#ifdef VFSPP_7ZIP_SUPPORT
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("readat_%1%.7z") % fileSize).str());
+
+		if (!boost::filesystem::exists(archivePath))
+		{
+			SevenZipWriter writer;
+			writer.addFile("readat.dat", content);
+			writer.write(archivePath);
+		}
+
+		sevenzip::SevenZipFileSystem fs(archivePath);
+		compare("7-zip", fs.getRootEntry()->getChild("readat.dat").get(), offsets);
+	}
+#endif
+
+	return 0;
+}
@@ -0,0 +1,109 @@
+#include <VFSPP/memory.hpp>
+
+#include <boost/format.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include <iostream>
+#include <vector>
+
+#include "allocations.hpp"
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::memory;
+using namespace vfspp::bench;
+
+namespace
+{
+	// Two levels of 100 directories with small files below them
+	std::string filePath(size_t file)
+	{
+		return (boost::format("directory%1%/subdirectory%2%/file%3%.dat") % (file / 10000) % (file / 100 % 100) % file).str();
+	}
+
+	void run(bool useArena, size_t numFiles, size_t numLookups, const std::string& name)
+	{
+		std::vector<std::string> paths(numFiles);
+		for (size_t file = 0; file < numFiles; ++file)
+		{
+			paths[file] = filePath(file);
+		}
+
+		long memoryBefore = currentMemory();
+		AllocationCounts before = allocationCounts();
+		Stopwatch watch;
+
+		MemoryFileSystem fs(useArena);
+		{
+			char content[16] = "0123456789abcde";
+
+			boost::shared_ptr<MemoryFileEntry> directory;
+			boost::shared_ptr<MemoryFileEntry> subdirectory;
+			for (size_t file = 0; file < numFiles; ++file)
+			{
+				if (file % 10000 == 0)
+				{
+					directory = fs.getRootEntry()->addChild((boost::format("directory%1%") % (file / 10000)).str(), vfspp::DIRECTORY);
+				}
+
+				if (file % 100 == 0)
+				{
+					subdirectory = directory->addChild((boost::format("subdirectory%1%") % (file / 100 % 100)).str(), vfspp::DIRECTORY);
+				}
+
+				subdirectory->addChild((boost::format("file%1%.dat") % file).str(), vfspp::FILE, 0, content, sizeof(content));
+			}
+		}
+
+		double milliseconds = watch.elapsedMilliseconds();
+		AllocationCounts counts = allocationCounts() - before;
+		long memory = currentMemory() - memoryBefore;
+
+		// The allocated bytes don't include the overhead of the allocator, the resident memory does
+		printResult(name + " build", numFiles, milliseconds);
+		std::cout << "  " << counts.liveBytes / numFiles << " bytes allocated and "
+			<< memory * 1024.0 / numFiles << " bytes resident per entry, "
+			<< static_cast<double>(counts.allocations) / numFiles << " allocations per entry" << std::endl;
+
+		// Random lookups so most of them miss the cache
+		boost::random::mt19937 random(42);
+		boost::random::uniform_int_distribution<size_t> distribution(0, numFiles - 1);
+
+		std::vector<size_t> order(numLookups);
+		for (size_t i = 0; i < numLookups; ++i)
+		{
+			order[i] = distribution(random);
+		}
+
+		size_t found = 0;
+		watch.restart();
+		for (size_t i = 0; i < numLookups; ++i)
+		{
+			FileEntryPointer entry;
+			if (fs.getRootEntry()->tryGetChild(NormalizedPath(paths[order[i]]), entry) == STATUS_OK)
+			{
+				++found;
+			}
+		}
+		printResult(name + " lookup", numLookups, watch.elapsedMilliseconds());
+
+		if (found != numLookups)
+		{
+			std::cout << "  only " << found << " of " << numLookups << " paths were found" << std::endl;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 1000000);
+	size_t numLookups = sizeArgument(argc, argv, 2, 1000000);
+
+	// The slabs of the arena are returned to the system when it is destroyed, the memory of the
+	// heap run would be reused by the allocator and hide what the arena needs
+	run(true, numFiles, numLookups, "arena");
+	run(false, numFiles, numLookups, "heap");
+
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include <VFSPP/memory.hpp>
+
+#include <boost/format.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include <iostream>
+#include <vector>
+
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::memory;
+using namespace vfspp::bench;
+
+namespace
+{
+	// Same tree as the arena benchmark, two levels of 100 directories with small files below them
+	std::string filePath(size_t file)
+	{
+		return (boost::format("directory%1%/subdirectory%2%/file%3%.dat") % (file / 10000) % (file / 100 % 100) % file).str();
+	}
+
+	void lookup(MemoryFileSystem& fs, const std::vector<std::string>& paths, const std::vector<size_t>& order,
+		const std::string& name)
+	{
+		size_t found = 0;
+		Stopwatch watch;
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			FileEntryPointer entry;
+			if (fs.getRootEntry()->tryGetChild(NormalizedPath(paths[order[i]]), entry) == STATUS_OK)
+			{
+				++found;
+			}
+		}
+		printResult(name + " lookup", order.size(), watch.elapsedMilliseconds());
+
+		watch.restart();
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			FileEntryPointer entry;
+			if (fs.getRootEntry()->tryGetChild(paths[order[i]], entry) == STATUS_OK)
+			{
+				++found;
+			}
+		}
+		printResult(name + " string lookup", order.size(), watch.elapsedMilliseconds());
+
+		if (found != 2 * order.size())
+		{
+			std::cout << "  only " << found << " of " << 2 * order.size() << " paths were found" << std::endl;
+		}
+	}
+
+	void run(bool useArena, size_t numFiles, size_t numLookups, const std::string& name)
+	{
+		std::vector<std::string> paths(numFiles);
+		for (size_t file = 0; file < numFiles; ++file)
+		{
+			paths[file] = filePath(file);
+		}
+
+		MemoryFileSystem fs(useArena);
+		{
+			char content[16] = "0123456789abcde";
+
+			boost::shared_ptr<MemoryFileEntry> directory;
+			boost::shared_ptr<MemoryFileEntry> subdirectory;
+			for (size_t file = 0; file < numFiles; ++file)
+			{
+				if (file % 10000 == 0)
+				{
+					directory = fs.getRootEntry()->addChild((boost::format("directory%1%") % (file / 10000)).str(), vfspp::DIRECTORY);
+				}
+
+				if (file % 100 == 0)
+				{
+					subdirectory = directory->addChild((boost::format("subdirectory%1%") % (file / 100 % 100)).str(), vfspp::DIRECTORY);
+				}
+
+				subdirectory->addChild((boost::format("file%1%.dat") % file).str(), vfspp::FILE, 0, content, sizeof(content));
+			}
+		}
+
+		// Random lookups so most of them miss the cache
+		boost::random::mt19937 random(42);
+		boost::random::uniform_int_distribution<size_t> distribution(0, numFiles - 1);
+
+		std::vector<size_t> order(numLookups);
+		for (size_t i = 0; i < numLookups; ++i)
+		{
+			order[i] = distribution(random);
+		}
+
+		lookup(fs, paths, order, name + " tree");
+
+		long memoryBefore = currentMemory();
+		Stopwatch watch;
+
+		fs.freeze();
+
+		printResult(name + " freeze", numFiles, watch.elapsedMilliseconds());
+		std::cout << "  " << (currentMemory() - memoryBefore) * 1024.0 / numFiles << " bytes resident per entry" << std::endl;
+
+		lookup(fs, paths, order, name + " frozen");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 1000000);
+	size_t numLookups = sizeArgument(argc, argv, 2, 1000000);
+
+	run(true, numFiles, numLookups, "arena");
+	run(false, numFiles, numLookups, "heap");
+
+	return 0;
+}
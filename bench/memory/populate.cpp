@@ -0,0 +1,71 @@
+#include <VFSPP/memory.hpp>
+
+#include <boost/format.hpp>
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::memory;
+using namespace vfspp::bench;
+
+namespace
+{
+	enum Mode
+	{
+		MODE_ADOPT,
+		MODE_COPY
+	};
+
+	// Generates the blobs like an application would and hands them to the filesystem
+	void populate(Mode mode, size_t numBlobs, size_t blobSize, const std::string& name)
+	{
+		std::vector<std::vector<char> > blobs(numBlobs);
+		for (size_t i = 0; i < numBlobs; ++i)
+		{
+			blobs[i].assign(blobSize, static_cast<char>('a' + i % 26));
+		}
+
+		Stopwatch watch;
+		{
+			MemoryFileSystem fs;
+			MemoryFileEntry* root = fs.getRootEntry();
+
+			for (size_t i = 0; i < numBlobs; ++i)
+			{
+				std::string blobName = (boost::format("blob%1%.dat") % i).str();
+
+				if (mode == MODE_ADOPT)
+				{
+					root->addChild(blobName, std::move(blobs[i]));
+				}
+				else
+				{
+					root->addChild(blobName, vfspp::FILE, 0, &blobs[i][0], blobSize);
+				}
+			}
+
+			// The generated data is not needed anymore once it is in the filesystem
+			blobs.clear();
+
+			printResult(name, numBlobs * blobSize / (1024 * 1024), watch.elapsedMilliseconds());
+			std::cout << "  peak memory " << peakMemory() / 1024 << " MiB for "
+				<< numBlobs * blobSize / (1024 * 1024) << " MiB of data" << std::endl;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numBlobs = sizeArgument(argc, argv, 1, 16);
+	size_t blobSize = sizeArgument(argc, argv, 2, 64 * 1024 * 1024);
+
+	// The peak memory of the process can only grow, so the modes run in order of their expected peak
+	populate(MODE_ADOPT, numBlobs, blobSize, "adopted (MiB)");
+	populate(MODE_COPY, numBlobs, blobSize, "copied (MiB)");
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+#include <VFSPP/memory.hpp>
+#include <VFSPP/system.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::memory;
+using namespace vfspp::bench;
+
+namespace
+{
+	// 100 files per directory in two levels
+	boost::filesystem::path generateTree(size_t numFiles, size_t fileSize)
+	{
+		boost::filesystem::path root = writePath((boost::format("preload_%1%_%2%") % numFiles % fileSize).str());
+
+		if (boost::filesystem::exists(root))
+		{
+			return root;
+		}
+
+		std::string content(fileSize, 'x');
+
+		for (size_t i = 0; i < numFiles; ++i)
+		{
+			boost::filesystem::path directory = root / (boost::format("dir%1%/sub%2%") % (i / 1000) % (i / 100)).str();
+			if (i % 100 == 0)
+			{
+				boost::filesystem::create_directories(directory);
+			}
+
+			boost::filesystem::ofstream out(directory / (boost::format("file%1%.dat") % i).str(), std::ios::binary);
+			out.write(content.data(), content.size());
+		}
+
+		return root;
+	}
+
+	// What callers did before preload(): one thread walks the tree and adds every file
+	void copySerially(IFileSystemEntry* source, MemoryFileEntry* target)
+	{
+		std::vector<FileEntryPointer> children;
+		source->listChildren(children);
+
+		BOOST_FOREACH(const FileEntryPointer& child, children)
+		{
+			string_type name = child->getPath().substr(child->getPath().find_last_of(DirectorySeparatorChar) + 1);
+
+			if (child->getType() == DIRECTORY)
+			{
+				copySerially(child.get(), target->addChild(name, DIRECTORY, child->lastWriteTime()).get());
+			}
+			else
+			{
+				EntryStat stat = child->stat();
+
+				std::vector<char> data(static_cast<size_t>(stat.size));
+				if (!data.empty())
+				{
+					child->readAt(0, &data[0], data.size());
+				}
+
+				target->addChild(name, std::move(data), stat.writeTime);
+			}
+		}
+	}
+
+	void printBandwidth(const std::string& name, size_t numFiles, boost::uint64_t numBytes, double milliseconds)
+	{
+		printResult(name, numFiles, milliseconds);
+		std::cout << "  " << numBytes / 1048576.0 / (milliseconds / 1000.0) << " MiB/s" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 10000);
+	size_t fileSize = sizeArgument(argc, argv, 2, 16 * 1024);
+
+	boost::filesystem::path root = generateTree(numFiles, fileSize);
+
+	system::PhysicalFileSystem source(root);
+
+	// The files were just written or are read by the first run, every run reads from the page cache.
+	// Pass a directory on a cold disk to measure the disk instead.
+	{
+		MemoryFileSystem target;
+		copySerially(source.getRootEntry(), target.getRootEntry());
+	}
+
+	{
+		MemoryFileSystem target;
+
+		Stopwatch watch;
+		copySerially(source.getRootEntry(), target.getRootEntry());
+		printBandwidth("serial copy", numFiles, static_cast<boost::uint64_t>(numFiles) * fileSize, watch.elapsedMilliseconds());
+	}
+
+	size_t threadCounts[] = { 1, 2, 4, 8 };
+	BOOST_FOREACH(size_t numThreads, threadCounts)
+	{
+		MemoryFileSystem target;
+
+		PreloadOptions options;
+		options.numThreads = numThreads;
+
+		Stopwatch watch;
+		PreloadResult result = preload(&source, &target, options);
+		printBandwidth((boost::format("preload, %1% threads") % numThreads).str(), result.numFiles, result.numBytes,
+			watch.elapsedMilliseconds());
+	}
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include <VFSPP/memory.hpp>
+#include <VFSPP/system.hpp>
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::bench;
+
+namespace
+{
+	// Writes the files like a build step producing intermediate files, then reads them back
+	void run(IFileSystem& fs, size_t numFiles, size_t fileSize, const std::string& name)
+	{
+		std::string content(fileSize, 'x');
+
+		std::vector<std::string> paths;
+		for (size_t i = 0; i < numFiles; ++i)
+		{
+			paths.push_back((boost::format("dir%1%/file%2%.o") % (i % 64) % i).str());
+		}
+
+		Stopwatch watch;
+		for (size_t i = 0; i < paths.size(); ++i)
+		{
+			FileEntryPointer entry = fs.getRootEntry()->createEntry(vfspp::FILE, paths[i]);
+
+			boost::shared_ptr<std::streambuf> buffer = entry->open(IFileSystemEntry::MODE_WRITE);
+
+			// Output is produced in pieces
+			for (size_t offset = 0; offset < content.size(); offset += 4096)
+			{
+				buffer->sputn(content.data() + offset, std::min<size_t>(4096, content.size() - offset));
+			}
+		}
+		printResult(name + " write", numFiles, watch.elapsedMilliseconds());
+
+		size_t total = 0;
+		std::vector<char> readBuffer(fileSize);
+
+		watch.restart();
+		for (size_t i = 0; i < paths.size(); ++i)
+		{
+			total += fs.getRootEntry()->getChild(paths[i])->readAt(0, &readBuffer[0], readBuffer.size());
+		}
+		printResult(name + " read", numFiles, watch.elapsedMilliseconds());
+
+		watch.restart();
+		for (size_t i = 0; i < 64; ++i)
+		{
+			fs.getRootEntry()->deleteChild((boost::format("dir%1%") % i).str());
+		}
+		printResult(name + " delete", numFiles, watch.elapsedMilliseconds());
+
+		if (total != numFiles * fileSize)
+		{
+			std::cout << "  read " << total << " bytes instead of " << numFiles * fileSize << std::endl;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 20000);
+	size_t fileSize = sizeArgument(argc, argv, 2, 16 * 1024);
+
+	{
+		memory::MemoryFileSystem fs;
+		run(fs, numFiles, fileSize, "memory");
+	}
+
+	// A directory on a tmpfs may be passed to compare against it
+	boost::filesystem::path physicalRoot = argc > 3 ? boost::filesystem::path(argv[3]) : writePath("write");
+	boost::filesystem::create_directories(physicalRoot);
+	{
+		system::PhysicalFileSystem fs(physicalRoot);
+		fs.setAllowedOperations(OP_READ | OP_WRITE | OP_CREATE | OP_DELETE);
+
+		run(fs, numFiles, fileSize, "physical");
+	}
+
+	return 0;
+}
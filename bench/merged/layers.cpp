@@ -0,0 +1,93 @@
+#include <VFSPP/merged.hpp>
+#include <VFSPP/system.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::bench;
+
+namespace
+{
+	// Every layer has its own directories so most of the layers don't contain a given directory
+	boost::filesystem::path generateLayer(size_t layer, size_t dirsPerLayer)
+	{
+		boost::filesystem::path root = writePath((boost::format("layers_%1%_%2%") % layer % dirsPerLayer).str());
+
+		if (boost::filesystem::exists(root))
+		{
+			return root;
+		}
+
+		for (size_t dir = 0; dir < dirsPerLayer; ++dir)
+		{
+			boost::filesystem::path directory = root / "data" / (boost::format("layer%1%_dir%2%") % layer % dir).str();
+			boost::filesystem::create_directories(directory);
+
+			boost::filesystem::ofstream out(directory / "file.dat");
+		}
+
+		return root;
+	}
+
+	size_t countEntries(IFileSystemEntry* entry)
+	{
+		size_t count = 1;
+
+		if (entry->getType() == DIRECTORY)
+		{
+			std::vector<FileEntryPointer> children;
+			entry->listChildren(children);
+
+			BOOST_FOREACH(const FileEntryPointer& child, children)
+			{
+				count += countEntries(child.get());
+			}
+		}
+
+		return count;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numLayers = sizeArgument(argc, argv, 1, 24);
+	size_t dirsPerLayer = sizeArgument(argc, argv, 2, 50);
+
+	bool filterModes[] = { false, true };
+
+	BOOST_FOREACH(bool filters, filterModes)
+	{
+		merged::MergedFileSystem fs;
+
+		for (size_t layer = 0; layer < numLayers; ++layer)
+		{
+			system::PhysicalFileSystem* layerSystem = new system::PhysicalFileSystem(generateLayer(layer, dirsPerLayer));
+			layerSystem->setAllowedOperations(OP_READ);
+
+			fs.addFileSystem(layerSystem);
+		}
+
+		Stopwatch watch;
+
+		if (filters)
+		{
+			fs.buildLayerFilters();
+
+			printResult("building filters", numLayers, watch.elapsedMilliseconds());
+			watch.restart();
+		}
+
+		// Caching a directory looks it up in every layer
+		size_t entries = countEntries(fs.getRootEntry());
+
+		printResult(filters ? "merged listing, layer filters" : "merged listing", entries, watch.elapsedMilliseconds());
+	}
+
+	return 0;
+}
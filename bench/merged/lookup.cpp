@@ -0,0 +1,106 @@
+#include <VFSPP/merged.hpp>
+#include <VFSPP/7zip.hpp>
+#include <VFSPP/path.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "allocations.hpp"
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::bench;
+
+namespace
+{
+	std::string filePath(size_t layer, size_t file)
+	{
+		return (boost::format("data/level%1%/level%2%/level%3%/layer%4%/file%5%.dat") % (file % 2) % (file % 3) % (file % 5) % layer % file).str();
+	}
+
+	// Every layer contributes its own files to a deep directory tree shared by all layers
+	boost::filesystem::path generateLayer(size_t layer, size_t filesPerLayer)
+	{
+		boost::filesystem::path archivePath = writePath((boost::format("lookup_%1%_%2%.7z") % layer % filesPerLayer).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return archivePath;
+		}
+
+		SevenZipWriter writer;
+		for (size_t file = 0; file < filesPerLayer; ++file)
+		{
+			writer.addFile(filePath(layer, file), "x");
+		}
+
+		writer.write(archivePath);
+
+		return archivePath;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numLayers = sizeArgument(argc, argv, 1, 12);
+	size_t filesPerLayer = sizeArgument(argc, argv, 2, 1000);
+	size_t numLookups = sizeArgument(argc, argv, 3, 200000);
+
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < numLookups; ++i)
+	{
+		paths.push_back(filePath((i * 7) % numLayers, (i * 13) % filesPerLayer));
+	}
+
+	bool indexModes[] = { false, true };
+
+	BOOST_FOREACH(bool flatIndex, indexModes)
+	{
+		merged::MergedFileSystem fs;
+		fs.setFlatIndexEnabled(flatIndex);
+
+		for (size_t layer = 0; layer < numLayers; ++layer)
+		{
+			fs.addFileSystem(new sevenzip::SevenZipFileSystem(generateLayer(layer, filesPerLayer)));
+		}
+
+		fs.populateEntries(8);
+
+		IFileSystemEntry* root = fs.getRootEntry();
+
+		size_t found = 0;
+		AllocationCounts before = allocationCounts();
+		Stopwatch watch;
+		BOOST_FOREACH(const std::string& path, paths)
+		{
+			if (root->getChild(path))
+			{
+				++found;
+			}
+		}
+
+		printResult(flatIndex ? "deep lookups, flat index" : "deep lookups", paths.size(), watch.elapsedMilliseconds());
+		std::cout << "  " << found << " found, " << (allocationCounts() - before).allocations << " allocations" << std::endl;
+
+		// The paths are normalized and hashed once per lookup without copying them
+		found = 0;
+		before = allocationCounts();
+		watch.restart();
+		BOOST_FOREACH(const std::string& path, paths)
+		{
+			FileEntryPointer entry;
+			if (root->tryGetChild(NormalizedPath(path), entry) == STATUS_OK)
+			{
+				++found;
+			}
+		}
+
+		printResult(flatIndex ? "normalized lookups, flat index" : "normalized lookups", paths.size(), watch.elapsedMilliseconds());
+		std::cout << "  " << found << " found, " << (allocationCounts() - before).allocations << " allocations" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include <VFSPP/merged.hpp>
+#include <VFSPP/system.hpp>
+#include <VFSPP/7zip.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+#include "SevenZipWriter.hpp"
+
+using namespace vfspp;
+using namespace vfspp::bench;
+
+using boost::shared_ptr;
+
+namespace
+{
+	std::string fileName(size_t file)
+	{
+		return (boost::format("dir%1%/file%2%.dat") % (file % 10) % file).str();
+	}
+
+	// The same files as an archive and as a directory, the archive hides the directory when merged
+	void generateLayers(size_t numFiles, boost::filesystem::path& archivePath, boost::filesystem::path& directoryPath)
+	{
+		archivePath = writePath((boost::format("misses_%1%.7z") % numFiles).str());
+		directoryPath = writePath((boost::format("misses_%1%") % numFiles).str());
+
+		if (boost::filesystem::exists(archivePath))
+		{
+			return;
+		}
+
+		SevenZipWriter writer;
+		for (size_t file = 0; file < numFiles; ++file)
+		{
+			writer.addFile(fileName(file), "x");
+
+			boost::filesystem::path path = directoryPath / fileName(file);
+			boost::filesystem::create_directories(path.parent_path());
+
+			boost::filesystem::ofstream out(path);
+			out << "x";
+		}
+
+		writer.write(archivePath);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 1000);
+	size_t rounds = sizeArgument(argc, argv, 2, 20);
+
+	boost::filesystem::path archivePath;
+	boost::filesystem::path directoryPath;
+	generateLayers(numFiles, archivePath, directoryPath);
+
+	merged::MergedFileSystem fs;
+	fs.addFileSystem(new sevenzip::SevenZipFileSystem(archivePath));
+	fs.addFileSystem(new system::PhysicalFileSystem(directoryPath));
+
+	std::vector<FileEntryPointer> files;
+	for (size_t file = 0; file < numFiles; ++file)
+	{
+		files.push_back(fs.getRootEntry()->getChild(fileName(file)));
+	}
+
+	size_t failures = 0;
+
+	// Looking up a child of a file is an error
+	Stopwatch watch;
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		BOOST_FOREACH(const FileEntryPointer& file, files)
+		{
+			try
+			{
+				file->getChild("child");
+			}
+			catch (const InvalidOperationException&)
+			{
+				++failures;
+			}
+		}
+	}
+	printResult("getChild of file, exceptions", files.size() * rounds, watch.elapsedMilliseconds());
+
+	watch.restart();
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		BOOST_FOREACH(const FileEntryPointer& file, files)
+		{
+			FileEntryPointer child;
+			if (file->tryGetChild("child", child) != STATUS_OK)
+			{
+				++failures;
+			}
+		}
+	}
+	printResult("getChild of file, status", files.size() * rounds, watch.elapsedMilliseconds());
+
+	// Opening a directory is an error
+	std::vector<FileEntryPointer> directories;
+	fs.getRootEntry()->listChildren(directories);
+
+	watch.restart();
+	for (size_t round = 0; round < rounds * 100; ++round)
+	{
+		BOOST_FOREACH(const FileEntryPointer& directory, directories)
+		{
+			try
+			{
+				directory->open();
+			}
+			catch (const InvalidOperationException&)
+			{
+				++failures;
+			}
+		}
+	}
+	printResult("open of directory, exceptions", directories.size() * rounds * 100, watch.elapsedMilliseconds());
+
+	watch.restart();
+	for (size_t round = 0; round < rounds * 100; ++round)
+	{
+		BOOST_FOREACH(const FileEntryPointer& directory, directories)
+		{
+			shared_ptr<std::streambuf> buffer;
+			if (directory->tryOpen(IFileSystemEntry::MODE_READ, buffer) != STATUS_OK)
+			{
+				++failures;
+			}
+		}
+	}
+	printResult("open of directory, status", directories.size() * rounds * 100, watch.elapsedMilliseconds());
+
+	// The archive can't map its files, open() falls back to the directory without throwing internally
+	watch.restart();
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		BOOST_FOREACH(const FileEntryPointer& file, files)
+		{
+			file->open(IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_MEMORY_MAPPED);
+		}
+	}
+	printResult("mapped open with fallback", files.size() * rounds, watch.elapsedMilliseconds());
+
+	std::cout << "  " << failures << " failures" << std::endl;
+
+	return 0;
+}
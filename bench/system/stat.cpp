@@ -0,0 +1,77 @@
+#include <VFSPP/system.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+#include <vector>
+
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::system;
+using namespace vfspp::bench;
+
+namespace
+{
+	boost::filesystem::path generateFiles(size_t numFiles)
+	{
+		boost::filesystem::path root = writePath((boost::format("stat_%1%") % numFiles).str());
+
+		if (boost::filesystem::exists(root))
+		{
+			return root;
+		}
+
+		boost::filesystem::create_directories(root);
+
+		for (size_t i = 0; i < numFiles; ++i)
+		{
+			boost::filesystem::ofstream out(root / (boost::format("file%1%.dat") % i).str());
+			out << i;
+		}
+
+		return root;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 20000);
+
+	PhysicalFileSystem fs(generateFiles(numFiles));
+
+	std::vector<FileEntryPointer> entries;
+	fs.getRootEntry()->listChildren(entries);
+
+	boost::uint64_t totalSize = 0;
+
+	{
+		Stopwatch watch;
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			// Type and write time through the separate queries, the size needs the file to be opened
+			if (entries[i]->getType() == vfspp::FILE)
+			{
+				entries[i]->lastWriteTime();
+
+				boost::shared_ptr<std::streambuf> buffer = entries[i]->open(IFileSystemEntry::MODE_READ);
+				totalSize += static_cast<boost::uint64_t>(std::streamoff(buffer->pubseekoff(0, std::ios::end, std::ios::in)));
+			}
+		}
+		printResult("getType + lastWriteTime + open", entries.size(), watch.elapsedMilliseconds());
+	}
+	{
+		Stopwatch watch;
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			EntryStat info = entries[i]->stat();
+			totalSize += info.size;
+		}
+		printResult("stat", entries.size(), watch.elapsedMilliseconds());
+	}
+
+	std::cout << "  " << totalSize << " bytes" << std::endl;
+
+	return 0;
+}
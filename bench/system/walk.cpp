@@ -0,0 +1,104 @@
+#include <VFSPP/merged.hpp>
+#include <VFSPP/system.hpp>
+#include <VFSPP/walk.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+
+#include "common.hpp"
+
+using namespace vfspp;
+using namespace vfspp::bench;
+
+namespace
+{
+	// Same layout as the 7-zip walk benchmark: 100 files per directory in three levels
+	boost::filesystem::path generateTree(size_t numFiles)
+	{
+		boost::filesystem::path root = writePath((boost::format("walk_%1%") % numFiles).str());
+
+		if (boost::filesystem::exists(root))
+		{
+			return root;
+		}
+
+		for (size_t i = 0; i < numFiles; ++i)
+		{
+			size_t leaf = i / 100;
+			size_t mid = leaf / 10;
+			size_t top = mid / 10;
+
+			boost::filesystem::path directory = root / (boost::format("top%1%/mid%2%/leaf%3%") % top % mid % leaf).str();
+			if (i % 100 == 0)
+			{
+				boost::filesystem::create_directories(directory);
+			}
+
+			boost::filesystem::ofstream out(directory / (boost::format("file%1%.dat") % i).str());
+		}
+
+		return root;
+	}
+
+	size_t walk(IFileSystemEntry* entry)
+	{
+		size_t count = 1;
+
+		if (entry->getType() == DIRECTORY)
+		{
+			std::vector<FileEntryPointer> children;
+			entry->listChildren(children);
+
+			BOOST_FOREACH(const FileEntryPointer& child, children)
+			{
+				count += walk(child.get());
+			}
+		}
+
+		return count;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t numFiles = sizeArgument(argc, argv, 1, 20000);
+
+	boost::filesystem::path root = generateTree(numFiles);
+
+	{
+		system::PhysicalFileSystem fs(root);
+
+		Stopwatch watch;
+		size_t entries = walk(fs.getRootEntry());
+		printResult("physical walk", entries, watch.elapsedMilliseconds());
+	}
+
+	size_t threadCounts[] = { 1, 2, 4, 8 };
+	BOOST_FOREACH(size_t numThreads, threadCounts)
+	{
+		system::PhysicalFileSystem fs(root);
+
+		WalkOptions options;
+		options.numThreads = numThreads;
+
+		std::vector<FileEntryPointer> entries;
+
+		Stopwatch watch;
+		vfspp::walk(fs.getRootEntry(), entries, options);
+		printResult((boost::format("parallel walk, %1% threads") % numThreads).str(), entries.size(), watch.elapsedMilliseconds());
+	}
+	{
+		merged::MergedFileSystem fs;
+		fs.addFileSystem(new system::PhysicalFileSystem(root));
+
+		Stopwatch watch;
+		fs.populateEntries(4);
+		size_t entries = walk(fs.getRootEntry());
+		printResult("merged populate + walk", entries, watch.elapsedMilliseconds());
+	}
+
+	return 0;
+}
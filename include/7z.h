@@ -85,6 +85,18 @@ SRes SzFolder_Decode(const CSzFolder *folder, const UInt64 *packSizes,
     ILookInStream *stream, UInt64 startPos,
     Byte *outBuffer, size_t outSize, ISzAlloc *allocMain);
 
+/* Receives the decoded data of a folder in order and in small pieces, right after they have been
+   written to outBuffer. Decoding stops if Process returns an error. */
+typedef struct IDecodeProgress IDecodeProgress;
+struct IDecodeProgress
+{
+  SRes (*Process)(IDecodeProgress *p, const Byte *data, size_t size);
+};
+
+SRes SzFolder_DecodeWithProgress(const CSzFolder *folder, const UInt64 *packSizes,
+    ILookInStream *stream, UInt64 startPos,
+    Byte *outBuffer, size_t outSize, ISzAlloc *allocMain, IDecodeProgress *progress);
+
 typedef struct
 {
   UInt32 Low;
@@ -20,6 +20,18 @@ void MY_FAST_CALL CrcGenerateTable(void);
 UInt32 MY_FAST_CALL CrcUpdate(UInt32 crc, const void *data, size_t size);
 UInt32 MY_FAST_CALL CrcCalc(const void *data, size_t size);
 
+/* CrcGenerateTable selects the fastest implementation supported by the CPU */
+typedef enum
+{
+  CRC_IMPL_TABLE,
+  CRC_IMPL_CLMUL
+} ECrcImpl;
+
+/* Switches the implementation for tests and benchmarks, returns False if it isn't supported.
+   Must not be called while CRCs are computed by other threads. */
+Bool MY_FAST_CALL CrcSetImpl(ECrcImpl impl);
+ECrcImpl MY_FAST_CALL CrcGetImpl(void);
+
 EXTERN_C_END
 
 #endif
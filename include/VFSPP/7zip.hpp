@@ -6,8 +6,14 @@
 #include "VFSPP/core.hpp"
 #include "VFSPP/util.hpp"
 
+#include <list>
+
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 extern "C"
 {
@@ -15,9 +21,16 @@ extern "C"
 #include <7z.h>
 }
 
+namespace boost {
+	namespace iostreams {
+		class mapped_file_source;
+	}
+}
+
 namespace vfspp {
 	namespace sevenzip {
 		class SevenZipFileSystem;
+		class SevenZipInStream;
 
 		class VFSPP_EXPORT SevenZipFileEntry : public IFileSystemEntry
 		{
@@ -34,12 +47,24 @@ namespace vfspp {
 
 			virtual FileEntryPointer getChild(const string_type& path) VFSPP_OVERRIDE;
 
+			virtual Status tryGetChild(const string_type& path, FileEntryPointer& outEntry) VFSPP_OVERRIDE;
+
+			virtual Status tryGetChild(const NormalizedPath& path, FileEntryPointer& outEntry) VFSPP_OVERRIDE;
+
 			virtual size_t numChildren() VFSPP_OVERRIDE;
 
 			virtual void listChildren(std::vector<FileEntryPointer>& outVector) VFSPP_OVERRIDE;
 
 			virtual boost::shared_ptr<std::streambuf> open(int mode = MODE_READ) VFSPP_OVERRIDE;
 
+			virtual Status tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer) VFSPP_OVERRIDE;
+
+			virtual size_t readAt(boost::uint64_t offset, void* buffer, size_t length) VFSPP_OVERRIDE;
+
+			virtual bool getView(FileView& outView) VFSPP_OVERRIDE;
+
+			virtual EntryStat stat() VFSPP_OVERRIDE;
+
 			virtual EntryType getType() const VFSPP_OVERRIDE;
 
 			virtual bool deleteChild(const string_type& name) VFSPP_OVERRIDE;
@@ -51,32 +76,85 @@ namespace vfspp {
 			virtual time_t lastWriteTime() VFSPP_OVERRIDE;
 		};
 
+		// The path of an entry is kept in the path table of the file system
 		struct SevenZipFileData
 		{
-			string_type name;
 			size_t index;
 			UInt64 size;
 			UInt32 crc;
+			bool crcDefined;
 			time_t write_time;
 
 			UInt64 unpackedSize;
 			UInt64 packedSize;
 
+			// Offset of the file inside the decoded solid block containing it
+			UInt64 folderOffset;
+			UInt32 folderIndex;
+
 			EntryType type;
 		};
 
+		struct FolderCacheStatistics
+		{
+			size_t hits;
+			size_t misses;
+			size_t evictions;
+
+			size_t cachedFolders;
+			size_t cachedBytes;
+		};
+
+		// Receives an extracted file, the view shares ownership of the decoded solid block
+		typedef boost::function<void (const string_type& path, const FileView& view)> ExtractCallback;
+
 		class VFSPP_EXPORT SevenZipFileSystem : public util::ArchiveFileSystem<SevenZipFileData>
 		{
 		private:
-			// Extract variables
-			UInt32 blockIndex;
-			Byte* outBuffer;
-			size_t outBufferSize;
+			// The CRCs of cached folders have been checked while they were decoded
+			struct CachedFolder
+			{
+				UInt32 folderIndex;
+				boost::shared_array<char> data;
+				size_t size;
+			};
+
+			typedef std::list<CachedFolder> FolderList;
+
+			// Decoded folders, the most recently used folder is at the front
+			FolderList cachedFolders;
+			boost::unordered_map<UInt32, FolderList::iterator> cachedFolderIndexes;
+
+			// Folders which are currently decoded by another thread
+			boost::unordered_set<UInt32> decodingFolders;
+
+			size_t cacheSize;
+			FolderCacheStatistics cacheStatistics;
+
+			mutable boost::mutex cacheLock;
+			boost::condition_variable decodedCondition;
 
-			// 7-zip variables
-			CFileInStream archiveStream;
+			// Folders which have been decoded and checked successfully at least once, guarded by cacheLock
+			std::vector<bool> verifiedFolders;
+
+			struct VerifyState;
+
+			// Every reader needs its own stream position, idle streams are kept for reuse
+			class StreamLease;
+
+			std::vector<SevenZipInStream*> archiveStreams;
+			std::vector<SevenZipInStream*> freeStreams;
+			boost::mutex streamsLock;
+
+			// Mapping of the whole archive which the decoders read from and which views of stored
+			// entries refer to, created on first use
+			boost::shared_ptr<boost::iostreams::mapped_file_source> archiveMapping;
+			bool archiveMappingFailed;
+			boost::unordered_set<UInt32> verifiedStoredFiles;
+			boost::mutex mappingLock;
+
+			// 7-zip variables, db is only read after the archive has been opened
 			CSzArEx db;
-			CLookToRead lookStream;
 			ISzAlloc allocImp;
 			ISzAlloc allocTempImp;
 
@@ -88,15 +166,83 @@ namespace vfspp {
 
 			int GetFileName(const CSzArEx* db, int i);
 
-			boost::shared_array<char> extractEntry(const string_type& path, size_t& arraySize);
+			// The returned array shares ownership of the decoded folder, the file is not copied
+			boost::shared_array<const char> extractEntry(const string_type& path, size_t& arraySize);
+
+			boost::shared_array<char> getFolder(UInt32 folderIndex, size_t& folderSize);
+
+			bool isFolderVerified(UInt32 folderIndex) const;
+
+			void setFolderVerified(UInt32 folderIndex);
+
+			boost::shared_array<char> decodeFolder(UInt32 folderIndex, size_t& folderSize);
+
+			// Decodes the folder into data while checking its CRCs, the 7-zip file indexes of corrupted
+			// files are added to corruptedFiles. Returns SZ_ERROR_CRC if the folder is corrupted.
+			SRes decodeFolder(UInt32 folderIndex, Byte* data, size_t size, std::vector<UInt32>& corruptedFiles);
+
+			void verifyFolders(VerifyState* state);
+
+			struct ExtractState;
+
+			void extractFolders(ExtractState* state);
+
+			void trimCache();
+
+			bool isFolderCached(UInt32 folderIndex) const;
+
+			boost::shared_ptr<std::streambuf> openStreamed(const string_type& path);
+
+			size_t readEntry(const string_type& path, UInt64 offset, void* buffer, size_t length);
+
+			EntryStat statEntry(const string_type& path) const;
+
+			boost::shared_ptr<boost::iostreams::mapped_file_source> getArchiveMapping();
+
+			boost::shared_array<const char> mapStoredEntry(const string_type& path, size_t& arraySize);
+
+			boost::shared_array<const char> mapStoredEntry(const SevenZipFileData& fd, size_t& arraySize);
+
+			SevenZipInStream* openStream();
+
+			SevenZipInStream* acquireStream();
+
+			void releaseStream(SevenZipInStream* stream);
+
+			void closeStreams();
 
 			friend class SevenZipFileEntry;
 
 		public:
-			SevenZipFileSystem(const boost::filesystem::path& filePath);
+			static const size_t DefaultCacheSize = 64 * 1024 * 1024;
+
+			// If mapArchive is false the archive is always read through buffered file handles and
+			// stored entries are copied instead of being mapped
+			SevenZipFileSystem(const boost::filesystem::path& filePath, bool mapArchive = true);
 
 			virtual ~SevenZipFileSystem();
 
+			// Sets the number of bytes of decoded solid blocks which are kept in memory.
+			// The most recently used block is always kept, even if it is bigger than the cache.
+			void setCacheSize(size_t bytes);
+
+			size_t getCacheSize() const;
+
+			FolderCacheStatistics getCacheStatistics() const;
+
+			void clearCache();
+
+			// Decodes every solid block and checks all CRCs without adding the blocks to the cache, using
+			// numThreads threads or one per core if it's 0. Returns false if the archive is corrupted, the
+			// paths of the affected files are added to corruptedPaths if it isn't null.
+			bool verifyArchive(std::vector<string_type>* corruptedPaths = NULL, size_t numThreads = 0);
+
+			// Extracts the files at the given paths. The files are grouped by their solid block so every block is
+			// decoded once, distinct blocks are decoded concurrently on numThreads threads or one per core if it's 0.
+			// The callback is called for every file as soon as its block is available, possibly from several threads
+			// at once. Exceptions of the decoding or the callback stop the extraction and are rethrown.
+			void extractFiles(const std::vector<string_type>& paths, const ExtractCallback& callback, size_t numThreads = 0);
+
 			virtual SevenZipFileEntry* getRootEntry() VFSPP_OVERRIDE;
 
 			virtual int supportedOperations() const VFSPP_OVERRIDE;
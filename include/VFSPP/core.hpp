@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 
+#include <boost/cstdint.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/algorithm/string.hpp>
 
@@ -13,6 +14,8 @@ namespace vfspp
 {
 	class IFileSystemEntry;
 
+	class NormalizedPath;
+
 	typedef std::string string_type;
 
 	typedef boost::shared_ptr<IFileSystemEntry> FileEntryPointer;
@@ -36,6 +39,20 @@ namespace vfspp
 		OP_CREATE = 1 << 3
 	};
 
+	// Result of the non-throwing entry functions
+	enum Status
+	{
+		STATUS_OK,
+		// The requested entry doesn't exist
+		STATUS_NOT_FOUND,
+		STATUS_NOT_DIRECTORY,
+		STATUS_NOT_FILE,
+		// The filesystem or entry doesn't support the requested operation or mode
+		STATUS_NOT_SUPPORTED,
+		// The operation was allowed but failed
+		STATUS_IO_ERROR
+	};
+
 	class VFSPP_EXPORT InvalidOperationException : public std::exception
 	{
 	public:
@@ -64,6 +81,44 @@ namespace vfspp
 		string_type msg;
 	};
 
+	// Read-only contents of a file. The memory stays valid as long as a copy of the view exists,
+	// independent of the entry or filesystem it was created from.
+	class VFSPP_EXPORT FileView
+	{
+	private:
+		boost::shared_array<const char> dataPtr;
+		size_t dataSize;
+
+	public:
+		FileView() : dataSize(0) {}
+
+		FileView(const boost::shared_array<const char>& data, size_t size) : dataPtr(data), dataSize(size) {}
+
+		const char* data() const { return dataPtr.get(); }
+
+		size_t size() const { return dataSize; }
+
+		const char* begin() const { return dataPtr.get(); }
+
+		const char* end() const { return dataPtr.get() + dataSize; }
+	};
+
+	// Metadata of an entry. The packed size and the CRC are only known by some backends.
+	struct EntryStat
+	{
+		EntryType type;
+		boost::uint64_t size;
+		time_t writeTime;
+
+		bool hasPackedSize;
+		boost::uint64_t packedSize;
+
+		bool hasCrc;
+		boost::uint32_t crc;
+
+		EntryStat() : type(UNKNOWN), size(0), writeTime(0), hasPackedSize(false), packedSize(0), hasCrc(false), crc(0) {}
+	};
+
 	class VFSPP_EXPORT IFileSystemEntry
 	{
 	public:
@@ -72,6 +127,8 @@ namespace vfspp
 			MODE_READ = 1 << 0,
 			MODE_WRITE = 1 << 1,
 			MODE_MEMORY_MAPPED = 1 << 2,
+			// The entry will only be read sequentially, archives may decode while reading instead of up front
+			MODE_STREAMED = 1 << 3,
 		};
 
 	protected:
@@ -88,12 +145,42 @@ namespace vfspp
 
 		virtual FileEntryPointer getChild(const string_type& path) = 0;
 
+		// Variant of getChild() which reports failures by its return value instead of exceptions,
+		// STATUS_NOT_FOUND is returned if the child doesn't exist. outEntry is reset on failure.
+		// The default implementation translates the exceptions of getChild().
+		virtual Status tryGetChild(const string_type& path, FileEntryPointer& outEntry);
+
+		// Looks up an already normalized path, backends use the precomputed hashes of the path instead
+		// of copying and hashing its components again. The default implementation converts it to a string.
+		virtual Status tryGetChild(const NormalizedPath& path, FileEntryPointer& outEntry);
+
 		virtual size_t numChildren() = 0;
 
 		virtual void listChildren(std::vector<FileEntryPointer>& outVector) = 0;
 
 		virtual boost::shared_ptr<std::streambuf> open(int mode = MODE_READ) = 0;
 
+		// Variant of open() which reports failures by its return value instead of exceptions.
+		// The default implementation translates the exceptions of open().
+		virtual Status tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer);
+
+		// Reads up to length bytes starting at offset without an intermediate stream and returns
+		// the number of bytes read, which is only less than length at the end of the file.
+		// Implementations don't share a cursor so concurrent calls are allowed.
+		// The default implementation opens a new stream for every call.
+		virtual size_t readAt(boost::uint64_t offset, void* buffer, size_t length);
+
+		// Provides the contents of the file without copying them. Returns false if the file can't be
+		// accessed as contiguous memory, the contents have to be read through open() or readAt() then.
+		// Like readAt(), throws an InvalidOperationException if the entry is no file or the filesystem
+		// doesn't support reading, and a FileSystemException if reading the contents fails.
+		// The default implementation always returns false.
+		virtual bool getView(FileView& outView);
+
+		// Retrieves type, size and write time at once, backends implement this with as few system
+		// calls or lookups as possible. The default implementation opens files to get their size.
+		virtual EntryStat stat();
+
 		virtual EntryType getType() const = 0;
 
 		virtual bool deleteChild(const string_type& name) = 0;
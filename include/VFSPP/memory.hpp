@@ -2,8 +2,16 @@
 #pragma once
 
 #include <VFSPP/core.hpp>
+#include <VFSPP/path.hpp>
 
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/type_traits/alignment_of.hpp>
 
 #include <boost/shared_array.hpp>
 #include <boost/shared_ptr.hpp>
@@ -13,36 +21,196 @@ namespace vfspp
 	namespace memory
 	{
 		class MemoryFileSystem;
+		class MemoryFileContents;
+		class FrozenIndex;
+
+		// Hands out memory from large slabs which are only released together, a MemoryFileSystem in arena
+		// mode places its entries, their child tables and small files in it. Small blocks which are
+		// deallocated, e.g. when a child table grows, are reused for blocks of the same size class.
+		// Files share ownership of the slab they are stored in, so views of them stay valid after the
+		// arena has been destroyed.
+		class VFSPP_EXPORT MemoryArena : private boost::noncopyable
+		{
+		public:
+			static const size_t SlabSize = 1024 * 1024;
+
+			// Blocks up to this size are reused
+			static const size_t MaxReusedSize = 4096;
+
+			MemoryArena();
+
+			void* allocate(size_t size, size_t alignment);
+
+			void deallocate(void* block, size_t size);
+
+			// The returned array keeps the slab alive
+			boost::shared_array<char> allocateShared(size_t size);
+
+			// Bytes of all slabs
+			size_t size() const { return totalSize; }
 
+		private:
+			std::vector<boost::shared_array<char> > slabs;
+
+			// Slab which is currently filled, allocations bigger than a quarter of a slab get their own
+			boost::shared_array<char> currentSlab;
+			char* current;
+			size_t remaining;
+
+			size_t totalSize;
+
+			// Singly linked lists of free blocks, one for every multiple of the alignment
+			std::vector<void*> freeBlocks;
+
+			// Entries may be released by any thread which held the last reference
+			boost::mutex lock;
+
+			void* allocateFromSlab(size_t size, size_t alignment);
+		};
+
+		// Allocates from the arena if there is one and from the heap otherwise
+		template<typename T>
+		class ArenaAllocator
+		{
+		public:
+			typedef T value_type;
+			typedef T* pointer;
+			typedef const T* const_pointer;
+			typedef T& reference;
+			typedef const T& const_reference;
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+
+			template<typename U>
+			struct rebind
+			{
+				typedef ArenaAllocator<U> other;
+			};
+
+			explicit ArenaAllocator(MemoryArena* arenaIn = NULL) : arena(arenaIn) {}
+
+			template<typename U>
+			ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.getArena()) {}
+
+			MemoryArena* getArena() const { return arena; }
+
+			T* allocate(size_t n, const void* = NULL)
+			{
+				if (arena != NULL)
+				{
+					return static_cast<T*>(arena->allocate(n * sizeof(T), boost::alignment_of<T>::value));
+				}
+
+				return static_cast<T*>(::operator new(n * sizeof(T)));
+			}
+
+			void deallocate(T* p, size_t n)
+			{
+				if (arena != NULL)
+				{
+					arena->deallocate(p, n * sizeof(T));
+				}
+				else
+				{
+					::operator delete(p);
+				}
+			}
+
+			size_t max_size() const { return static_cast<size_t>(-1) / sizeof(T); }
+
+			void construct(T* p, const T& value) { new (p) T(value); }
+
+			void destroy(T* p) { p->~T(); }
+
+			template<typename U>
+			bool operator==(const ArenaAllocator<U>& other) const { return arena == other.getArena(); }
+
+			template<typename U>
+			bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.getArena(); }
+
+		private:
+			MemoryArena* arena;
+		};
+
+		// Files can be written, appended to and created like physical ones. Entries may be read from several
+		// threads at once, changing the tree or writing files requires exclusive access.
 		class VFSPP_EXPORT MemoryFileEntry : public IFileSystemEntry
 		{
 		private:
 			EntryType type;
 
-			std::vector<boost::shared_ptr<MemoryFileEntry> > fileEntries;
-			boost::unordered_map<string_type, size_t> indexMapping;
+			// Position in the index of a frozen filesystem
+			boost::uint32_t frozenId;
+
+			// The parent owns this entry, it is null for the root and for deleted entries
+			MemoryFileEntry* parent;
+
+			typedef std::vector<boost::shared_ptr<MemoryFileEntry>, ArenaAllocator<boost::shared_ptr<MemoryFileEntry> > > ChildVector;
+
+			typedef boost::unordered_map<string_type, size_t, boost::hash<string_type>, std::equal_to<string_type>,
+				ArenaAllocator<std::pair<const string_type, size_t> > > ChildMap;
 
-			size_t dataSize;
-			boost::shared_array<char> data;
+			typedef ChildMap::iterator ChildMapping;
+
+			// The allocators of the child tables refer to the arena of the filesystem
+			ChildVector fileEntries;
+			ChildMap indexMapping;
+
+			// Only set for files, open streams share the contents
+			boost::shared_ptr<MemoryFileContents> contents;
 
 			time_t writeTime;
 
-			MemoryFileEntry(const string_type& path) :
-				IFileSystemEntry(path), dataSize(0), writeTime(0), type(UNKNOWN) {}
+			// Set once the filesystem is frozen, the index owns the entries then and the child tables are empty
+			const FrozenIndex* frozen;
+
+			MemoryFileEntry(const string_type& path, MemoryArena* arena) :
+				IFileSystemEntry(path), type(UNKNOWN), frozenId(0), parent(NULL),
+				fileEntries(ArenaAllocator<boost::shared_ptr<MemoryFileEntry> >(arena)),
+				indexMapping(ArenaAllocator<std::pair<const string_type, size_t> >(arena)), writeTime(0), frozen(NULL) {}
+
+			MemoryArena* getArena() const { return fileEntries.get_allocator().getArena(); }
+
+			boost::shared_ptr<MemoryFileContents> createContents(const boost::shared_array<const char>& data,
+				size_t dataSize, time_t write_time);
 
 			FileEntryPointer getChildInternal(const string_type& path);
 
+			boost::shared_ptr<MemoryFileEntry> addChildEntry(const string_type& name, EntryType type, time_t write_time);
+
+			void insertChild(const string_type& name, const boost::shared_ptr<MemoryFileEntry>& entry);
+
+			// Detaches the child from this directory, returns null if it doesn't exist
+			boost::shared_ptr<MemoryFileEntry> removeChild(const string_type& name);
+
+			void setPath(const string_type& newPath);
+
+			void checkNotFrozen() const;
+
 		public:
-			virtual ~MemoryFileEntry() {}
+			virtual ~MemoryFileEntry();
 
 			virtual FileEntryPointer getChild(const string_type& path) VFSPP_OVERRIDE;
 
+			virtual Status tryGetChild(const string_type& path, FileEntryPointer& outEntry) VFSPP_OVERRIDE;
+
+			virtual Status tryGetChild(const NormalizedPath& path, FileEntryPointer& outEntry) VFSPP_OVERRIDE;
+
 			virtual size_t numChildren() VFSPP_OVERRIDE;
 
 			virtual void listChildren(std::vector<FileEntryPointer>& outVector) VFSPP_OVERRIDE;
 
+			// Like std::ios::out, opening a file with MODE_WRITE but without MODE_READ truncates it
 			virtual boost::shared_ptr<std::streambuf> open(int mode = MODE_READ) VFSPP_OVERRIDE;
 
+			virtual Status tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer) VFSPP_OVERRIDE;
+
+			virtual size_t readAt(boost::uint64_t offset, void* buffer, size_t length) VFSPP_OVERRIDE;
+
+			virtual bool getView(FileView& outView) VFSPP_OVERRIDE;
+
+			virtual EntryStat stat() VFSPP_OVERRIDE;
+
 			virtual EntryType getType() const VFSPP_OVERRIDE;
 
 			virtual bool deleteChild(const string_type& name) VFSPP_OVERRIDE;
@@ -51,29 +219,113 @@ namespace vfspp
 
 			virtual void rename(const string_type& newPath) VFSPP_OVERRIDE;
 
-			virtual time_t lastWriteTime() VFSPP_OVERRIDE { return writeTime; }
+			virtual time_t lastWriteTime() VFSPP_OVERRIDE;
 
+			// Copies the data of files
 			boost::shared_ptr<MemoryFileEntry> addChild(const string_type& name, EntryType type,
 				time_t write_time = 0, void* data = 0, size_t dataSize = 0);
 
+			// Adds a file which shares the buffer instead of copying it. A buffer that isn't allocated with
+			// new[] can be passed with a custom deleter, e.g. one that unmaps it.
+			boost::shared_ptr<MemoryFileEntry> addChild(const string_type& name, const boost::shared_array<const char>& data,
+				size_t dataSize, time_t write_time = 0);
+
+			// Adds a file whose data lies inside of memory owned by owner, e.g. a region of a mapped file.
+			// The owner is kept alive as long as the file or views of it exist.
+			boost::shared_ptr<MemoryFileEntry> addChild(const string_type& name, const boost::shared_ptr<const void>& owner,
+				const char* data, size_t dataSize, time_t write_time = 0);
+
+			// Takes over the contents of the vector without copying them. The vector isn't moved from if the
+			// child can't be added.
+			boost::shared_ptr<MemoryFileEntry> addChild(const string_type& name, std::vector<char>&& data,
+				time_t write_time = 0);
+
 			friend class MemoryFileSystem;
+			friend class FrozenIndex;
 		};
 
 		class VFSPP_EXPORT MemoryFileSystem : public IFileSystem
 		{
 		private:
+			// Declared first so it is destroyed after the entries
+			boost::scoped_ptr<MemoryArena> arena;
+
 			boost::scoped_ptr<MemoryFileEntry> rootEntry;
 
+			// Owns the entries below the root once the filesystem is frozen, declared last so they are released
+			// before the root
+			boost::scoped_ptr<FrozenIndex> frozen;
+
 		public:
-			MemoryFileSystem();
+			// Files which are added as a copy are placed in the arena if they aren't bigger than this
+			static const size_t MaxArenaFileSize = 4096;
+
+			// In arena mode the entries, child tables and small files are allocated from slabs which are
+			// released together with the filesystem. The memory of deleted entries isn't reused, and entries
+			// and streams must not outlive the filesystem, views of files may.
+			explicit MemoryFileSystem(bool useArena = false);
 
-			virtual ~MemoryFileSystem() {}
+			virtual ~MemoryFileSystem();
 			
 			virtual MemoryFileEntry* getRootEntry() VFSPP_OVERRIDE { return rootEntry.get(); }
 
-			virtual int supportedOperations() const VFSPP_OVERRIDE{ return OP_READ; }
+			virtual int supportedOperations() const VFSPP_OVERRIDE;
 
 			virtual string_type getName() const { return "Memory filesystem"; };
+
+			// Returns null if the filesystem isn't in arena mode
+			const MemoryArena* getArena() const { return arena.get(); }
+
+			// Makes the filesystem read only and replaces the child tables of the directories with a
+			// single index of all paths, lookups then hash the path once instead of once per level.
+			// Changing the tree or opening files for writing fails afterwards, and entries must not
+			// outlive the filesystem.
+			void freeze();
+
+			bool isFrozen() const { return frozen.get() != NULL; }
 		};
+
+		struct PreloadOptions
+		{
+			// Number of threads enumerating directories and reading files including the calling thread,
+			// 0 uses one per hardware thread
+			size_t numThreads;
+
+			// Only files whose path relative to the source matches one of these patterns are loaded,
+			// all files if it is empty. See util::matchPattern for the syntax.
+			std::vector<string_type> include;
+
+			// Files and directories whose relative path matches one of these patterns are skipped
+			std::vector<string_type> exclude;
+
+			// Files which would exceed this many bytes in total are skipped, 0 for no limit. Files are
+			// considered in the order of their paths, so the same files are loaded every time.
+			boost::uint64_t maxBytes;
+
+			PreloadOptions() : numThreads(0), maxBytes(0) {}
+		};
+
+		struct PreloadResult
+		{
+			size_t numDirectories;
+			size_t numFiles;
+			boost::uint64_t numBytes;
+
+			// Files which matched the patterns but didn't fit into the byte budget
+			size_t numSkipped;
+
+			PreloadResult() : numDirectories(0), numFiles(0), numBytes(0), numSkipped(0) {}
+		};
+
+		// Copies the subtree below source into the target directory, keeping the write times of the
+		// entries. The directories are enumerated with walk(), then the files are read by a pool of
+		// threads and added to the target without copying them again. Existing directories in the
+		// target are merged, existing files cause a FileSystemException. The first exception stops
+		// the preload and is rethrown, the files which were loaded until then stay in the target.
+		VFSPP_EXPORT PreloadResult preload(IFileSystemEntry* source, MemoryFileEntry* target,
+			const PreloadOptions& options = PreloadOptions());
+
+		VFSPP_EXPORT PreloadResult preload(IFileSystem* source, MemoryFileSystem* target,
+			const PreloadOptions& options = PreloadOptions());
 	}
 }
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <boost/atomic.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 #include "VFSPP/core.hpp"
+#include "VFSPP/path.hpp"
+#include "VFSPP/util.hpp"
 
 namespace vfspp
 {
@@ -16,22 +20,47 @@ namespace vfspp
 		private:
 			FileEntryPointer containedEntry;
 
-			std::vector<boost::shared_ptr<MergedEntry> > cachedChildEntries;
+			// Index of the filesystem providing containedEntry
+			size_t containedLayer;
 
-			boost::unordered_map<string_type, boost::shared_ptr<MergedEntry> > cachedChildMapping;
+			// Snapshot of the children of a directory, never modified after it has been published
+			struct ChildTable
+			{
+				std::vector<boost::shared_ptr<MergedEntry> > entries;
 
-			bool dirty;
+				boost::unordered_map<string_type, boost::shared_ptr<MergedEntry> > mapping;
+			};
 
+			// Only accessed with boost::atomic_load/atomic_store, readers keep the snapshot they loaded alive
+			boost::shared_ptr<const ChildTable> childTable;
+
+			boost::atomic<bool> dirty;
+
+			// Serializes the writers of childTable, readers never take it
 			boost::mutex childrenLock;
 
 			void cacheChildren();
 
+			// Builds and publishes a new table, childrenLock has to be held
+			void rebuildChildTable(const boost::shared_ptr<const ChildTable>& previous);
+
+			// Publishes a copy of the table containing the new entry
+			void insertChild(const string_type& name, const boost::shared_ptr<MergedEntry>& entry);
+
+			boost::shared_ptr<const ChildTable> getChildTable();
+
 			boost::shared_ptr<MergedEntry> getEntryInternal(const string_type& path);
 
-			void addChildren(IFileSystemEntry* entry);
+			void addChildren(size_t layer, IFileSystemEntry* entry, ChildTable& table);
+
+			// Key of a child in the flat index of the filesystem
+			string_type childKey(const string_type& name) const;
+
+			// Entry of the first filesystem which can read the file, used by readAt and getView
+			FileEntryPointer getReadableEntry();
 
 		public:
-			MergedEntry(MergedFileSystem* parentSystem, FileEntryPointer mergedEntry);
+			MergedEntry(MergedFileSystem* parentSystem, FileEntryPointer mergedEntry, size_t layer = 0);
 
 			virtual ~MergedEntry() {}
 
@@ -39,12 +68,24 @@ namespace vfspp
 
 			virtual FileEntryPointer getChild(const string_type& path) VFSPP_OVERRIDE;
 
+			virtual Status tryGetChild(const string_type& path, FileEntryPointer& outEntry) VFSPP_OVERRIDE;
+
+			virtual Status tryGetChild(const NormalizedPath& path, FileEntryPointer& outEntry) VFSPP_OVERRIDE;
+
 			virtual size_t numChildren() VFSPP_OVERRIDE;
 
 			virtual void listChildren(std::vector<FileEntryPointer>& outVector) VFSPP_OVERRIDE;
 
 			virtual boost::shared_ptr<std::streambuf> open(int mode = MODE_READ) VFSPP_OVERRIDE;
 
+			virtual Status tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer) VFSPP_OVERRIDE;
+
+			virtual size_t readAt(boost::uint64_t offset, void* buffer, size_t length) VFSPP_OVERRIDE;
+
+			virtual bool getView(FileView& outView) VFSPP_OVERRIDE;
+
+			virtual EntryStat stat() VFSPP_OVERRIDE;
+
 			virtual EntryType getType() const VFSPP_OVERRIDE;
 
 			virtual bool deleteChild(const string_type& name) VFSPP_OVERRIDE;
@@ -65,11 +106,32 @@ namespace vfspp
 		private:
 			std::vector<boost::shared_ptr<IFileSystem> > fileSystems;
 
+			// Membership filters of the paths in each filesystem, null for filesystems without one
+			std::vector<boost::shared_ptr<util::BloomFilter> > layerFilters;
+
 			boost::scoped_ptr<MergedEntry> rootEntry;
 
 			bool caseInsensitive;
 
-			void populateChildren(MergedEntry* entry, int levels);
+			// Optional map from full normalized paths to the entries, filled whenever children are cached.
+			// The flag is written under flatIndexLock but read by lookups without it.
+			boost::atomic<bool> flatIndexEnabled;
+			boost::unordered_map<string_type, boost::shared_ptr<MergedEntry> > flatIndex;
+			mutable boost::shared_mutex flatIndexLock;
+
+			string_type indexKey(const string_type& path) const;
+
+			boost::shared_ptr<MergedEntry> findIndexed(const string_type& key) const;
+
+			boost::shared_ptr<MergedEntry> findIndexed(const PathKey& key) const;
+
+			void indexEntry(const string_type& key, const boost::shared_ptr<MergedEntry>& entry);
+
+			// Removes the entry and everything below it from the index
+			void unindexEntry(const string_type& key);
+
+			// Looks up the path in one filesystem, skips the lookup if the filter rules the path out
+			FileEntryPointer getLayerEntry(size_t layer, const string_type& path) const;
 
 		public:
 			MergedFileSystem();
@@ -82,10 +144,23 @@ namespace vfspp
 
 			virtual int supportedOperations() const VFSPP_OVERRIDE;
 
+			// Caches the children of all directories up to the given depth, directories are listed in parallel
 			void populateEntries(int levels = 2);
 
 			void setCaseInsensitive(bool b) { caseInsensitive = b; }
 
+			// Builds a filter over the paths of every filesystem which can't be modified so lookups of paths
+			// that a filesystem doesn't contain don't reach it. Should be called after all filesystems have
+			// been added, writable filesystems are always queried.
+			void buildLayerFilters();
+
+			// Resolves complete paths with a single lookup instead of walking the directories. The index is
+			// filled by populateEntries() and when directories are cached, and updated when entries are
+			// created, deleted or renamed through this filesystem.
+			void setFlatIndexEnabled(bool enabled);
+
+			bool isFlatIndexEnabled() const { return flatIndexEnabled; }
+
 			virtual string_type getName() const { return "Merged file system"; }
 
 			friend class MergedEntry;
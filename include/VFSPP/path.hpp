@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/container/small_vector.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include "VFSPP/core.hpp"
+
+namespace vfspp
+{
+	// A string together with its precomputed hash, used to look up string keys in a boost::unordered_map
+	// without constructing a string: map.find(key, PathKeyHash(), PathKeyEqual())
+	struct PathKey
+	{
+		boost::string_ref str;
+		size_t hash;
+
+		PathKey(boost::string_ref strIn, size_t hashIn) : str(strIn), hash(hashIn) {}
+	};
+
+	struct PathKeyHash
+	{
+		size_t operator()(const PathKey& key) const { return key.hash; }
+	};
+
+	struct PathKeyEqual
+	{
+		bool operator()(const PathKey& key, const string_type& str) const { return key.str == str; }
+	};
+
+	// A path normalized like util::normalizePath() without copying it. The path refers to the buffer it
+	// was created from, which has to outlive it, unless it had to be converted to lower case.
+	// The hashes of the complete path and of every component are computed once and match the ones
+	// boost::hash computes for the equivalent strings, so one path can be used for many lookups.
+	class VFSPP_EXPORT NormalizedPath : boost::noncopyable
+	{
+	private:
+		struct Component
+		{
+			size_t offset;
+			size_t length;
+			size_t hash;
+		};
+
+		// Only used if the path had to be converted to lower case
+		string_type lowerCaseStorage;
+
+		const char* pathData;
+		size_t pathSize;
+		size_t pathHash;
+
+		bool lowerCase;
+
+		boost::container::small_vector<Component, 8> components;
+
+		void init(const char* begin, const char* end);
+
+	public:
+		explicit NormalizedPath(const string_type& path, bool lowerCase = false);
+
+		explicit NormalizedPath(const char* path, bool lowerCase = false);
+
+		boost::string_ref str() const { return boost::string_ref(pathData, pathSize); }
+
+		string_type toString() const { return string_type(pathData, pathSize); }
+
+		bool empty() const { return pathSize == 0; }
+
+		bool isLowerCase() const { return lowerCase; }
+
+		size_t hash() const { return pathHash; }
+
+		PathKey key() const { return PathKey(str(), pathHash); }
+
+		size_t numComponents() const { return components.size(); }
+
+		boost::string_ref component(size_t index) const
+		{
+			return boost::string_ref(pathData + components[index].offset, components[index].length);
+		}
+
+		PathKey componentKey(size_t index) const { return PathKey(component(index), components[index].hash); }
+	};
+
+	// Interned set of normalized paths. Every path is stored as its parent and the name of its last
+	// component, names are stored once no matter how often they occur, so the prefixes shared by the
+	// paths of a large tree take no additional memory. Ids are assigned consecutively, the empty root
+	// path has id 0 and parents always have a lower id than their children.
+	class VFSPP_EXPORT PathTable
+	{
+	public:
+		typedef boost::uint32_t PathId;
+
+		static const PathId RootPath = 0;
+
+		static const PathId InvalidPath = 0xFFFFFFFF;
+
+	private:
+		struct Node
+		{
+			PathId parent;
+			boost::uint32_t name;
+		};
+
+		std::vector<Node> nodes;
+
+		// Characters of all distinct names, name i occupies [nameOffsets[i], nameOffsets[i + 1])
+		std::vector<char> nameChars;
+		std::vector<boost::uint32_t> nameOffsets;
+
+		// Open addressing hash tables containing name ids and path ids, InvalidPath marks an empty slot
+		std::vector<boost::uint32_t> nameSlots;
+		std::vector<PathId> childSlots;
+
+		boost::uint32_t findName(boost::string_ref name, size_t hash) const;
+
+		boost::uint32_t internName(boost::string_ref name);
+
+		PathId lookupChild(PathId parent, boost::uint32_t name) const;
+
+		void insertSlot(std::vector<boost::uint32_t>& slots, boost::uint32_t value, size_t hash);
+
+		void growNameSlots();
+
+		void growChildSlots();
+
+	public:
+		PathTable();
+
+		// Adds the normalized path and all of its parents, returns the id of the path
+		PathId intern(boost::string_ref path);
+
+		// Returns InvalidPath if the path hasn't been added
+		PathId find(boost::string_ref path) const;
+
+		// Uses the precomputed hashes of the components
+		PathId find(const NormalizedPath& path) const;
+
+		PathId findChild(PathId parent, boost::string_ref name) const;
+
+		PathId getParent(PathId id) const { return nodes[id].parent; }
+
+		boost::string_ref getName(PathId id) const;
+
+		string_type getPath(PathId id) const;
+
+		// Number of paths including the root
+		size_t size() const { return nodes.size(); }
+
+		size_t numNames() const { return nameOffsets.size() - 1; }
+
+		void reserve(size_t numPaths);
+
+		// Releases the memory reserved for further paths
+		void shrinkToFit();
+	};
+}
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <list>
+
+#include <boost/atomic.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "vfspp_export.h"
 
@@ -10,6 +15,7 @@
 namespace vfspp {
 	namespace system {
 		class PhysicalFileSystem;
+		class ReadHandle;
 
 		class VFSPP_EXPORT PhysicalEntry : public IFileSystemEntry
 		{
@@ -18,21 +24,44 @@ namespace vfspp {
 
 			boost::filesystem::path entryPath;
 
+			// Type captured when the entry was enumerated, -1 if the type is queried on every call
+			mutable boost::atomic<int> cachedType;
+
 		public:
 			PhysicalEntry(PhysicalFileSystem* parentSystem, const vfspp::string_type& path);
 
-			virtual ~PhysicalEntry() {}
+			// Creates an entry whose type is already known, getType() returns it until refresh() is called
+			PhysicalEntry(PhysicalFileSystem* parentSystem, const vfspp::string_type& path, EntryType knownType);
+
+			virtual ~PhysicalEntry();
+
+			// Queries the type of the entry again if it was captured when the entry was created
+			void refresh();
 
 			const boost::filesystem::path& getEntryPath() const { return entryPath; }
 
 			virtual FileEntryPointer getChild(const string_type& path) VFSPP_OVERRIDE;
 
+			virtual Status tryGetChild(const string_type& path, FileEntryPointer& outEntry) VFSPP_OVERRIDE;
+
+			// Looking up normalized paths has no advantage for physical files
+			using IFileSystemEntry::tryGetChild;
+
 			virtual size_t numChildren() VFSPP_OVERRIDE;
 
 			virtual void listChildren(std::vector<FileEntryPointer>& outVector) VFSPP_OVERRIDE;
 
 			virtual boost::shared_ptr<std::streambuf> open(int mode = MODE_READ) VFSPP_OVERRIDE;
 
+			virtual Status tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer) VFSPP_OVERRIDE;
+
+			// The file stays open for later calls, the filesystem keeps at most MaxReadHandles files open
+			virtual size_t readAt(boost::uint64_t offset, void* buffer, size_t length) VFSPP_OVERRIDE;
+
+			virtual bool getView(FileView& outView) VFSPP_OVERRIDE;
+
+			virtual EntryStat stat() VFSPP_OVERRIDE;
+
 			virtual EntryType getType() const VFSPP_OVERRIDE;
 
 			virtual bool deleteChild(const string_type& name) VFSPP_OVERRIDE;
@@ -51,11 +80,27 @@ namespace vfspp {
 		private:
 			boost::filesystem::path physicalRoot;
 
+			// Files opened by readAt, most recently used first. The least recently used one is closed when
+			// another file is opened, reads which are still using it keep it open until they are done.
+			// Declared before the root so they are closed after it.
+			typedef std::list<std::pair<const PhysicalEntry*, boost::shared_ptr<ReadHandle> > > ReadHandleList;
+
+			ReadHandleList readHandles;
+			boost::unordered_map<const PhysicalEntry*, ReadHandleList::iterator> readHandleMapping;
+			boost::mutex readHandleLock;
+
 			boost::scoped_ptr<PhysicalEntry> rootDir;
 
 			int operations;
 
+			boost::shared_ptr<ReadHandle> getReadHandle(const PhysicalEntry* entry);
+
+			void closeReadHandle(const PhysicalEntry* entry);
+
 		public:
+			// Number of files readAt keeps open across calls
+			static const size_t MaxReadHandles = 64;
+
 			PhysicalFileSystem(const boost::filesystem::path& physicalRoot);
 
 			virtual ~PhysicalFileSystem() {}
@@ -75,6 +120,8 @@ namespace vfspp {
 			}
 
 			virtual string_type getName() const { return physicalRoot.string(); }
+
+			friend class PhysicalEntry;
 		};
 	}
 }
@@ -1,24 +1,55 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+
 #include <VFSPP/core.hpp>
+#include <VFSPP/path.hpp>
 
 #include <boost/unordered_map.hpp>
 
 #include <boost/filesystem/path.hpp>
+#include <boost/range/iterator_range.hpp>
 
 namespace vfspp
 {
 	namespace util
 	{
+		// Narrows [begin, end) to the normalized path: Surrounding whitespace is removed first, then surrounding separators
+		inline void trimPath(const char*& begin, const char*& end)
+		{
+			while (begin != end && std::isspace(static_cast<unsigned char>(*begin)))
+			{
+				++begin;
+			}
+			while (end != begin && std::isspace(static_cast<unsigned char>(end[-1])))
+			{
+				--end;
+			}
+
+			while (begin != end && *begin == DirectorySeparatorChar)
+			{
+				++begin;
+			}
+			while (end != begin && end[-1] == DirectorySeparatorChar)
+			{
+				--end;
+			}
+		}
+
 		template<class InType, class OutType = InType>
 		OutType normalizePath(const InType& inPath, bool lowerCase = false)
 		{
 			OutType outPath(inPath);
 
-			boost::trim(outPath);
+			// Trimmed in place, the copy above is the only allocation
+			const char* begin = outPath.data();
+			const char* end = begin + outPath.size();
+			trimPath(begin, end);
 
-			boost::trim_if(outPath, boost::is_any_of(DirectorySeparatorStr));
+			outPath.erase(end - outPath.data());
+			outPath.erase(0, begin - outPath.data());
 
 			if (lowerCase)
 			{
@@ -35,6 +66,34 @@ namespace vfspp
 
 		int modeToOperation(int mode);
 
+		// Throws the exception the throwing variant of a function reports the status with, does nothing
+		// for STATUS_OK and STATUS_NOT_FOUND since misses aren't errors
+		void throwStatus(Status status);
+
+		// Matches a normalized path against a glob pattern. * matches any characters except the directory
+		// separator, ** matches across separators and **/ also matches no directory at all, ? matches a
+		// single character except the separator.
+		bool matchPattern(const string_type& pattern, const string_type& path);
+
+		// Set membership test which can answer "definitely not contained" without storing the strings.
+		// False positives happen at a rate of about 1% when the expected number of strings is not exceeded.
+		class VFSPP_EXPORT BloomFilter
+		{
+		private:
+			std::vector<boost::uint64_t> bits;
+
+			size_t numHashes;
+
+		public:
+			explicit BloomFilter(size_t expectedStrings, size_t bitsPerString = 10);
+
+			void insert(const string_type& str);
+
+			bool mayContain(const string_type& str) const;
+
+			size_t numBits() const { return bits.size() * 64; }
+		};
+
 		template<typename DataType>
 		class VFSPP_EXPORT ArchiveFileSystem : public IFileSystem
 		{
@@ -54,13 +113,135 @@ namespace vfspp
 
 			boost::filesystem::path filePath;
 			
+			// Entries are identified by their index in fileData, their paths are interned in paths
 			std::vector<data_type> fileData;
-			boost::unordered_map<string_type, size_t> fileIndexes;
+			std::vector<PathTable::PathId> filePaths;
+
+			PathTable paths;
+
+			static const boost::uint32_t NoFile = 0xFFFFFFFF;
+
+			// Index in fileData for every path id, NoFile for the root and paths which haven't been added
+			std::vector<boost::uint32_t> fileIndexes;
+
+			// The indexes of the direct children of path id i are childList[childOffsets[i], childOffsets[i + 1])
+			std::vector<boost::uint32_t> childOffsets;
+			std::vector<boost::uint32_t> childList;
+
+			void reserveFileData(size_t numFiles)
+			{
+				fileData.reserve(numFiles);
+				filePaths.reserve(numFiles);
+				paths.reserve(numFiles + 1);
+			}
 
 			void addFileData(const string_type& path, const data_type& data)
 			{
+				if (path.empty())
+				{
+					return;
+				}
+
+				PathTable::PathId id = paths.intern(path);
+
+				if (fileIndexes.size() < paths.size())
+				{
+					fileIndexes.resize(paths.size(), NoFile);
+				}
+
+				if (fileIndexes[id] != NoFile)
+				{
+					// Duplicate entry, the first one wins
+					return;
+				}
+
+				fileIndexes[id] = static_cast<boost::uint32_t>(fileData.size());
 				fileData.push_back(data);
-				fileIndexes.insert(std::make_pair(path, fileData.size() - 1));
+				filePaths.push_back(id);
+			}
+
+			// Builds the parent->children index, must be called after all file data has been added.
+			// Directories which only exist implicitly as the parent of another entry are added as well.
+			void buildChildIndex()
+			{
+				fileIndexes.resize(paths.size(), NoFile);
+
+				size_t numImplicit = std::count(fileIndexes.begin() + 1, fileIndexes.end(), NoFile);
+				fileData.reserve(fileData.size() + numImplicit);
+				filePaths.reserve(filePaths.size() + numImplicit);
+
+				for (PathTable::PathId id = 1; id < paths.size(); ++id)
+				{
+					if (fileIndexes[id] == NoFile)
+					{
+						data_type implicitDir = data_type();
+						implicitDir.type = DIRECTORY;
+
+						fileIndexes[id] = static_cast<boost::uint32_t>(fileData.size());
+						fileData.push_back(implicitDir);
+						filePaths.push_back(id);
+					}
+				}
+
+				// Counting sort of the entries by their parent, keeps the order of fileData for siblings
+				childOffsets.assign(paths.size() + 1, 0);
+				for (size_t i = 0; i < filePaths.size(); ++i)
+				{
+					++childOffsets[paths.getParent(filePaths[i]) + 1];
+				}
+				for (size_t i = 1; i < childOffsets.size(); ++i)
+				{
+					childOffsets[i] += childOffsets[i - 1];
+				}
+
+				std::vector<boost::uint32_t> insertPositions(childOffsets.begin(), childOffsets.end() - 1);
+
+				childList.resize(filePaths.size());
+				for (size_t i = 0; i < filePaths.size(); ++i)
+				{
+					childList[insertPositions[paths.getParent(filePaths[i])]++] = static_cast<boost::uint32_t>(i);
+				}
+
+				paths.shrinkToFit();
+				fileIndexes.shrink_to_fit();
+			}
+
+			boost::iterator_range<const boost::uint32_t*> getChildIndexes(const string_type& path) const
+			{
+				PathTable::PathId id = paths.find(path);
+
+				if (id == PathTable::InvalidPath || id + 1 >= childOffsets.size())
+				{
+					return boost::iterator_range<const boost::uint32_t*>();
+				}
+
+				return boost::iterator_range<const boost::uint32_t*>(childList.data() + childOffsets[id], childList.data() + childOffsets[id + 1]);
+			}
+
+			string_type getEntryPath(size_t index) const
+			{
+				return paths.getPath(filePaths[index]);
+			}
+
+			const data_type* findFileData(PathTable::PathId id) const
+			{
+				if (id == PathTable::InvalidPath || id >= fileIndexes.size() || fileIndexes[id] == NoFile)
+				{
+					return NULL;
+				}
+
+				return &fileData[fileIndexes[id]];
+			}
+
+			// Returns null if there is no entry with that path, the root has no data
+			const data_type* findFileData(const string_type& path) const
+			{
+				return findFileData(paths.find(path));
+			}
+
+			const data_type* findFileData(const NormalizedPath& path) const
+			{
+				return findFileData(paths.find(path));
 			}
 
 			data_type getFileData(const string_type& path) const
@@ -74,17 +255,13 @@ namespace vfspp
 					return data;
 				}
 
-				boost::unordered_map<string_type, size_t>::const_iterator iter = fileIndexes.find(path);
+				const data_type* data = findFileData(path);
 
-				if (iter == fileIndexes.end())
-				{
-					return data_type();
-				}
-				else
-				{
-					return fileData[iter->second];
-				}
+				return data ? *data : data_type();
 			}
 		};
+
+		template<typename DataType>
+		const boost::uint32_t ArchiveFileSystem<DataType>::NoFile;
 	}
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <boost/function.hpp>
+
+#include "VFSPP/core.hpp"
+
+namespace vfspp
+{
+	// Called for every entry found by walk(), depth is 1 for the direct children of the start entry
+	typedef boost::function<void (const FileEntryPointer& entry, int depth)> WalkCallback;
+
+	// Decides if the children of a directory should be enumerated
+	typedef boost::function<bool (const FileEntryPointer& directory, int depth)> WalkFilter;
+
+	struct WalkOptions
+	{
+		// Number of threads enumerating directories including the calling thread, 0 uses one per hardware thread
+		size_t numThreads;
+
+		// Directories at this depth are reported but not enumerated, 0 reports nothing, negative for no limit
+		int maxDepth;
+
+		// Directories for which this returns false are reported but not enumerated
+		WalkFilter descend;
+
+		WalkOptions() : numThreads(0), maxDepth(-1) {}
+	};
+
+	// Enumerates all entries below start. Directories are distributed over a pool of threads which
+	// steal work from each other, so the callback is invoked concurrently and in no particular order.
+	// The first exception thrown by an entry or the callback stops the walk and is rethrown.
+	VFSPP_EXPORT void walk(IFileSystemEntry* start, const WalkCallback& callback, const WalkOptions& options = WalkOptions());
+
+	VFSPP_EXPORT void walk(IFileSystem* fileSystem, const WalkCallback& callback, const WalkOptions& options = WalkOptions());
+
+	// Collects all entries below start
+	VFSPP_EXPORT void walk(IFileSystemEntry* start, std::vector<FileEntryPointer>& outEntries, const WalkOptions& options = WalkOptions());
+}
@@ -21,9 +21,16 @@
   UInt32 MY_FAST_CALL CrcUpdateT4(UInt32 v, const void *data, size_t size, const UInt32 *table);
 #endif
 
+#if defined(MY_CPU_X86_OR_AMD64) && defined(MY_CPU_CLMUL_COMPILER)
+  #define CRC_USE_CLMUL
+  UInt32 MY_FAST_CALL CrcUpdateClmul(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#endif
+
 typedef UInt32 (MY_FAST_CALL *CRC_FUNC)(UInt32 v, const void *data, size_t size, const UInt32 *table);
 
 static CRC_FUNC g_CrcUpdate;
+static CRC_FUNC g_CrcUpdateTable;
+static ECrcImpl g_CrcImpl;
 UInt32 g_CrcTable[256 * CRC_NUM_TABLES];
 
 UInt32 MY_FAST_CALL CrcUpdate(UInt32 v, const void *data, size_t size)
@@ -80,4 +87,41 @@ void MY_FAST_CALL CrcGenerateTable()
     }
   }
   #endif
+
+  g_CrcUpdateTable = g_CrcUpdate;
+  g_CrcImpl = CRC_IMPL_TABLE;
+
+  #ifdef CRC_USE_CLMUL
+  if (CPU_Is_Clmul_Supported())
+  {
+    g_CrcUpdate = CrcUpdateClmul;
+    g_CrcImpl = CRC_IMPL_CLMUL;
+  }
+  #endif
+}
+
+Bool MY_FAST_CALL CrcSetImpl(ECrcImpl impl)
+{
+  switch (impl)
+  {
+    case CRC_IMPL_TABLE:
+      g_CrcUpdate = g_CrcUpdateTable;
+      break;
+    #ifdef CRC_USE_CLMUL
+    case CRC_IMPL_CLMUL:
+      if (!CPU_Is_Clmul_Supported())
+        return False;
+      g_CrcUpdate = CrcUpdateClmul;
+      break;
+    #endif
+    default:
+      return False;
+  }
+  g_CrcImpl = impl;
+  return True;
+}
+
+ECrcImpl MY_FAST_CALL CrcGetImpl()
+{
+  return g_CrcImpl;
 }
@@ -28,7 +28,145 @@ UInt32 MY_FAST_CALL CrcUpdateT4(UInt32 v, const void *data, size_t size, const U
 
 UInt32 MY_FAST_CALL CrcUpdateT8(UInt32 v, const void *data, size_t size, const UInt32 *table)
 {
-  return CrcUpdateT4(v, data, size, table);
+  const Byte *p = (const Byte *)data;
+  for (; size > 0 && ((unsigned)(ptrdiff_t)p & 7) != 0; size--, p++)
+    v = CRC_UPDATE_BYTE_2(v, *p);
+  for (; size >= 8; size -= 8, p += 8)
+  {
+    UInt32 d;
+    v ^= *(const UInt32 *)p;
+    d = *((const UInt32 *)p + 1);
+    v =
+      table[0x700 + (v & 0xFF)] ^
+      table[0x600 + ((v >> 8) & 0xFF)] ^
+      table[0x500 + ((v >> 16) & 0xFF)] ^
+      table[0x400 + ((v >> 24))] ^
+      table[0x300 + (d & 0xFF)] ^
+      table[0x200 + ((d >> 8) & 0xFF)] ^
+      table[0x100 + ((d >> 16) & 0xFF)] ^
+      table[0x000 + ((d >> 24))];
+  }
+  for (; size > 0; size--, p++)
+    v = CRC_UPDATE_BYTE_2(v, *p);
+  return v;
+}
+
+#endif
+
+
+#if defined(MY_CPU_X86_OR_AMD64) && defined(MY_CPU_CLMUL_COMPILER)
+
+/*
+Folding with carry-less multiplication as described in
+"Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009).
+The constants are x^n mod P(x) for the bit-reflected polynomial 0xEDB88320.
+*/
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define CRC_CLMUL_TARGET __attribute__((target("sse2,pclmul")))
+#else
+  #define CRC_CLMUL_TARGET
+#endif
+
+#ifdef _MSC_VER
+  #define CRC_ALIGN16 __declspec(align(16))
+#else
+  #define CRC_ALIGN16 __attribute__((aligned(16)))
+#endif
+
+static const UInt64 CRC_ALIGN16 kCrcFold4[2] = { 0x0154442bd4, 0x01c6e41596 }; /* x^(4*128+32), x^(4*128-32) */
+static const UInt64 CRC_ALIGN16 kCrcFold1[2] = { 0x01751997d0, 0x00ccaa009e }; /* x^(128+32), x^(128-32) */
+static const UInt64 CRC_ALIGN16 kCrcFold64[2] = { 0x0163cd6124, 0 };          /* x^64 */
+static const UInt64 CRC_ALIGN16 kCrcBarrett[2] = { 0x01db710641, 0x01f7011641 }; /* P(x), floor(x^64 / P(x)) */
+
+/* size must be a multiple of 16 and at least 64 */
+static CRC_CLMUL_TARGET UInt32 CrcFoldClmul(UInt32 v, const Byte *p, size_t size)
+{
+  __m128i x0, x1, x2, x3, x4, t1, t2, t3, t4, mask;
+
+  x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + 0x00)), _mm_cvtsi32_si128((int)v));
+  x2 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+  x3 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+  x4 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+  p += 64;
+  size -= 64;
+
+  /* Four independent folds hide the latency of the multiplications */
+  x0 = _mm_load_si128((const __m128i *)kCrcFold4);
+  for (; size >= 64; size -= 64, p += 64)
+  {
+    t1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    t2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    t3 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    t4 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), _mm_loadu_si128((const __m128i *)(p + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, t2), _mm_loadu_si128((const __m128i *)(p + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, t3), _mm_loadu_si128((const __m128i *)(p + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, t4), _mm_loadu_si128((const __m128i *)(p + 0x30)));
+  }
+
+  /* Fold the four lanes into one */
+  x0 = _mm_load_si128((const __m128i *)kCrcFold1);
+
+  t1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), x2);
+
+  t1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), x3);
+
+  t1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), x4);
+
+  for (; size >= 16; size -= 16, p += 16)
+  {
+    t1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), _mm_loadu_si128((const __m128i *)p));
+  }
+
+  /* 128 -> 64 bits */
+  mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+  x0 = _mm_loadl_epi64((const __m128i *)kCrcFold64);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /* Barrett reduction to 32 bits */
+  x0 = _mm_load_si128((const __m128i *)kCrcBarrett);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), x0, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return (UInt32)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+UInt32 MY_FAST_CALL CrcUpdateClmul(UInt32 v, const void *data, size_t size, const UInt32 *table)
+{
+  const Byte *p = (const Byte *)data;
+  if (size >= 64)
+  {
+    size_t folded = size & ~(size_t)15;
+    v = CrcFoldClmul(v, p, folded);
+    p += folded;
+    size -= folded;
+  }
+  return CrcUpdateT8(v, p, size, table);
 }
 
 #endif
@@ -124,8 +124,11 @@ static SRes SzDecodePpmd(CSzCoderInfo *coder, UInt64 inSize, ILookInStream *inSt
 #endif
 
 
+/* Decoded data is passed to the progress in pieces of this size so it is still cached when it's processed */
+#define kProgressStep (1 << 18)
+
 static SRes SzDecodeLzma(CSzCoderInfo *coder, UInt64 inSize, ILookInStream *inStream,
-    Byte *outBuffer, SizeT outSize, ISzAlloc *allocMain)
+    Byte *outBuffer, SizeT outSize, ISzAlloc *allocMain, IDecodeProgress *progress)
 {
   CLzmaDec state;
   SRes res = SZ_OK;
@@ -148,12 +151,22 @@ static SRes SzDecodeLzma(CSzCoderInfo *coder, UInt64 inSize, ILookInStream *inSt
 
     {
       SizeT inProcessed = (SizeT)lookahead, dicPos = state.dicPos;
+      SizeT dicLimit = outSize;
       ELzmaStatus status;
-      res = LzmaDec_DecodeToDic(&state, outSize, inBuf, &inProcessed, LZMA_FINISH_END, &status);
+      if (progress && outSize - dicPos > kProgressStep)
+        dicLimit = dicPos + kProgressStep;
+      res = LzmaDec_DecodeToDic(&state, dicLimit, inBuf, &inProcessed,
+          dicLimit == outSize ? LZMA_FINISH_END : LZMA_FINISH_ANY, &status);
       lookahead -= inProcessed;
       inSize -= inProcessed;
       if (res != SZ_OK)
         break;
+      if (progress && state.dicPos != dicPos)
+      {
+        res = progress->Process(progress, outBuffer + dicPos, state.dicPos - dicPos);
+        if (res != SZ_OK)
+          break;
+      }
       if (state.dicPos == state.dicBufSize || (inProcessed == 0 && dicPos == state.dicPos))
       {
         if (state.dicBufSize != outSize || lookahead != 0 ||
@@ -173,7 +186,7 @@ static SRes SzDecodeLzma(CSzCoderInfo *coder, UInt64 inSize, ILookInStream *inSt
 }
 
 static SRes SzDecodeLzma2(CSzCoderInfo *coder, UInt64 inSize, ILookInStream *inStream,
-    Byte *outBuffer, SizeT outSize, ISzAlloc *allocMain)
+    Byte *outBuffer, SizeT outSize, ISzAlloc *allocMain, IDecodeProgress *progress)
 {
   CLzma2Dec state;
   SRes res = SZ_OK;
@@ -198,12 +211,22 @@ static SRes SzDecodeLzma2(CSzCoderInfo *coder, UInt64 inSize, ILookInStream *inS
 
     {
       SizeT inProcessed = (SizeT)lookahead, dicPos = state.decoder.dicPos;
+      SizeT dicLimit = outSize;
       ELzmaStatus status;
-      res = Lzma2Dec_DecodeToDic(&state, outSize, inBuf, &inProcessed, LZMA_FINISH_END, &status);
+      if (progress && outSize - dicPos > kProgressStep)
+        dicLimit = dicPos + kProgressStep;
+      res = Lzma2Dec_DecodeToDic(&state, dicLimit, inBuf, &inProcessed,
+          dicLimit == outSize ? LZMA_FINISH_END : LZMA_FINISH_ANY, &status);
       lookahead -= inProcessed;
       inSize -= inProcessed;
       if (res != SZ_OK)
         break;
+      if (progress && state.decoder.dicPos != dicPos)
+      {
+        res = progress->Process(progress, outBuffer + dicPos, state.decoder.dicPos - dicPos);
+        if (res != SZ_OK)
+          break;
+      }
       if (state.decoder.dicPos == state.decoder.dicBufSize || (inProcessed == 0 && dicPos == state.decoder.dicPos))
       {
         if (state.decoder.dicBufSize != outSize || lookahead != 0 ||
@@ -221,7 +244,7 @@ static SRes SzDecodeLzma2(CSzCoderInfo *coder, UInt64 inSize, ILookInStream *inS
   return res;
 }
 
-static SRes SzDecodeCopy(UInt64 inSize, ILookInStream *inStream, Byte *outBuffer)
+static SRes SzDecodeCopy(UInt64 inSize, ILookInStream *inStream, Byte *outBuffer, IDecodeProgress *progress)
 {
   while (inSize > 0)
   {
@@ -233,6 +256,8 @@ static SRes SzDecodeCopy(UInt64 inSize, ILookInStream *inStream, Byte *outBuffer
     if (curSize == 0)
       return SZ_ERROR_INPUT_EOF;
     memcpy(outBuffer, inBuf, curSize);
+    if (progress)
+      RINOK(progress->Process(progress, outBuffer, curSize));
     outBuffer += curSize;
     inSize -= curSize;
     RINOK(inStream->Skip((void *)inStream, curSize));
@@ -335,9 +360,11 @@ static UInt64 GetSum(const UInt64 *values, UInt32 index)
 static SRes SzFolder_Decode2(const CSzFolder *folder, const UInt64 *packSizes,
     ILookInStream *inStream, UInt64 startPos,
     Byte *outBuffer, SizeT outSize, ISzAlloc *allocMain,
-    Byte *tempBuf[])
+    Byte *tempBuf[], IDecodeProgress *progress)
 {
   UInt32 ci;
+  /* Only a single coder writes the final data directly, filters change it after decoding */
+  IDecodeProgress *mainProgress = (folder->NumCoders == 1) ? progress : NULL;
   SizeT tempSizes[3] = { 0, 0, 0};
   SizeT tempSize3 = 0;
   Byte *tempBuf3 = 0;
@@ -390,20 +417,22 @@ static SRes SzFolder_Decode2(const CSzFolder *folder, const UInt64 *packSizes,
       {
         if (inSize != outSizeCur) /* check it */
           return SZ_ERROR_DATA;
-        RINOK(SzDecodeCopy(inSize, inStream, outBufCur));
+        RINOK(SzDecodeCopy(inSize, inStream, outBufCur, mainProgress));
       }
       else if (coder->MethodID == k_LZMA)
       {
-        RINOK(SzDecodeLzma(coder, inSize, inStream, outBufCur, outSizeCur, allocMain));
+        RINOK(SzDecodeLzma(coder, inSize, inStream, outBufCur, outSizeCur, allocMain, mainProgress));
       }
       else if (coder->MethodID == k_LZMA2)
       {
-        RINOK(SzDecodeLzma2(coder, inSize, inStream, outBufCur, outSizeCur, allocMain));
+        RINOK(SzDecodeLzma2(coder, inSize, inStream, outBufCur, outSizeCur, allocMain, mainProgress));
       }
       else
       {
         #ifdef _7ZIP_PPMD_SUPPPORT
         RINOK(SzDecodePpmd(coder, inSize, inStream, outBufCur, outSizeCur, allocMain));
+        if (mainProgress)
+          RINOK(mainProgress->Process(mainProgress, outBufCur, outSizeCur));
         #else
         return SZ_ERROR_UNSUPPORTED;
         #endif
@@ -423,7 +452,7 @@ static SRes SzFolder_Decode2(const CSzFolder *folder, const UInt64 *packSizes,
       tempBuf[2] = (Byte *)IAlloc_Alloc(allocMain, tempSizes[2]);
       if (tempBuf[2] == 0 && tempSizes[2] != 0)
         return SZ_ERROR_MEM;
-      res = SzDecodeCopy(s3Size, inStream, tempBuf[2]);
+      res = SzDecodeCopy(s3Size, inStream, tempBuf[2], NULL);
       RINOK(res)
 
       res = Bcj2_Decode(
@@ -453,17 +482,26 @@ static SRes SzFolder_Decode2(const CSzFolder *folder, const UInt64 *packSizes,
       }
     }
   }
+  if (progress && !mainProgress)
+    return progress->Process(progress, outBuffer, outSize);
   return SZ_OK;
 }
 
 SRes SzFolder_Decode(const CSzFolder *folder, const UInt64 *packSizes,
     ILookInStream *inStream, UInt64 startPos,
     Byte *outBuffer, size_t outSize, ISzAlloc *allocMain)
+{
+  return SzFolder_DecodeWithProgress(folder, packSizes, inStream, startPos, outBuffer, outSize, allocMain, NULL);
+}
+
+SRes SzFolder_DecodeWithProgress(const CSzFolder *folder, const UInt64 *packSizes,
+    ILookInStream *inStream, UInt64 startPos,
+    Byte *outBuffer, size_t outSize, ISzAlloc *allocMain, IDecodeProgress *progress)
 {
   Byte *tempBuf[3] = { 0, 0, 0};
   int i;
   SRes res = SzFolder_Decode2(folder, packSizes, inStream, startPos,
-      outBuffer, (SizeT)outSize, allocMain, tempBuf);
+      outBuffer, (SizeT)outSize, allocMain, tempBuf, progress);
   for (i = 0; i < 3; i++)
     IAlloc_Free(allocMain, tempBuf[i]);
   return res;
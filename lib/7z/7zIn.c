@@ -1223,6 +1223,7 @@ static SRes SzArEx_Open2(
   size_t nextHeaderSizeT;
   UInt32 nextHeaderCRC;
   CBuf buffer;
+  Bool bufferBorrowed = False;
   SRes res;
 
   startArcPos = 0;
@@ -1264,10 +1265,26 @@ static SRes SzArEx_Open2(
 
   RINOK(LookInStream_SeekTo(inStream, startArcPos + k7zStartHeaderSize + nextHeaderOffset));
 
-  if (!Buf_Create(&buffer, nextHeaderSizeT, allocTemp))
-    return SZ_ERROR_MEM;
-
-  res = LookInStream_Read(inStream, buffer.data, nextHeaderSizeT);
+  {
+    /* Streams which can look at the whole header (like mapped files) are parsed in place.
+       The header is parsed before anything else is read from the stream. */
+    const void *lookBuf = NULL;
+    size_t lookSize = nextHeaderSizeT;
+    RINOK(inStream->Look(inStream, &lookBuf, &lookSize));
+    if (lookSize == nextHeaderSizeT)
+    {
+      buffer.data = (Byte *)lookBuf;
+      buffer.size = nextHeaderSizeT;
+      bufferBorrowed = True;
+      res = SZ_OK;
+    }
+    else
+    {
+      if (!Buf_Create(&buffer, nextHeaderSizeT, allocTemp))
+        return SZ_ERROR_MEM;
+      res = LookInStream_Read(inStream, buffer.data, nextHeaderSizeT);
+    }
+  }
   if (res == SZ_OK)
   {
     res = SZ_ERROR_ARCHIVE;
@@ -1289,7 +1306,9 @@ static SRes SzArEx_Open2(
             Buf_Free(&outBuffer, allocTemp);
           else
           {
-            Buf_Free(&buffer, allocTemp);
+            if (!bufferBorrowed)
+              Buf_Free(&buffer, allocTemp);
+            bufferBorrowed = False;
             buffer.data = outBuffer.data;
             buffer.size = outBuffer.size;
             sd.Data = buffer.data;
@@ -1307,7 +1326,8 @@ static SRes SzArEx_Open2(
       }
     }
   }
-  Buf_Free(&buffer, allocTemp);
+  if (!bufferBorrowed)
+    Buf_Free(&buffer, allocTemp);
   return res;
 }
 
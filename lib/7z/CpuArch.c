@@ -177,4 +177,14 @@ Bool CPU_Is_Aes_Supported()
   return (p.c >> 25) & 1;
 }
 
+Bool CPU_Is_Clmul_Supported()
+{
+  Cx86cpuid p;
+  CHECK_SYS_SSE_SUPPORT
+  if (!x86cpuid_CheckAndRead(&p))
+    return False;
+  /* PCLMULQDQ and SSE2 */
+  return ((p.c >> 1) & 1) && ((p.d >> 26) & 1);
+}
+
 #endif
@@ -147,6 +147,13 @@ int x86cpuid_GetFirm(const Cx86cpuid *p);
 
 Bool CPU_Is_InOrder();
 Bool CPU_Is_Aes_Supported();
+Bool CPU_Is_Clmul_Supported();
+
+/* Compilers which can generate PCLMULQDQ code for single functions */
+#if (defined(_MSC_VER) && _MSC_VER >= 1500) || defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define MY_CPU_CLMUL_COMPILER
+#endif
 
 #endif
 
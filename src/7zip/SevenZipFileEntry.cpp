@@ -7,7 +7,6 @@ extern "C"
 #include <7zCrc.h>
 }
 
-#include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
 
 #include <boost/iostreams/stream_buffer.hpp>
@@ -20,15 +19,16 @@ using namespace boost;
 
 namespace
 {
+	// The data may point into a decoded folder shared with the cache, so it can only be read
 	template<typename Ch>
-	class MemoryBuffer : public boost::iostreams::basic_array<Ch>
+	class MemoryBuffer : public boost::iostreams::basic_array_source<Ch>
 	{
 	private:
 		// We keep this here so the data is deallocated when this object is deleted
-		boost::shared_array<Ch> dataPtr;
+		boost::shared_array<const Ch> dataPtr;
 
 	public:
-		MemoryBuffer(shared_array<Ch> data, size_t n) : dataPtr(data), boost::iostreams::basic_array<Ch>(data.get(), n)
+		MemoryBuffer(shared_array<const Ch> data, size_t n) : boost::iostreams::basic_array_source<Ch>(data.get(), n), dataPtr(data)
 		{
 		}
 	};
@@ -41,23 +41,53 @@ SevenZipFileEntry::SevenZipFileEntry(SevenZipFileSystem* parentSystem, const str
 
 FileEntryPointer SevenZipFileEntry::getChild(const string_type& path)
 {
+	FileEntryPointer child;
+	util::throwStatus(tryGetChild(path, child));
+
+	return child;
+}
+
+Status SevenZipFileEntry::tryGetChild(const string_type& path, FileEntryPointer& outEntry)
+{
+	outEntry.reset();
+
 	if (getType() != DIRECTORY)
 	{
-		throw InvalidOperationException("Entry is no directory!");
+		return STATUS_NOT_DIRECTORY;
 	}
 
 	string_type childPath = (entryPath / path).generic_string();
 
-	EntryType type = getEntryType(childPath);
+	if (getEntryType(childPath) == UNKNOWN)
+	{
+		return STATUS_NOT_FOUND;
+	}
 
-	if (type == UNKNOWN)
+	outEntry.reset(new SevenZipFileEntry(parentSystem, childPath));
+
+	return STATUS_OK;
+}
+
+Status SevenZipFileEntry::tryGetChild(const NormalizedPath& path, FileEntryPointer& outEntry)
+{
+	if (!isRoot() || path.empty())
 	{
-		return FileEntryPointer();
+		// The archive is indexed by complete paths, those have to be built for other directories
+		return tryGetChild(path.toString(), outEntry);
 	}
-	else
+
+	outEntry.reset();
+
+	const SevenZipFileData* data = parentSystem->findFileData(path);
+
+	if (data == NULL || data->type == UNKNOWN)
 	{
-		return FileEntryPointer(new SevenZipFileEntry(parentSystem, childPath));
+		return STATUS_NOT_FOUND;
 	}
+
+	outEntry.reset(new SevenZipFileEntry(parentSystem, path.toString()));
+
+	return STATUS_OK;
 }
 
 size_t SevenZipFileEntry::numChildren()
@@ -67,33 +97,7 @@ size_t SevenZipFileEntry::numChildren()
 		throw InvalidOperationException("Entry is no directory!");
 	}
 
-	size_t num = 0;
-	BOOST_FOREACH(const SevenZipFileData& data, parentSystem->fileData)
-	{
-		if (algorithm::starts_with(data.name, path))
-		{
-			// This is a child of this directory, now we need to check if it's in a subdirectory
-			size_t pos = data.name.find_last_of('/');
-
-			if (pos == string_type::npos)
-			{
-				// Couldn't find separator, it's a child if we are the root
-				if (path.length() == 0)
-				{
-					++num;
-				}
-			}
-			else
-			{
-				if (pos == path.length())
-				{
-					++num;
-				}
-			}
-		}
-	}
-
-	return num;
+	return parentSystem->getChildIndexes(path).size();
 }
 
 void SevenZipFileEntry::listChildren(std::vector<FileEntryPointer>& outVector)
@@ -105,35 +109,18 @@ void SevenZipFileEntry::listChildren(std::vector<FileEntryPointer>& outVector)
 
 	outVector.clear();
 
-	BOOST_FOREACH(const SevenZipFileData& data, parentSystem->fileData)
-	{
-		if (algorithm::starts_with(data.name, path))
-		{
-			// This is a child of this directory, now we need to check if it's in a subdirectory
-			size_t pos = data.name.find_last_of('/');
+	boost::iterator_range<const boost::uint32_t*> children = parentSystem->getChildIndexes(path);
+	outVector.reserve(children.size());
 
-			if (pos == string_type::npos)
-			{
-				// Couldn't find separator, it's a child if we are the root
-				if (path.length() == 0)
-				{
-					outVector.push_back(FileEntryPointer(new SevenZipFileEntry(parentSystem, data.name)));
-				}
-			}
-			else
-			{
-				if (pos == path.length())
-				{
-					outVector.push_back(FileEntryPointer(new SevenZipFileEntry(parentSystem, data.name)));
-				}
-			}
-		}
+	BOOST_FOREACH(boost::uint32_t index, children)
+	{
+		outVector.push_back(FileEntryPointer(new SevenZipFileEntry(parentSystem, parentSystem->getEntryPath(index))));
 	}
 }
 
 EntryType SevenZipFileEntry::getType() const
 {
-	return getEntryType(entryPath.generic_string());
+	return getEntryType(path);
 }
 
 EntryType SevenZipFileEntry::getEntryType(const string_type& path) const
@@ -144,7 +131,9 @@ EntryType SevenZipFileEntry::getEntryType(const string_type& path) const
 		return DIRECTORY;
 	}
 
-	return parentSystem->getFileData(path).type;
+	const SevenZipFileData* data = parentSystem->findFileData(path);
+
+	return data ? data->type : UNKNOWN;
 }
 
 bool SevenZipFileEntry::deleteChild(const string_type& name)
@@ -159,25 +148,83 @@ FileEntryPointer SevenZipFileEntry::createEntry(EntryType type, const string_typ
 
 boost::shared_ptr<std::streambuf> SevenZipFileEntry::open(int mode)
 {
+	shared_ptr<std::streambuf> buffer;
+	util::throwStatus(tryOpen(mode, buffer));
+
+	return buffer;
+}
+
+Status SevenZipFileEntry::tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer)
+{
+	outBuffer.reset();
+
 	if (getType() != FILE)
 	{
-		throw InvalidOperationException("Entry is no file!");
+		return STATUS_NOT_FILE;
 	}
 
-	if (mode & MODE_WRITE)
+	// Archives are read only and their entries can't be memory mapped
+	if (mode & (MODE_WRITE | MODE_MEMORY_MAPPED))
 	{
-		throw InvalidOperationException("7-zip archives are read only!");
+		return STATUS_NOT_SUPPORTED;
 	}
 
-	if (mode & MODE_MEMORY_MAPPED)
+	try
 	{
-		throw FileSystemException("7-zip entries can't be memory mapped!");
+		if (mode & MODE_STREAMED)
+		{
+			outBuffer = parentSystem->openStreamed(path);
+
+			if (outBuffer)
+			{
+				return STATUS_OK;
+			}
+		}
+
+		size_t size;
+		shared_array<const char> data = parentSystem->extractEntry(path, size);
+
+		outBuffer.reset(new boost::iostreams::stream_buffer<MemoryBuffer<char>>(MemoryBuffer<char>(data, size)));
+	}
+	catch (const FileSystemException&)
+	{
+		// Damaged archive
+		return STATUS_IO_ERROR;
 	}
 
+	return STATUS_OK;
+}
+
+size_t SevenZipFileEntry::readAt(boost::uint64_t offset, void* buffer, size_t length)
+{
+	if (getType() != FILE)
+	{
+		throw InvalidOperationException("Entry is no file!");
+	}
+
+	// Reads from the cached folder, only the requested range is copied
+	return parentSystem->readEntry(path, offset, buffer, length);
+}
+
+bool SevenZipFileEntry::getView(FileView& outView)
+{
+	if (getType() != FILE)
+	{
+		throw InvalidOperationException("Entry is no file!");
+	}
+
+	// Stored entries are mapped directly from the archive, everything else comes from the decoded folder
 	size_t size;
-	shared_array<char> data = parentSystem->extractEntry(path, size);
+	shared_array<const char> data = parentSystem->mapStoredEntry(path, size);
+
+	if (!data)
+	{
+		data = parentSystem->extractEntry(path, size);
+	}
 
-	return shared_ptr<std::streambuf>(new boost::iostreams::stream_buffer<MemoryBuffer<char>>(MemoryBuffer<char>(data, size)));
+	outView = FileView(data, size);
+
+	return true;
 }
 
 void SevenZipFileEntry::rename(const string_type& newPath)
@@ -185,6 +232,11 @@ void SevenZipFileEntry::rename(const string_type& newPath)
 	throw InvalidOperationException("7-zip archives are read-only!");
 }
 
+EntryStat SevenZipFileEntry::stat()
+{
+	return parentSystem->statEntry(path);
+}
+
 time_t SevenZipFileEntry::lastWriteTime()
 {
 	return parentSystem->getFileData(path).write_time;
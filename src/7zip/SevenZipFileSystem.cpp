@@ -6,34 +6,197 @@ extern "C"
 #include <7zCrc.h>
 }
 
+#include <algorithm>
+#include <exception>
+#include <vector>
+
 #include <boost/system/error_code.hpp>
 #include <boost/format.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/lock_guard.hpp>
 
 #include <utf8.h>
 
 #include "VFSPP/7zip.hpp"
 #include "VFSPP/util.hpp"
 
+#include "SevenZipInStream.hpp"
+#include "SevenZipStreamBuffer.hpp"
+
 using namespace vfspp;
 using namespace vfspp::sevenzip;
 
 namespace
 {
-	bool inited = false;
+	boost::once_flag initFlag = BOOST_ONCE_INIT;
+
+	// Keeps the archive mapped as long as a view into it exists
+	struct MappingOwner
+	{
+		boost::shared_ptr<boost::iostreams::mapped_file_source> mapping;
+
+		explicit MappingOwner(const boost::shared_ptr<boost::iostreams::mapped_file_source>& mappingIn) : mapping(mappingIn) {}
+
+		void operator()(const char*) const {}
+	};
+
+	// Method ids of the coders which can be streamed, see 7zDec.c
+	const UInt64 k_Copy = 0;
+	const UInt64 k_LZMA2 = 0x21;
+	const UInt64 k_LZMA = 0x30101;
 
 	void sevenzip_init()
 	{
-		if (inited)
+		CrcGenerateTable();
+	}
+
+	// Checks the CRCs of a folder while it is decoded. If the folder has a CRC of its own it covers all files,
+	// otherwise the CRC of every file is updated with the part of the decoded data belonging to it.
+	class FolderVerifier : public IDecodeProgress
+	{
+	private:
+		const CSzArEx& db;
+		UInt32 folderIndex;
+
+		bool checkFolder;
+		UInt32 folderCrc;
+
+		// Next candidate in the file list and the file currently being decoded
+		UInt32 nextFile;
+		UInt32 currentFile;
+		UInt64 fileRemaining;
+		UInt32 fileCrc;
+
+		std::vector<UInt32>& corruptedFiles;
+		bool corrupted;
+
+		void finishFile()
 		{
-			return;
+			const CSzFileItem& file = db.db.Files[currentFile];
+
+			if (file.CrcDefined && CRC_GET_DIGEST(fileCrc) != file.Crc)
+			{
+				corruptedFiles.push_back(currentFile);
+				corrupted = true;
+			}
 		}
 
-		CrcGenerateTable();
+		// Skips empty files, returns false if there are no more files in this folder
+		bool startNextFile()
+		{
+			for (; nextFile < db.db.NumFiles; ++nextFile)
+			{
+				UInt32 fileFolder = db.FileIndexToFolderIndexMap[nextFile];
 
-		inited = true;
-	}
+				if (fileFolder == folderIndex)
+				{
+					currentFile = nextFile++;
+					fileRemaining = db.db.Files[currentFile].Size;
+					fileCrc = CRC_INIT_VAL;
+
+					if (fileRemaining > 0)
+					{
+						return true;
+					}
+
+					finishFile();
+				}
+				else if (fileFolder != ((UInt32)-1))
+				{
+					// The files of a folder are stored consecutively
+					break;
+				}
+			}
+
+			return false;
+		}
+
+		static SRes processData(IDecodeProgress* progress, const Byte* data, size_t size)
+		{
+			FolderVerifier* verifier = static_cast<FolderVerifier*>(progress);
+
+			if (verifier->checkFolder)
+			{
+				verifier->folderCrc = CrcUpdate(verifier->folderCrc, data, size);
+				return SZ_OK;
+			}
+
+			while (size > 0)
+			{
+				if (verifier->fileRemaining == 0 && !verifier->startNextFile())
+				{
+					// Data behind the last file isn't covered by any CRC
+					break;
+				}
+
+				size_t part = static_cast<size_t>(std::min<UInt64>(size, verifier->fileRemaining));
+
+				verifier->fileCrc = CrcUpdate(verifier->fileCrc, data, part);
+				verifier->fileRemaining -= part;
+
+				data += part;
+				size -= part;
+
+				if (verifier->fileRemaining == 0)
+				{
+					verifier->finishFile();
+				}
+			}
+
+			return SZ_OK;
+		}
+
+	public:
+		FolderVerifier(const CSzArEx& dbIn, UInt32 folderIndexIn, std::vector<UInt32>& corruptedFilesIn) :
+			db(dbIn), folderIndex(folderIndexIn), folderCrc(CRC_INIT_VAL), nextFile(dbIn.FolderStartFileIndex[folderIndexIn]),
+			currentFile(0), fileRemaining(0), fileCrc(CRC_INIT_VAL), corruptedFiles(corruptedFilesIn), corrupted(false)
+		{
+			Process = processData;
+
+			checkFolder = db.db.Folders[folderIndex].UnpackCRCDefined != 0;
+		}
+
+		// Checks the CRCs which haven't been checked yet after all data has been decoded
+		bool finish()
+		{
+			if (checkFolder)
+			{
+				if (CRC_GET_DIGEST(folderCrc) != db.db.Folders[folderIndex].UnpackCRC)
+				{
+					corrupted = true;
+
+					// Every file of the folder may be affected
+					for (UInt32 i = db.FolderStartFileIndex[folderIndex]; i < db.db.NumFiles; ++i)
+					{
+						UInt32 fileFolder = db.FileIndexToFolderIndexMap[i];
+						if (fileFolder == folderIndex)
+						{
+							corruptedFiles.push_back(i);
+						}
+						else if (fileFolder != ((UInt32)-1))
+						{
+							break;
+						}
+					}
+				}
+			}
+			else
+			{
+				// Trailing empty files
+				while (startNextFile())
+				{
+				}
+			}
+
+			return !corrupted;
+		}
+	};
 
 	const char* GetErrorStr(int err)
 	{
@@ -57,18 +220,16 @@ namespace
 	}
 }
 
-SevenZipFileSystem::SevenZipFileSystem(const boost::filesystem::path& path) :
+SevenZipFileSystem::SevenZipFileSystem(const boost::filesystem::path& path, bool mapArchive) :
 	ArchiveFileSystem(path),
+	cacheSize(DefaultCacheSize),
+	archiveMappingFailed(!mapArchive),
 	tempBuf(NULL),
-	tempBufSize(0),
-	blockIndex(0xFFFFFFFF),
-	outBuffer(NULL),
-	outBufferSize(0)
+	tempBufSize(0)
 {
-	if (!inited)
-	{
-		sevenzip_init();
-	}
+	memset(&cacheStatistics, 0, sizeof(cacheStatistics));
+
+	boost::call_once(initFlag, sevenzip_init);
 
 	allocImp.Alloc = SzAlloc;
 	allocImp.Free = SzFree;
@@ -77,44 +238,48 @@ SevenZipFileSystem::SevenZipFileSystem(const boost::filesystem::path& path) :
 
 	SzArEx_Init(&db);
 
-#ifdef WIN32
-	WRes wres = InFile_OpenW(&archiveStream.file, path.c_str());
-#else
-	WRes wres = InFile_Open(&archiveStream.file, path.c_str());
-#endif
+	// If the archive is mapped the header is parsed in place
+	SevenZipInStream* stream = acquireStream();
 
-	if (wres)
-	{
-		boost::system::error_code e(wres, boost::system::get_system_category());
-
-		throw FileSystemException((boost::format("Failed to open: %1% (%2%)") % e.message() % e.value()).str());
-	}
-
-	FileInStream_CreateVTable(&archiveStream);
-	LookToRead_CreateVTable(&lookStream, False);
+	SRes res = SzArEx_Open(&db, stream->get(), &allocImp, &allocTempImp);
 
-	lookStream.realStream = &archiveStream.s;
-	LookToRead_Init(&lookStream);
+	releaseStream(stream);
 
-	SRes res = SzArEx_Open(&db, &lookStream.s, &allocImp, &allocTempImp);
 	if (res != SZ_OK)
 	{
+		closeStreams();
+
 		throw FileSystemException((boost::format("Error opening: %1%") % GetErrorStr(res)).str());
 	}
 
+	verifiedFolders.resize(db.db.NumFolders, false);
+
 	// In 7zip talk, folders are pack-units (solid blocks),
 	// not related to file-system folders.
 	UInt64* folderUnpackSizes = new UInt64[db.db.NumFolders];
+	UInt64* folderOffsets = new UInt64[db.db.NumFolders];
 	for (unsigned int fi = 0; fi < db.db.NumFolders; fi++)
 	{
 		folderUnpackSizes[fi] = SzFolder_GetUnpackSize(db.db.Folders + fi);
+		folderOffsets[fi] = 0;
 	}
 
+	reserveFileData(db.db.NumFiles);
+
 	// Get contents of archive and store name->int mapping
 	for (unsigned int i = 0; i < db.db.NumFiles; ++i)
 	{
 		CSzFileItem* f = db.db.Files + i;
 
+		// Files of a folder are stored consecutively so the offset of a file is the sum of its predecessors
+		const UInt32 folderIndex = db.FileIndexToFolderIndexMap[i];
+		UInt64 folderOffset = 0;
+		if (folderIndex != ((UInt32)-1) && !f->IsDir)
+		{
+			folderOffset = folderOffsets[folderIndex];
+			folderOffsets[folderIndex] += f->Size;
+		}
+
 		int written = GetFileName(&db, i);
 		if (written <= 0) {
 			// TODO: Implement logging
@@ -135,8 +300,9 @@ SevenZipFileSystem::SevenZipFileSystem(const boost::filesystem::path& path) :
 		}
 
 		SevenZipFileData fd;
-		fd.name = utf8Name;
 		fd.index = i;
+		fd.folderIndex = folderIndex;
+		fd.folderOffset = folderOffset;
 
 		if (f->MTimeDefined)
 		{
@@ -158,9 +324,9 @@ SevenZipFileSystem::SevenZipFileSystem(const boost::filesystem::path& path) :
 		if (!f->IsDir)
 		{
 			fd.size = f->Size;
-			fd.crc = (f->Size > 0) ? f->Crc : 0;
+			fd.crcDefined = f->CrcDefined != 0;
+			fd.crc = fd.crcDefined ? f->Crc : 0;
 
-			const UInt32 folderIndex = db.FileIndexToFolderIndexMap[i];
 			if (folderIndex == ((UInt32)-1))
 			{
 				// file has no folder assigned
@@ -169,8 +335,15 @@ SevenZipFileSystem::SevenZipFileSystem(const boost::filesystem::path& path) :
 			}
 			else
 			{
+				const CSzFolder* folder = db.db.Folders + folderIndex;
+				const UInt64* packSizes = db.db.PackSizes + db.FolderStartPackStreamIndex[folderIndex];
+
 				fd.unpackedSize = folderUnpackSizes[folderIndex];
-				fd.packedSize = db.db.PackSizes[folderIndex];
+				fd.packedSize = 0;
+				for (UInt32 p = 0; p < folder->NumPackStreams; ++p)
+				{
+					fd.packedSize += packSizes[p];
+				}
 			}
 
 			fd.type = FILE;
@@ -179,27 +352,26 @@ SevenZipFileSystem::SevenZipFileSystem(const boost::filesystem::path& path) :
 		{
 			fd.size = 0;
 			fd.crc = 0;
+			fd.crcDefined = false;
 			fd.unpackedSize = 0;
 			fd.packedSize = 0;
 
 			fd.type = DIRECTORY;
 		}
 
-		addFileData(fd.name, fd);
+		addFileData(utf8Name, fd);
 	}
 
 	delete[] folderUnpackSizes;
+	delete[] folderOffsets;
+
+	buildChildIndex();
 
 	rootEntry.reset(new SevenZipFileEntry(this, ""));
 }
 
 SevenZipFileSystem::~SevenZipFileSystem()
 {
-	if (outBuffer != NULL)
-	{
-		IAlloc_Free(&allocImp, outBuffer);
-	}
-
 	if (tempBuf != NULL)
 	{
 		SzFree(NULL, tempBuf);
@@ -207,11 +379,73 @@ SevenZipFileSystem::~SevenZipFileSystem()
 		tempBufSize = 0;
 	}
 
-	File_Close(&archiveStream.file);
+	closeStreams();
 
 	SzArEx_Free(&db, &allocImp);
 }
 
+// Returns the stream to the pool when the lease goes out of scope
+class SevenZipFileSystem::StreamLease
+{
+private:
+	SevenZipFileSystem* fileSystem;
+	SevenZipInStream* stream;
+
+public:
+	StreamLease(SevenZipFileSystem* fileSystemIn) : fileSystem(fileSystemIn), stream(fileSystemIn->acquireStream()) {}
+
+	~StreamLease() { fileSystem->releaseStream(stream); }
+
+	ILookInStream* get() { return stream->get(); }
+};
+
+SevenZipInStream* SevenZipFileSystem::openStream()
+{
+	// Falls back to reading the file if the archive can't be mapped
+	return new SevenZipInStream(filePath, getArchiveMapping());
+}
+
+SevenZipInStream* SevenZipFileSystem::acquireStream()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(streamsLock);
+
+		if (!freeStreams.empty())
+		{
+			SevenZipInStream* stream = freeStreams.back();
+			freeStreams.pop_back();
+
+			return stream;
+		}
+	}
+
+	// Opening the file is done without holding the lock
+	SevenZipInStream* stream = openStream();
+
+	boost::lock_guard<boost::mutex> lock(streamsLock);
+	archiveStreams.push_back(stream);
+
+	return stream;
+}
+
+void SevenZipFileSystem::releaseStream(SevenZipInStream* stream)
+{
+	boost::lock_guard<boost::mutex> lock(streamsLock);
+
+	freeStreams.push_back(stream);
+}
+
+void SevenZipFileSystem::closeStreams()
+{
+	BOOST_FOREACH(SevenZipInStream* stream, archiveStreams)
+	{
+		delete stream;
+	}
+
+	archiveStreams.clear();
+	freeStreams.clear();
+}
+
 SevenZipFileEntry* SevenZipFileSystem::getRootEntry()
 {
 	return rootEntry.get();
@@ -238,12 +472,494 @@ int SevenZipFileSystem::GetFileName(const CSzArEx* db, int i)
 	return SzArEx_GetFileNameUtf16(db, i, tempBuf);
 }
 
-boost::shared_array<char> SevenZipFileSystem::extractEntry(const string_type& path, size_t& arraySize)
+void SevenZipFileSystem::setCacheSize(size_t bytes)
+{
+	boost::lock_guard<boost::mutex> lock(cacheLock);
+
+	cacheSize = bytes;
+
+	trimCache();
+}
+
+size_t SevenZipFileSystem::getCacheSize() const
+{
+	boost::lock_guard<boost::mutex> lock(cacheLock);
+
+	return cacheSize;
+}
+
+FolderCacheStatistics SevenZipFileSystem::getCacheStatistics() const
+{
+	boost::lock_guard<boost::mutex> lock(cacheLock);
+
+	return cacheStatistics;
+}
+
+void SevenZipFileSystem::clearCache()
+{
+	boost::lock_guard<boost::mutex> lock(cacheLock);
+
+	cachedFolders.clear();
+	cachedFolderIndexes.clear();
+
+	cacheStatistics.cachedFolders = 0;
+	cacheStatistics.cachedBytes = 0;
+}
+
+void SevenZipFileSystem::trimCache()
+{
+	// Never evict the most recently used folder
+	while (cacheStatistics.cachedBytes > cacheSize && cachedFolders.size() > 1)
+	{
+		const CachedFolder& folder = cachedFolders.back();
+
+		cacheStatistics.cachedBytes -= folder.size;
+		--cacheStatistics.cachedFolders;
+		++cacheStatistics.evictions;
+
+		cachedFolderIndexes.erase(folder.folderIndex);
+		cachedFolders.pop_back();
+	}
+}
+
+boost::shared_array<char> SevenZipFileSystem::getFolder(UInt32 folderIndex, size_t& folderSize)
+{
+	boost::unique_lock<boost::mutex> lock(cacheLock);
+
+	for (;;)
+	{
+		boost::unordered_map<UInt32, FolderList::iterator>::iterator found = cachedFolderIndexes.find(folderIndex);
+
+		if (found != cachedFolderIndexes.end())
+		{
+			++cacheStatistics.hits;
+
+			// Move the folder to the front of the LRU list
+			cachedFolders.splice(cachedFolders.begin(), cachedFolders, found->second);
+
+			folderSize = found->second->size;
+			return found->second->data;
+		}
+
+		if (decodingFolders.find(folderIndex) == decodingFolders.end())
+		{
+			break;
+		}
+
+		// Another thread is already decoding this folder, wait for it instead of decoding it twice
+		decodedCondition.wait(lock);
+	}
+
+	++cacheStatistics.misses;
+	decodingFolders.insert(folderIndex);
+
+	CachedFolder folder;
+	folder.folderIndex = folderIndex;
+
+	lock.unlock();
+
+	try
+	{
+		folder.data = decodeFolder(folderIndex, folder.size);
+	}
+	catch (...)
+	{
+		lock.lock();
+
+		decodingFolders.erase(folderIndex);
+		decodedCondition.notify_all();
+
+		throw;
+	}
+
+	lock.lock();
+
+	decodingFolders.erase(folderIndex);
+
+	cachedFolders.push_front(folder);
+	cachedFolderIndexes.insert(std::make_pair(folderIndex, cachedFolders.begin()));
+
+	++cacheStatistics.cachedFolders;
+	cacheStatistics.cachedBytes += folder.size;
+
+	trimCache();
+
+	decodedCondition.notify_all();
+
+	folderSize = folder.size;
+	return folder.data;
+}
+
+bool SevenZipFileSystem::isFolderVerified(UInt32 folderIndex) const
+{
+	boost::lock_guard<boost::mutex> lock(cacheLock);
+
+	return verifiedFolders[folderIndex];
+}
+
+void SevenZipFileSystem::setFolderVerified(UInt32 folderIndex)
+{
+	boost::lock_guard<boost::mutex> lock(cacheLock);
+
+	verifiedFolders[folderIndex] = true;
+}
+
+SRes SevenZipFileSystem::decodeFolder(UInt32 folderIndex, Byte* data, size_t size, std::vector<UInt32>& corruptedFiles)
+{
+	CSzFolder* folder = db.db.Folders + folderIndex;
+
+	UInt64 startOffset = SzArEx_GetFolderStreamPos(&db, folderIndex, 0);
+
+	StreamLease stream(this);
+
+	SRes res = LookInStream_SeekTo(stream.get(), startOffset);
+
+	if (res == SZ_OK)
+	{
+		FolderVerifier verifier(db, folderIndex, corruptedFiles);
+
+		res = SzFolder_DecodeWithProgress(folder, db.db.PackSizes + db.FolderStartPackStreamIndex[folderIndex],
+			stream.get(), startOffset, data, size, &allocTempImp, &verifier);
+
+		if (res == SZ_OK && !verifier.finish())
+		{
+			res = SZ_ERROR_CRC;
+		}
+	}
+
+	if (res == SZ_OK)
+	{
+		setFolderVerified(folderIndex);
+	}
+
+	return res;
+}
+
+boost::shared_array<char> SevenZipFileSystem::decodeFolder(UInt32 folderIndex, size_t& folderSize)
+{
+	UInt64 unpackSizeSpec = SzFolder_GetUnpackSize(db.db.Folders + folderIndex);
+	size_t unpackSize = (size_t)unpackSizeSpec;
+
+	if (unpackSize != unpackSizeSpec)
+	{
+		throw FileSystemException(GetErrorStr(SZ_ERROR_MEM));
+	}
+
+	boost::shared_array<char> data(new char[unpackSize]);
+
+	std::vector<UInt32> corruptedFiles;
+	SRes res = decodeFolder(folderIndex, reinterpret_cast<Byte*>(data.get()), unpackSize, corruptedFiles);
+
+	if (res != SZ_OK)
+	{
+		throw FileSystemException(GetErrorStr(res));
+	}
+
+	folderSize = unpackSize;
+	return data;
+}
+
+struct SevenZipFileSystem::VerifyState
+{
+	boost::atomic<UInt32> nextFolder;
+
+	boost::mutex resultLock;
+	std::vector<UInt32> corruptedFiles;
+	bool corrupted;
+
+	std::exception_ptr error;
+
+	VerifyState() : nextFolder(0), corrupted(false) {}
+};
+
+void SevenZipFileSystem::verifyFolders(VerifyState* state)
+{
+	try
+	{
+		// Reused for all folders this thread decodes
+		std::vector<Byte> buffer;
+		std::vector<UInt32> corruptedFiles;
+
+		for (;;)
+		{
+			UInt32 folderIndex = state->nextFolder.fetch_add(1, boost::memory_order_relaxed);
+
+			if (folderIndex >= db.db.NumFolders)
+			{
+				break;
+			}
+
+			UInt64 unpackSizeSpec = SzFolder_GetUnpackSize(db.db.Folders + folderIndex);
+			size_t unpackSize = (size_t)unpackSizeSpec;
+
+			if (unpackSize != unpackSizeSpec)
+			{
+				throw FileSystemException(GetErrorStr(SZ_ERROR_MEM));
+			}
+
+			buffer.resize(std::max<size_t>(unpackSize, 1));
+
+			corruptedFiles.clear();
+			SRes res = decodeFolder(folderIndex, &buffer[0], unpackSize, corruptedFiles);
+
+			if (res == SZ_ERROR_MEM)
+			{
+				throw FileSystemException(GetErrorStr(res));
+			}
+
+			if (res != SZ_OK)
+			{
+				boost::lock_guard<boost::mutex> lock(state->resultLock);
+
+				state->corrupted = true;
+
+				if (corruptedFiles.empty())
+				{
+					// Decoding failed, none of the files can be extracted
+					for (UInt32 i = db.FolderStartFileIndex[folderIndex]; i < db.db.NumFiles; ++i)
+					{
+						if (db.FileIndexToFolderIndexMap[i] == folderIndex)
+						{
+							state->corruptedFiles.push_back(i);
+						}
+						else if (db.FileIndexToFolderIndexMap[i] != ((UInt32)-1))
+						{
+							break;
+						}
+					}
+				}
+				else
+				{
+					state->corruptedFiles.insert(state->corruptedFiles.end(), corruptedFiles.begin(), corruptedFiles.end());
+				}
+			}
+		}
+	}
+	catch (...)
+	{
+		boost::lock_guard<boost::mutex> lock(state->resultLock);
+
+		if (!state->error)
+		{
+			state->error = std::current_exception();
+		}
+
+		// Let the other threads stop early
+		state->nextFolder.store(db.db.NumFolders, boost::memory_order_relaxed);
+	}
+}
+
+bool SevenZipFileSystem::verifyArchive(std::vector<string_type>* corruptedPaths, size_t numThreads)
+{
+	if (numThreads == 0)
+	{
+		numThreads = std::max(boost::thread::hardware_concurrency(), 1u);
+	}
+
+	numThreads = std::max<size_t>(std::min<size_t>(numThreads, db.db.NumFolders), 1);
+
+	VerifyState state;
+
+	// The calling thread verifies folders as well
+	boost::thread_group threads;
+	for (size_t i = 1; i < numThreads; ++i)
+	{
+		threads.create_thread(boost::bind(&SevenZipFileSystem::verifyFolders, this, &state));
+	}
+
+	verifyFolders(&state);
+
+	threads.join_all();
+
+	if (state.error)
+	{
+		std::rethrow_exception(state.error);
+	}
+
+	if (corruptedPaths != NULL && !state.corruptedFiles.empty())
+	{
+		boost::unordered_set<UInt32> corruptedFiles(state.corruptedFiles.begin(), state.corruptedFiles.end());
+
+		for (size_t i = 0; i < fileData.size(); ++i)
+		{
+			if (fileData[i].type == FILE && corruptedFiles.count(static_cast<UInt32>(fileData[i].index)) > 0)
+			{
+				corruptedPaths->push_back(getEntryPath(i));
+			}
+		}
+	}
+
+	return !state.corrupted;
+}
+
+struct SevenZipFileSystem::ExtractState
 {
-	size_t offset;
-	size_t outSizeProcessed;
-	SRes res;
+	struct Group
+	{
+		UInt32 folderIndex;
+		std::vector<std::pair<const string_type*, SevenZipFileData> > files;
+	};
+
+	static bool folderIndexLess(const Group& left, const Group& right)
+	{
+		return left.folderIndex < right.folderIndex;
+	}
+
+	std::vector<Group> groups;
+	const ExtractCallback* callback;
+
+	boost::atomic<size_t> nextGroup;
+
+	boost::mutex errorLock;
+	std::exception_ptr error;
+
+	ExtractState(const ExtractCallback* callbackIn) : callback(callbackIn), nextGroup(0) {}
+};
+
+void SevenZipFileSystem::extractFolders(ExtractState* state)
+{
+	try
+	{
+		for (;;)
+		{
+			size_t groupIndex = state->nextGroup.fetch_add(1, boost::memory_order_relaxed);
+
+			if (groupIndex >= state->groups.size())
+			{
+				break;
+			}
+
+			const ExtractState::Group& group = state->groups[groupIndex];
+
+			typedef std::pair<const string_type*, SevenZipFileData> FileInfo;
+
+			// Stored files can be viewed in the archive mapping without decoding the folder
+			size_t mappedFiles = 0;
+			BOOST_FOREACH(const FileInfo& file, group.files)
+			{
+				size_t size;
+				boost::shared_array<const char> data = mapStoredEntry(file.second, size);
+
+				if (!data)
+				{
+					break;
+				}
+
+				(*state->callback)(*file.first, FileView(data, size));
+				++mappedFiles;
+			}
+
+			if (mappedFiles == group.files.size())
+			{
+				continue;
+			}
+
+			size_t folderSize;
+			boost::shared_array<char> folder = getFolder(group.folderIndex, folderSize);
 
+			BOOST_FOREACH(const FileInfo& file, std::make_pair(group.files.begin() + mappedFiles, group.files.end()))
+			{
+				if (file.second.folderOffset + file.second.size > folderSize)
+				{
+					throw FileSystemException(GetErrorStr(SZ_ERROR_FAIL));
+				}
+
+				// The CRCs have been checked while decoding the folder
+				boost::shared_array<const char> data(folder, folder.get() + file.second.folderOffset);
+
+				(*state->callback)(*file.first, FileView(data, (size_t)file.second.size));
+			}
+		}
+	}
+	catch (...)
+	{
+		boost::lock_guard<boost::mutex> lock(state->errorLock);
+
+		if (!state->error)
+		{
+			state->error = std::current_exception();
+		}
+
+		// Let the other threads stop early
+		state->nextGroup.store(state->groups.size(), boost::memory_order_relaxed);
+	}
+}
+
+void SevenZipFileSystem::extractFiles(const std::vector<string_type>& paths, const ExtractCallback& callback, size_t numThreads)
+{
+	ExtractState state(&callback);
+
+	// Files which are not stored in any folder are empty
+	std::vector<const string_type*> emptyFiles;
+
+	boost::unordered_map<UInt32, size_t> groupIndexes;
+
+	BOOST_FOREACH(const string_type& path, paths)
+	{
+		SevenZipFileData fd = getFileData(path);
+
+		if (fd.type == UNKNOWN)
+		{
+			throw FileSystemException("Path is not known in this archive");
+		}
+
+		if (fd.type != FILE)
+		{
+			throw FileSystemException("Entry is no file!");
+		}
+
+		if (fd.folderIndex == ((UInt32)-1))
+		{
+			emptyFiles.push_back(&path);
+			continue;
+		}
+
+		std::pair<boost::unordered_map<UInt32, size_t>::iterator, bool> inserted =
+			groupIndexes.insert(std::make_pair(fd.folderIndex, state.groups.size()));
+
+		if (inserted.second)
+		{
+			state.groups.push_back(ExtractState::Group());
+			state.groups.back().folderIndex = fd.folderIndex;
+		}
+
+		state.groups[inserted.first->second].files.push_back(std::make_pair(&path, fd));
+	}
+
+	BOOST_FOREACH(const string_type* path, emptyFiles)
+	{
+		callback(*path, FileView(boost::shared_array<const char>(new char[0]), 0));
+	}
+
+	// Blocks are taken in the order they are stored in the archive
+	std::sort(state.groups.begin(), state.groups.end(), &ExtractState::folderIndexLess);
+
+	if (numThreads == 0)
+	{
+		numThreads = std::max(boost::thread::hardware_concurrency(), 1u);
+	}
+
+	numThreads = std::max<size_t>(std::min(numThreads, state.groups.size()), 1);
+
+	// The calling thread extracts files as well
+	boost::thread_group threads;
+	for (size_t i = 1; i < numThreads; ++i)
+	{
+		threads.create_thread(boost::bind(&SevenZipFileSystem::extractFolders, this, &state));
+	}
+
+	extractFolders(&state);
+
+	threads.join_all();
+
+	if (state.error)
+	{
+		std::rethrow_exception(state.error);
+	}
+}
+
+boost::shared_array<const char> SevenZipFileSystem::extractEntry(const string_type& path, size_t& arraySize)
+{
 	SevenZipFileData fd = getFileData(path);
 
 	if (fd.type == UNKNOWN)
@@ -256,18 +972,246 @@ boost::shared_array<char> SevenZipFileSystem::extractEntry(const string_type& pa
 		throw FileSystemException("Entry is no file!");
 	}
 
-	res = SzArEx_Extract(&db, &lookStream.s, fd.index, &blockIndex, &outBuffer, &outBufferSize, &offset, &outSizeProcessed, &allocImp, &allocTempImp);
-	if (res == SZ_OK)
+	if (fd.folderIndex == ((UInt32)-1))
 	{
-		boost::shared_array<char> dataPtr(new char[outSizeProcessed]);
-		arraySize = outSizeProcessed;
+		// Empty files are not stored in any folder
+		arraySize = 0;
+		return boost::shared_array<const char>(new char[0]);
+	}
 
-		memcpy(dataPtr.get(), (char*)outBuffer + offset, outSizeProcessed);
+	size_t folderSize;
+	boost::shared_array<char> folder = getFolder(fd.folderIndex, folderSize);
 
-		return dataPtr;
+	if (fd.folderOffset + fd.size > folderSize)
+	{
+		throw FileSystemException(GetErrorStr(SZ_ERROR_FAIL));
 	}
-	else
+
+	const char* fileStart = folder.get() + fd.folderOffset;
+	size_t fileSize = (size_t)fd.size;
+
+	// The CRCs have been checked while decoding the folder
+
+	arraySize = fileSize;
+
+	// Alias the folder buffer, it stays alive as long as any entry of it is open
+	return boost::shared_array<const char>(folder, fileStart);
+}
+
+bool SevenZipFileSystem::isFolderCached(UInt32 folderIndex) const
+{
+	boost::lock_guard<boost::mutex> guard(cacheLock);
+
+	return cachedFolderIndexes.find(folderIndex) != cachedFolderIndexes.end();
+}
+
+boost::shared_ptr<std::streambuf> SevenZipFileSystem::openStreamed(const string_type& path)
+{
+	SevenZipFileData fd = getFileData(path);
+
+	if (fd.type != FILE || fd.folderIndex == ((UInt32)-1) || isFolderCached(fd.folderIndex))
 	{
-		throw FileSystemException(GetErrorStr(res));
+		// Nothing to gain by streaming, the normal extraction handles these
+		return boost::shared_ptr<std::streambuf>();
+	}
+
+	CSzFolder* folder = db.db.Folders + fd.folderIndex;
+
+	if (folder->NumCoders != 1 || folder->NumPackStreams != 1)
+	{
+		// Filters like BCJ need multiple coders which can't be streamed
+		return boost::shared_ptr<std::streambuf>();
+	}
+
+	const CSzCoderInfo* coder = folder->Coders;
+
+	SevenZipStreamBuffer::Parameters params;
+
+	switch (coder->MethodID)
+	{
+	case k_Copy:
+		params.method = SevenZipStreamBuffer::METHOD_COPY;
+		break;
+	case k_LZMA:
+		params.method = SevenZipStreamBuffer::METHOD_LZMA;
+		break;
+	case k_LZMA2:
+		params.method = SevenZipStreamBuffer::METHOD_LZMA2;
+		break;
+	default:
+		return boost::shared_ptr<std::streambuf>();
+	}
+
+	if (params.method != SevenZipStreamBuffer::METHOD_COPY && coder->Props.size == 0)
+	{
+		return boost::shared_ptr<std::streambuf>();
+	}
+
+	params.properties.assign(coder->Props.data, coder->Props.data + coder->Props.size);
+
+	params.packPosition = SzArEx_GetFolderStreamPos(&db, fd.folderIndex, 0);
+	params.packSize = db.db.PackSizes[db.FolderStartPackStreamIndex[fd.folderIndex]];
+	params.unpackSize = SzFolder_GetUnpackSize(folder);
+
+	params.fileOffset = fd.folderOffset;
+	params.fileSize = fd.size;
+
+	if (params.fileOffset + params.fileSize > params.unpackSize)
+	{
+		throw FileSystemException(GetErrorStr(SZ_ERROR_FAIL));
+	}
+
+	const CSzFileItem* fileItem = db.db.Files + fd.index;
+	params.crcDefined = fileItem->CrcDefined != 0;
+	params.crc = fileItem->Crc;
+
+	return boost::shared_ptr<std::streambuf>(new SevenZipStreamBuffer(filePath, getArchiveMapping(), params));
+}
+
+size_t SevenZipFileSystem::readEntry(const string_type& path, UInt64 offset, void* buffer, size_t length)
+{
+	size_t size;
+	boost::shared_array<const char> data = extractEntry(path, size);
+
+	if (offset >= size)
+	{
+		return 0;
+	}
+
+	size_t available = std::min(length, size - static_cast<size_t>(offset));
+
+	memcpy(buffer, data.get() + offset, available);
+
+	return available;
+}
+
+boost::shared_ptr<boost::iostreams::mapped_file_source> SevenZipFileSystem::getArchiveMapping()
+{
+	using namespace boost::iostreams;
+
+	boost::lock_guard<boost::mutex> lock(mappingLock);
+
+	if (!archiveMapping && !archiveMappingFailed)
+	{
+		try
+		{
+			boost::shared_ptr<mapped_file_source> mapping(new mapped_file_source());
+			mapping->open(basic_mapped_file_params<boost::filesystem::path>(filePath));
+
+			if (mapping->is_open())
+			{
+				archiveMapping = mapping;
+			}
+		}
+		catch (const std::exception&)
+		{
+			// Mapping isn't possible for huge archives in 32-bit processes, don't try again
+		}
+
+		archiveMappingFailed = !archiveMapping;
 	}
+
+	return archiveMapping;
+}
+
+boost::shared_array<const char> SevenZipFileSystem::mapStoredEntry(const string_type& path, size_t& arraySize)
+{
+	return mapStoredEntry(getFileData(path), arraySize);
+}
+
+boost::shared_array<const char> SevenZipFileSystem::mapStoredEntry(const SevenZipFileData& fd, size_t& arraySize)
+{
+	if (fd.type != FILE || fd.folderIndex == ((UInt32)-1) || isFolderCached(fd.folderIndex))
+	{
+		return boost::shared_array<const char>();
+	}
+
+	const CSzFolder* folder = db.db.Folders + fd.folderIndex;
+
+	if (folder->NumCoders != 1 || folder->NumPackStreams != 1 || folder->Coders[0].MethodID != k_Copy)
+	{
+		// Only stored data is available in the archive as it is
+		return boost::shared_array<const char>();
+	}
+
+	boost::shared_ptr<boost::iostreams::mapped_file_source> mapping = getArchiveMapping();
+
+	if (!mapping)
+	{
+		return boost::shared_array<const char>();
+	}
+
+	UInt64 position = SzArEx_GetFolderStreamPos(&db, fd.folderIndex, 0) + fd.folderOffset;
+
+	if (position + fd.size > mapping->size())
+	{
+		throw FileSystemException(GetErrorStr(SZ_ERROR_INPUT_EOF));
+	}
+
+	const char* fileStart = mapping->data() + position;
+	size_t fileSize = (size_t)fd.size;
+
+	// Files of folders which have been decoded successfully don't have to be checked again
+	const CSzFileItem* fileItem = db.db.Files + fd.index;
+	if (fileItem->CrcDefined && !isFolderVerified(fd.folderIndex))
+	{
+		boost::unique_lock<boost::mutex> lock(mappingLock);
+
+		if (verifiedStoredFiles.count(fd.index) == 0)
+		{
+			lock.unlock();
+
+			if (CrcCalc(fileStart, fileSize) != fileItem->Crc)
+			{
+				throw FileSystemException(GetErrorStr(SZ_ERROR_CRC));
+			}
+
+			lock.lock();
+			verifiedStoredFiles.insert(fd.index);
+		}
+	}
+
+	arraySize = fileSize;
+
+	// The view shares ownership of the mapping so it stays valid after the filesystem is destroyed
+	return boost::shared_array<const char>(fileStart, MappingOwner(mapping));
+}
+
+EntryStat SevenZipFileSystem::statEntry(const string_type& path) const
+{
+	EntryStat result;
+
+	if (path.empty())
+	{
+		result.type = DIRECTORY;
+		return result;
+	}
+
+	SevenZipFileData fd = getFileData(path);
+
+	result.type = fd.type;
+
+	if (fd.type == UNKNOWN)
+	{
+		return result;
+	}
+
+	result.writeTime = fd.write_time;
+
+	if (fd.type == FILE)
+	{
+		result.size = fd.size;
+
+		// The packed size belongs to the whole folder, it only describes the file if it's alone in it
+		if (fd.folderIndex == ((UInt32)-1) || db.db.Folders[fd.folderIndex].NumUnpackStreams == 1)
+		{
+			result.hasPackedSize = true;
+			result.packedSize = fd.packedSize;
+		}
+
+		result.hasCrc = fd.crcDefined;
+		result.crc = fd.crc;
+	}
+
+	return result;
 }
@@ -0,0 +1,184 @@
+#include "SevenZipInStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/format.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "VFSPP/core.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+
+SevenZipInStream::SevenZipInStream(const boost::filesystem::path& archivePath,
+	const boost::shared_ptr<boost::iostreams::mapped_file_source>& mappingIn) :
+	mapping(mappingIn), data(NULL), totalSize(0), position(0), fileOpen(false), filePosition(0), bufferStart(0), bufferSize(0)
+{
+	vtable.s.Look = lookCallback;
+	vtable.s.Skip = skipCallback;
+	vtable.s.Read = readCallback;
+	vtable.s.Seek = seekCallback;
+	vtable.stream = this;
+
+	if (mapping)
+	{
+		data = reinterpret_cast<const Byte*>(mapping->data());
+		totalSize = mapping->size();
+
+		return;
+	}
+
+#ifdef WIN32
+	WRes wres = InFile_OpenW(&file, archivePath.c_str());
+#else
+	WRes wres = InFile_Open(&file, archivePath.c_str());
+#endif
+
+	if (wres == 0)
+	{
+		fileOpen = true;
+
+		wres = File_GetLength(&file, &totalSize);
+	}
+
+	if (wres)
+	{
+		if (fileOpen)
+		{
+			File_Close(&file);
+		}
+
+		boost::system::error_code e(wres, boost::system::system_category());
+
+		throw FileSystemException((boost::format("Failed to open: %1% (%2%)") % e.message() % e.value()).str());
+	}
+
+	buffer.reset(new Byte[BufferSize]);
+}
+
+SevenZipInStream::~SevenZipInStream()
+{
+	if (fileOpen)
+	{
+		File_Close(&file);
+	}
+}
+
+SRes SevenZipInStream::look(const void** buf, size_t* size)
+{
+	if (*size == 0)
+	{
+		return SZ_OK;
+	}
+
+	if (data != NULL)
+	{
+		*size = position < totalSize ? (size_t)std::min<UInt64>(*size, totalSize - position) : 0;
+		*buf = data + position;
+
+		return SZ_OK;
+	}
+
+	if (position < bufferStart || position >= bufferStart + bufferSize)
+	{
+		if (filePosition != position)
+		{
+			Int64 seekPosition = (Int64)position;
+			if (File_Seek(&file, &seekPosition, SZ_SEEK_SET) != 0)
+			{
+				return SZ_ERROR_READ;
+			}
+
+			filePosition = position;
+		}
+
+		size_t readSize = BufferSize;
+		if (File_Read(&file, buffer.get(), &readSize) != 0)
+		{
+			return SZ_ERROR_READ;
+		}
+
+		bufferStart = position;
+		bufferSize = readSize;
+		filePosition += readSize;
+	}
+
+	size_t offset = (size_t)(position - bufferStart);
+
+	*size = std::min(*size, bufferSize - offset);
+	*buf = buffer.get() + offset;
+
+	return SZ_OK;
+}
+
+SRes SevenZipInStream::skip(size_t offset)
+{
+	position += offset;
+
+	return SZ_OK;
+}
+
+SRes SevenZipInStream::read(void* buf, size_t* size)
+{
+	const void* source = NULL;
+
+	RINOK(look(&source, size));
+
+	memcpy(buf, source, *size);
+	position += *size;
+
+	return SZ_OK;
+}
+
+SRes SevenZipInStream::seek(Int64* pos, ESzSeek origin)
+{
+	Int64 newPosition;
+
+	switch (origin)
+	{
+	case SZ_SEEK_SET:
+		newPosition = *pos;
+		break;
+	case SZ_SEEK_CUR:
+		newPosition = (Int64)position + *pos;
+		break;
+	case SZ_SEEK_END:
+		newPosition = (Int64)totalSize + *pos;
+		break;
+	default:
+		return SZ_ERROR_PARAM;
+	}
+
+	if (newPosition < 0)
+	{
+		return SZ_ERROR_PARAM;
+	}
+
+	// Seeking inside the buffer keeps it, the file is only positioned again when the buffer is refilled
+	position = (UInt64)newPosition;
+	*pos = newPosition;
+
+	return SZ_OK;
+}
+
+SRes SevenZipInStream::lookCallback(void* p, const void** buf, size_t* size)
+{
+	return static_cast<VTable*>(p)->stream->look(buf, size);
+}
+
+SRes SevenZipInStream::skipCallback(void* p, size_t offset)
+{
+	return static_cast<VTable*>(p)->stream->skip(offset);
+}
+
+SRes SevenZipInStream::readCallback(void* p, void* buf, size_t* size)
+{
+	return static_cast<VTable*>(p)->stream->read(buf, size);
+}
+
+SRes SevenZipInStream::seekCallback(void* p, Int64* pos, ESzSeek origin)
+{
+	return static_cast<VTable*>(p)->stream->seek(pos, origin);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+
+extern "C"
+{
+#include <7zFile.h>
+}
+
+namespace boost {
+	namespace iostreams {
+		class mapped_file_source;
+	}
+}
+
+namespace vfspp
+{
+	namespace sevenzip
+	{
+		// Input stream of the 7-zip decoders. If the archive is mapped the decoders look directly into
+		// the mapped pages, otherwise the file is read through a buffer which is much larger than the
+		// one of CLookToRead so decoding needs fewer read calls.
+		class SevenZipInStream : private boost::noncopyable
+		{
+		public:
+			static const size_t BufferSize = 1 << 20;
+
+			// Reads from the file if mapping is null, the stream keeps the mapping alive otherwise
+			SevenZipInStream(const boost::filesystem::path& archivePath,
+				const boost::shared_ptr<boost::iostreams::mapped_file_source>& mapping);
+
+			~SevenZipInStream();
+
+			ILookInStream* get() { return &vtable.s; }
+
+			bool isMapped() const { return data != NULL; }
+
+		private:
+			// The callbacks get a pointer to the interface, this leads them back to the stream
+			struct VTable
+			{
+				ILookInStream s;
+				SevenZipInStream* stream;
+			};
+
+			VTable vtable;
+
+			boost::shared_ptr<boost::iostreams::mapped_file_source> mapping;
+			const Byte* data;
+
+			UInt64 totalSize;
+
+			// Position of the next byte returned by Look
+			UInt64 position;
+
+			// Only used without a mapping. The buffer holds the bytes of the file starting at bufferStart.
+			CSzFile file;
+			bool fileOpen;
+			UInt64 filePosition;
+
+			boost::scoped_array<Byte> buffer;
+			UInt64 bufferStart;
+			size_t bufferSize;
+
+			SRes look(const void** buf, size_t* size);
+
+			SRes skip(size_t offset);
+
+			SRes read(void* buf, size_t* size);
+
+			SRes seek(Int64* pos, ESzSeek origin);
+
+			static SRes lookCallback(void* p, const void** buf, size_t* size);
+
+			static SRes skipCallback(void* p, size_t offset);
+
+			static SRes readCallback(void* p, void* buf, size_t* size);
+
+			static SRes seekCallback(void* p, Int64* pos, ESzSeek origin);
+		};
+	}
+}
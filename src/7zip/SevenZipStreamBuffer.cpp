@@ -0,0 +1,286 @@
+#include "SevenZipStreamBuffer.hpp"
+
+extern "C"
+{
+#include <7zAlloc.h>
+#include <7zCrc.h>
+}
+
+#include <algorithm>
+
+#include <boost/system/error_code.hpp>
+#include <boost/format.hpp>
+
+#include "VFSPP/core.hpp"
+
+using namespace vfspp;
+using namespace vfspp::sevenzip;
+
+namespace
+{
+	// Maximum number of bytes decoded in one step, keeps the time to the first byte low
+	const size_t WindowSize = 1 << 16;
+
+	const size_t LookAheadSize = 1 << 18;
+
+	ISzAlloc allocImp = { SzAlloc, SzFree };
+
+	void checkResult(SRes res)
+	{
+		switch (res)
+		{
+		case SZ_OK:
+			return;
+		case SZ_ERROR_MEM:
+			throw FileSystemException("Out of memory");
+		case SZ_ERROR_UNSUPPORTED:
+			throw FileSystemException("Unsupported archive");
+		case SZ_ERROR_INPUT_EOF:
+			throw FileSystemException("Unexpected end of file (truncated?)");
+		default:
+			throw FileSystemException("Extracting failed");
+		}
+	}
+}
+
+SevenZipStreamBuffer::SevenZipStreamBuffer(const boost::filesystem::path& archivePath,
+	const boost::shared_ptr<boost::iostreams::mapped_file_source>& mapping, const Parameters& paramsIn) :
+	params(paramsIn), inStream(new SevenZipInStream(archivePath, mapping)), dictionary(NULL), dictionarySize(0), packRemaining(0), unpackRemaining(0),
+	skipRemaining(0), fileRemaining(paramsIn.fileSize), pendingSkip(0), crc(CRC_INIT_VAL), crcChecked(false)
+{
+	LzmaDec_Construct(&lzmaState);
+	Lzma2Dec_Construct(&lzma2State);
+
+	try
+	{
+		initDecoder();
+	}
+	catch (...)
+	{
+		cleanup();
+		throw;
+	}
+
+	setg(NULL, NULL, NULL);
+}
+
+SevenZipStreamBuffer::~SevenZipStreamBuffer()
+{
+	cleanup();
+}
+
+void SevenZipStreamBuffer::initDecoder()
+{
+	UInt32 dictionaryNeeded = 0;
+
+	switch (params.method)
+	{
+	case METHOD_COPY:
+		// Stored data can be read directly from the position of the file
+		checkResult(LookInStream_SeekTo(inStream->get(), params.packPosition + params.fileOffset));
+
+		packRemaining = params.fileSize;
+		return;
+	case METHOD_LZMA:
+	{
+		CLzmaProps props;
+		checkResult(LzmaProps_Decode(&props, &params.properties[0], (unsigned)params.properties.size()));
+		checkResult(LzmaDec_AllocateProbs(&lzmaState, &params.properties[0], (unsigned)params.properties.size(), &allocImp));
+
+		dictionaryNeeded = props.dicSize;
+		break;
+	}
+	case METHOD_LZMA2:
+	{
+		if (params.properties.size() != 1 || params.properties[0] > 40)
+		{
+			checkResult(SZ_ERROR_UNSUPPORTED);
+		}
+
+		Byte prop = params.properties[0];
+		checkResult(Lzma2Dec_AllocateProbs(&lzma2State, prop, &allocImp));
+
+		dictionaryNeeded = (prop == 40) ? 0xFFFFFFFF : (((UInt32)2 | (prop & 1)) << (prop / 2 + 11));
+		break;
+	}
+	}
+
+	// The dictionary never needs to be bigger than the whole block
+	dictionarySize = (size_t)std::min<UInt64>(dictionaryNeeded, std::max<UInt64>(params.unpackSize, 1));
+	dictionary = (Byte*)IAlloc_Alloc(&allocImp, dictionarySize);
+	if (dictionary == NULL)
+	{
+		checkResult(SZ_ERROR_MEM);
+	}
+
+	if (params.method == METHOD_LZMA)
+	{
+		lzmaState.dic = dictionary;
+		lzmaState.dicBufSize = dictionarySize;
+		LzmaDec_Init(&lzmaState);
+	}
+	else
+	{
+		lzma2State.decoder.dic = dictionary;
+		lzma2State.decoder.dicBufSize = dictionarySize;
+		Lzma2Dec_Init(&lzma2State);
+	}
+
+	checkResult(LookInStream_SeekTo(inStream->get(), params.packPosition));
+
+	packRemaining = params.packSize;
+	unpackRemaining = params.unpackSize;
+	skipRemaining = params.fileOffset;
+}
+
+void SevenZipStreamBuffer::cleanup()
+{
+	LzmaDec_FreeProbs(&lzmaState, &allocImp);
+	Lzma2Dec_FreeProbs(&lzma2State, &allocImp);
+
+	IAlloc_Free(&allocImp, dictionary);
+	dictionary = NULL;
+}
+
+SevenZipStreamBuffer::int_type SevenZipStreamBuffer::underflow()
+{
+	if (gptr() < egptr())
+	{
+		return traits_type::to_int_type(*gptr());
+	}
+
+	for (;;)
+	{
+		if (fileRemaining == 0)
+		{
+			verifyCrc();
+
+			return traits_type::eof();
+		}
+
+		const Byte* chunk;
+		size_t chunkSize;
+		nextChunk(chunk, chunkSize);
+
+		if (skipRemaining > 0)
+		{
+			// Data of the files in front of this one in the same block is discarded
+			size_t skip = (size_t)std::min<UInt64>(skipRemaining, chunkSize);
+
+			skipRemaining -= skip;
+			chunk += skip;
+			chunkSize -= skip;
+
+			if (chunkSize == 0)
+			{
+				continue;
+			}
+		}
+
+		size_t available = (size_t)std::min<UInt64>(chunkSize, fileRemaining);
+
+		crc = CrcUpdate(crc, chunk, available);
+		fileRemaining -= available;
+
+		char* start = const_cast<char*>(reinterpret_cast<const char*>(chunk));
+		setg(start, start, start + available);
+
+		return traits_type::to_int_type(*gptr());
+	}
+}
+
+void SevenZipStreamBuffer::nextChunk(const Byte*& chunk, size_t& chunkSize)
+{
+	if (params.method != METHOD_COPY)
+	{
+		decodeChunk(chunk, chunkSize);
+		return;
+	}
+
+	// The look-ahead buffer is handed out directly, it stays valid until the next call
+	checkResult(inStream->get()->Skip(inStream->get(), pendingSkip));
+	pendingSkip = 0;
+
+	size_t size = (size_t)std::min<UInt64>(LookAheadSize, packRemaining);
+	const void* buffer = NULL;
+	checkResult(inStream->get()->Look(inStream->get(), &buffer, &size));
+
+	if (size == 0)
+	{
+		checkResult(SZ_ERROR_INPUT_EOF);
+	}
+
+	pendingSkip = size;
+	packRemaining -= size;
+
+	chunk = static_cast<const Byte*>(buffer);
+	chunkSize = size;
+}
+
+void SevenZipStreamBuffer::decodeChunk(const Byte*& chunk, size_t& chunkSize)
+{
+	SizeT& dicPos = (params.method == METHOD_LZMA) ? lzmaState.dicPos : lzma2State.decoder.dicPos;
+
+	if (dicPos == dictionarySize)
+	{
+		// The dictionary is used as a ring buffer, the previous chunk has already been consumed
+		dicPos = 0;
+	}
+
+	SizeT dicLimit = dicPos + (size_t)std::min<UInt64>(std::min(WindowSize, dictionarySize - dicPos), unpackRemaining);
+
+	for (;;)
+	{
+		const void* inBuf = NULL;
+		size_t lookahead = (size_t)std::min<UInt64>(LookAheadSize, packRemaining);
+		checkResult(inStream->get()->Look(inStream->get(), &inBuf, &lookahead));
+
+		SizeT inProcessed = lookahead;
+		SizeT previousPos = dicPos;
+		ELzmaStatus status;
+
+		SRes res;
+		if (params.method == METHOD_LZMA)
+		{
+			res = LzmaDec_DecodeToDic(&lzmaState, dicLimit, static_cast<const Byte*>(inBuf), &inProcessed, LZMA_FINISH_ANY, &status);
+		}
+		else
+		{
+			res = Lzma2Dec_DecodeToDic(&lzma2State, dicLimit, static_cast<const Byte*>(inBuf), &inProcessed, LZMA_FINISH_ANY, &status);
+		}
+
+		checkResult(res);
+		checkResult(inStream->get()->Skip(inStream->get(), inProcessed));
+		packRemaining -= inProcessed;
+
+		if (dicPos > previousPos)
+		{
+			chunk = dictionary + previousPos;
+			chunkSize = dicPos - previousPos;
+
+			unpackRemaining -= chunkSize;
+			return;
+		}
+
+		if (inProcessed == 0)
+		{
+			// Neither input was consumed nor output produced
+			checkResult(SZ_ERROR_DATA);
+		}
+	}
+}
+
+void SevenZipStreamBuffer::verifyCrc()
+{
+	if (crcChecked)
+	{
+		return;
+	}
+
+	crcChecked = true;
+
+	if (params.crcDefined && CRC_GET_DIGEST(crc) != params.crc)
+	{
+		throw FileSystemException("CRC error (archive corrupted?)");
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <streambuf>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "vfspp_compiler_detection.h"
+
+#include "SevenZipInStream.hpp"
+
+extern "C"
+{
+#include <7zFile.h>
+#include "LzmaDec.h"
+#include "Lzma2Dec.h"
+}
+
+namespace vfspp
+{
+	namespace sevenzip
+	{
+		// Decodes a single file of a solid block while it is being read. Only the dictionary of the
+		// decoder is allocated instead of the whole block. The buffer is forward only and can't seek.
+		class SevenZipStreamBuffer : public std::streambuf, private boost::noncopyable
+		{
+		public:
+			enum Method
+			{
+				METHOD_COPY,
+				METHOD_LZMA,
+				METHOD_LZMA2
+			};
+
+			struct Parameters
+			{
+				Method method;
+				std::vector<Byte> properties;
+
+				// Position and size of the packed stream in the archive file
+				UInt64 packPosition;
+				UInt64 packSize;
+
+				UInt64 unpackSize;
+
+				UInt64 fileOffset;
+				UInt64 fileSize;
+
+				bool crcDefined;
+				UInt32 crc;
+			};
+
+		private:
+			Parameters params;
+
+			boost::scoped_ptr<SevenZipInStream> inStream;
+
+			CLzmaDec lzmaState;
+			CLzma2Dec lzma2State;
+
+			Byte* dictionary;
+			size_t dictionarySize;
+
+			UInt64 packRemaining;
+			UInt64 unpackRemaining;
+			UInt64 skipRemaining;
+			UInt64 fileRemaining;
+
+			// Number of bytes returned by the last Look of the copy method which still need to be skipped
+			size_t pendingSkip;
+
+			UInt32 crc;
+			bool crcChecked;
+
+			void initDecoder();
+
+			void cleanup();
+
+			void nextChunk(const Byte*& chunk, size_t& chunkSize);
+
+			void decodeChunk(const Byte*& chunk, size_t& chunkSize);
+
+			void verifyCrc();
+
+		public:
+			// The archive is read from the mapping if it isn't null
+			SevenZipStreamBuffer(const boost::filesystem::path& archivePath,
+				const boost::shared_ptr<boost::iostreams::mapped_file_source>& mapping, const Parameters& params);
+
+			virtual ~SevenZipStreamBuffer();
+
+		protected:
+			virtual int_type underflow() VFSPP_OVERRIDE;
+		};
+	}
+}
@@ -0,0 +1,323 @@
+
+#include <algorithm>
+
+#include <boost/functional/hash.hpp>
+
+#include "VFSPP/path.hpp"
+
+namespace vfspp
+{
+	const PathTable::PathId PathTable::RootPath;
+	const PathTable::PathId PathTable::InvalidPath;
+
+	namespace
+	{
+		const boost::uint32_t EmptySlot = PathTable::InvalidPath;
+
+		// Spreads the bits of a hash so the lower bits can be used as slot index
+		size_t mixHash(boost::uint64_t hash)
+		{
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdULL;
+			hash ^= hash >> 33;
+			hash *= 0xc4ceb9fe1a85ec53ULL;
+			hash ^= hash >> 33;
+
+			return static_cast<size_t>(hash);
+		}
+
+		size_t nameHash(boost::string_ref name)
+		{
+			// Same as boost::hash of the equivalent string, which is what NormalizedPath provides
+			return boost::hash_range(name.begin(), name.end());
+		}
+
+		size_t childHash(PathTable::PathId parent, boost::uint32_t name)
+		{
+			return mixHash((static_cast<boost::uint64_t>(parent) << 32) | name);
+		}
+
+		size_t tableSizeFor(size_t numValues)
+		{
+			// Power of two and at most half full
+			size_t size = 16;
+			while (size < numValues * 2)
+			{
+				size *= 2;
+			}
+
+			return size;
+		}
+	}
+
+	PathTable::PathTable() : nameSlots(16, EmptySlot), childSlots(16, EmptySlot)
+	{
+		// The root has the empty name which is name 0
+		nameOffsets.push_back(0);
+		nameOffsets.push_back(0);
+		insertSlot(nameSlots, 0, mixHash(nameHash(boost::string_ref())));
+
+		Node root;
+		root.parent = InvalidPath;
+		root.name = 0;
+		nodes.push_back(root);
+	}
+
+	void PathTable::insertSlot(std::vector<boost::uint32_t>& slots, boost::uint32_t value, size_t hash)
+	{
+		size_t mask = slots.size() - 1;
+
+		size_t slot = hash & mask;
+		while (slots[slot] != EmptySlot)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		slots[slot] = value;
+	}
+
+	void PathTable::growNameSlots()
+	{
+		std::vector<boost::uint32_t> slots(tableSizeFor(numNames() + 1), EmptySlot);
+
+		for (boost::uint32_t name = 0; name < numNames(); ++name)
+		{
+			boost::string_ref nameStr(nameChars.data() + nameOffsets[name], nameOffsets[name + 1] - nameOffsets[name]);
+
+			insertSlot(slots, name, mixHash(nameHash(nameStr)));
+		}
+
+		nameSlots.swap(slots);
+	}
+
+	void PathTable::growChildSlots()
+	{
+		std::vector<PathId> slots(tableSizeFor(nodes.size()), EmptySlot);
+
+		for (PathId id = 1; id < nodes.size(); ++id)
+		{
+			insertSlot(slots, id, childHash(nodes[id].parent, nodes[id].name));
+		}
+
+		childSlots.swap(slots);
+	}
+
+	boost::uint32_t PathTable::findName(boost::string_ref name, size_t hash) const
+	{
+		size_t mask = nameSlots.size() - 1;
+
+		for (size_t slot = mixHash(hash) & mask; nameSlots[slot] != EmptySlot; slot = (slot + 1) & mask)
+		{
+			boost::uint32_t candidate = nameSlots[slot];
+			boost::uint32_t length = nameOffsets[candidate + 1] - nameOffsets[candidate];
+
+			if (length == name.size() && std::equal(name.begin(), name.end(), nameChars.begin() + nameOffsets[candidate]))
+			{
+				return candidate;
+			}
+		}
+
+		return EmptySlot;
+	}
+
+	boost::uint32_t PathTable::internName(boost::string_ref name)
+	{
+		size_t hash = nameHash(name);
+
+		boost::uint32_t found = findName(name, hash);
+		if (found != EmptySlot)
+		{
+			return found;
+		}
+
+		if ((numNames() + 1) * 2 > nameSlots.size())
+		{
+			growNameSlots();
+		}
+
+		boost::uint32_t id = static_cast<boost::uint32_t>(numNames());
+
+		nameChars.insert(nameChars.end(), name.begin(), name.end());
+		nameOffsets.push_back(static_cast<boost::uint32_t>(nameChars.size()));
+
+		insertSlot(nameSlots, id, mixHash(hash));
+
+		return id;
+	}
+
+	PathTable::PathId PathTable::lookupChild(PathId parent, boost::uint32_t name) const
+	{
+		size_t mask = childSlots.size() - 1;
+
+		for (size_t slot = childHash(parent, name) & mask; childSlots[slot] != EmptySlot; slot = (slot + 1) & mask)
+		{
+			const Node& node = nodes[childSlots[slot]];
+
+			if (node.parent == parent && node.name == name)
+			{
+				return childSlots[slot];
+			}
+		}
+
+		return InvalidPath;
+	}
+
+	PathTable::PathId PathTable::intern(boost::string_ref path)
+	{
+		PathId current = RootPath;
+
+		while (!path.empty())
+		{
+			size_t separator = path.find(DirectorySeparatorChar);
+			boost::string_ref component = path.substr(0, separator);
+
+			boost::uint32_t name = internName(component);
+			PathId child = lookupChild(current, name);
+
+			if (child == InvalidPath)
+			{
+				if (nodes.size() * 2 > childSlots.size())
+				{
+					growChildSlots();
+				}
+
+				Node node;
+				node.parent = current;
+				node.name = name;
+				nodes.push_back(node);
+
+				child = static_cast<PathId>(nodes.size() - 1);
+				insertSlot(childSlots, child, childHash(current, name));
+			}
+
+			current = child;
+
+			if (separator == boost::string_ref::npos)
+			{
+				break;
+			}
+
+			path.remove_prefix(separator + 1);
+		}
+
+		return current;
+	}
+
+	PathTable::PathId PathTable::find(boost::string_ref path) const
+	{
+		PathId current = RootPath;
+
+		while (!path.empty() && current != InvalidPath)
+		{
+			size_t separator = path.find(DirectorySeparatorChar);
+
+			current = findChild(current, path.substr(0, separator));
+
+			if (separator == boost::string_ref::npos)
+			{
+				break;
+			}
+
+			path.remove_prefix(separator + 1);
+		}
+
+		return current;
+	}
+
+	PathTable::PathId PathTable::find(const NormalizedPath& path) const
+	{
+		PathId current = RootPath;
+
+		for (size_t i = 0; i < path.numComponents() && current != InvalidPath; ++i)
+		{
+			PathKey key = path.componentKey(i);
+
+			boost::uint32_t name = findName(key.str, key.hash);
+			if (name == EmptySlot)
+			{
+				return InvalidPath;
+			}
+
+			current = lookupChild(current, name);
+		}
+
+		return current;
+	}
+
+	PathTable::PathId PathTable::findChild(PathId parent, boost::string_ref name) const
+	{
+		boost::uint32_t nameId = findName(name, nameHash(name));
+
+		if (nameId == EmptySlot)
+		{
+			return InvalidPath;
+		}
+
+		return lookupChild(parent, nameId);
+	}
+
+	boost::string_ref PathTable::getName(PathId id) const
+	{
+		boost::uint32_t name = nodes[id].name;
+		boost::uint32_t length = nameOffsets[name + 1] - nameOffsets[name];
+
+		return length == 0 ? boost::string_ref() : boost::string_ref(nameChars.data() + nameOffsets[name], length);
+	}
+
+	string_type PathTable::getPath(PathId id) const
+	{
+		size_t length = 0;
+		for (PathId current = id; current != RootPath; current = nodes[current].parent)
+		{
+			length += getName(current).size() + 1;
+		}
+
+		if (length == 0)
+		{
+			return string_type();
+		}
+
+		// Filled from the back as the components are found from the last to the first
+		string_type path(length - 1, DirectorySeparatorChar);
+		size_t end = path.size();
+
+		for (PathId current = id; current != RootPath; current = nodes[current].parent)
+		{
+			boost::string_ref name = getName(current);
+
+			end -= name.size();
+			std::copy(name.begin(), name.end(), path.begin() + end);
+
+			if (end > 0)
+			{
+				--end;
+			}
+		}
+
+		return path;
+	}
+
+	void PathTable::reserve(size_t numPaths)
+	{
+		nodes.reserve(numPaths);
+
+		if (numPaths * 2 > childSlots.size())
+		{
+			std::vector<PathId> slots(tableSizeFor(numPaths), EmptySlot);
+
+			for (PathId id = 1; id < nodes.size(); ++id)
+			{
+				insertSlot(slots, id, childHash(nodes[id].parent, nodes[id].name));
+			}
+
+			childSlots.swap(slots);
+		}
+	}
+
+	void PathTable::shrinkToFit()
+	{
+		nodes.shrink_to_fit();
+		nameChars.shrink_to_fit();
+		nameOffsets.shrink_to_fit();
+	}
+}
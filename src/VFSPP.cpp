@@ -1,12 +1,170 @@
 
+#include <algorithm>
+#include <cstring>
+
+#include <boost/functional/hash.hpp>
+
 #include "VFSPP/core.hpp"
+#include "VFSPP/path.hpp"
 #include "VFSPP/util.hpp"
 
 namespace vfspp
 {
-	IFileSystemEntry::IFileSystemEntry(const string_type& pathIn) : path(pathIn)
+	IFileSystemEntry::IFileSystemEntry(const string_type& pathIn) : path(util::normalizePath(pathIn))
+	{
+	}
+
+	size_t IFileSystemEntry::readAt(boost::uint64_t offset, void* buffer, size_t length)
+	{
+		boost::shared_ptr<std::streambuf> stream = open(MODE_READ);
+
+		std::streampos position = stream->pubseekpos(static_cast<std::streamoff>(offset), std::ios::in);
+		if (position == std::streampos(std::streamoff(-1)))
+		{
+			// Positions past the end can't be reached by every stream
+			return 0;
+		}
+
+		std::streamsize read = stream->sgetn(static_cast<char*>(buffer), static_cast<std::streamsize>(length));
+
+		return read > 0 ? static_cast<size_t>(read) : 0;
+	}
+
+	Status IFileSystemEntry::tryGetChild(const string_type& path, FileEntryPointer& outEntry)
+	{
+		outEntry.reset();
+
+		try
+		{
+			outEntry = getChild(path);
+		}
+		catch (const InvalidOperationException&)
+		{
+			return getType() == DIRECTORY ? STATUS_NOT_SUPPORTED : STATUS_NOT_DIRECTORY;
+		}
+		catch (const FileSystemException&)
+		{
+			return STATUS_IO_ERROR;
+		}
+
+		return outEntry ? STATUS_OK : STATUS_NOT_FOUND;
+	}
+
+	Status IFileSystemEntry::tryGetChild(const NormalizedPath& path, FileEntryPointer& outEntry)
 	{
-		this->path = util::normalizePath(this->path);
+		return tryGetChild(path.toString(), outEntry);
+	}
+
+	Status IFileSystemEntry::tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer)
+	{
+		outBuffer.reset();
+
+		try
+		{
+			outBuffer = open(mode);
+		}
+		catch (const InvalidOperationException&)
+		{
+			return getType() == FILE ? STATUS_NOT_SUPPORTED : STATUS_NOT_FILE;
+		}
+		catch (const FileSystemException&)
+		{
+			return STATUS_IO_ERROR;
+		}
+
+		return outBuffer ? STATUS_OK : STATUS_IO_ERROR;
+	}
+
+	bool IFileSystemEntry::getView(FileView&)
+	{
+		return false;
+	}
+
+	EntryStat IFileSystemEntry::stat()
+	{
+		EntryStat result;
+		result.type = getType();
+
+		if (result.type == UNKNOWN)
+		{
+			return result;
+		}
+
+		result.writeTime = lastWriteTime();
+
+		if (result.type == FILE)
+		{
+			boost::shared_ptr<std::streambuf> stream = open(MODE_READ);
+
+			std::streampos end = stream->pubseekoff(0, std::ios::end, std::ios::in);
+			if (end != std::streampos(std::streamoff(-1)))
+			{
+				result.size = static_cast<boost::uint64_t>(std::streamoff(end));
+			}
+		}
+
+		return result;
+	}
+
+	namespace
+	{
+		bool isUpper(char c)
+		{
+			return std::isupper(static_cast<unsigned char>(c)) != 0;
+		}
+	}
+
+	NormalizedPath::NormalizedPath(const string_type& path, bool lowerCaseIn) : lowerCase(lowerCaseIn)
+	{
+		init(path.data(), path.data() + path.size());
+	}
+
+	NormalizedPath::NormalizedPath(const char* path, bool lowerCaseIn) : lowerCase(lowerCaseIn)
+	{
+		init(path, path + std::strlen(path));
+	}
+
+	void NormalizedPath::init(const char* begin, const char* end)
+	{
+		util::trimPath(begin, end);
+
+		if (lowerCase && std::find_if(begin, end, isUpper) != end)
+		{
+			lowerCaseStorage.assign(begin, end);
+			boost::to_lower(lowerCaseStorage);
+
+			begin = lowerCaseStorage.data();
+			end = begin + lowerCaseStorage.size();
+		}
+
+		pathData = begin;
+		pathSize = end - begin;
+		pathHash = boost::hash_range(begin, end);
+
+		if (pathSize == 0)
+		{
+			return;
+		}
+
+		const char* componentBegin = begin;
+		while (true)
+		{
+			const char* componentEnd = std::find(componentBegin, end, DirectorySeparatorChar);
+
+			Component component;
+			component.offset = componentBegin - begin;
+			component.length = componentEnd - componentBegin;
+			component.hash = boost::hash_range(componentBegin, componentEnd);
+
+			components.push_back(component);
+
+			if (componentEnd == end)
+			{
+				break;
+			}
+
+			componentBegin = componentEnd + 1;
+		}
 	}
 
 	namespace util
@@ -27,5 +185,146 @@ namespace vfspp
 
 			return out;
 		}
+
+		void throwStatus(Status status)
+		{
+			switch (status)
+			{
+			case STATUS_NOT_DIRECTORY:
+				throw InvalidOperationException("Entry is no directory!");
+			case STATUS_NOT_FILE:
+				throw InvalidOperationException("Entry is no file!");
+			case STATUS_NOT_SUPPORTED:
+				throw InvalidOperationException("Operation is not supported!");
+			case STATUS_IO_ERROR:
+				throw FileSystemException("Filesystem operation failed!");
+			default:
+				break;
+			}
+		}
+
+		namespace
+		{
+			bool matchPattern(const char* pattern, const char* patternEnd, const char* path, const char* pathEnd)
+			{
+				while (pattern != patternEnd)
+				{
+					if (*pattern == '*')
+					{
+						bool crossSeparators = patternEnd - pattern > 1 && pattern[1] == '*';
+						pattern += crossSeparators ? 2 : 1;
+
+						if (crossSeparators && pattern != patternEnd && *pattern == DirectorySeparatorChar
+							&& matchPattern(pattern + 1, patternEnd, path, pathEnd))
+						{
+							return true;
+						}
+
+						// The star takes as few characters as possible, more are tried if the rest doesn't match
+						for (;; ++path)
+						{
+							if (matchPattern(pattern, patternEnd, path, pathEnd))
+							{
+								return true;
+							}
+
+							if (path == pathEnd || (!crossSeparators && *path == DirectorySeparatorChar))
+							{
+								return false;
+							}
+						}
+					}
+
+					if (path == pathEnd)
+					{
+						return false;
+					}
+
+					if (*pattern == '?' ? *path == DirectorySeparatorChar : *pattern != *path)
+					{
+						return false;
+					}
+
+					++pattern;
+					++path;
+				}
+
+				return path == pathEnd;
+			}
+		}
+
+		bool matchPattern(const string_type& pattern, const string_type& path)
+		{
+			return matchPattern(pattern.data(), pattern.data() + pattern.size(), path.data(), path.data() + path.size());
+		}
+
+		namespace
+		{
+			boost::uint64_t hashString(const string_type& str)
+			{
+				// FNV-1a followed by the MurmurHash3 finalizer so both halves of the hash are usable
+				boost::uint64_t hash = 14695981039346656037ULL;
+
+				for (string_type::const_iterator iter = str.begin(); iter != str.end(); ++iter)
+				{
+					hash ^= static_cast<unsigned char>(*iter);
+					hash *= 1099511628211ULL;
+				}
+
+				hash ^= hash >> 33;
+				hash *= 0xff51afd7ed558ccdULL;
+				hash ^= hash >> 33;
+				hash *= 0xc4ceb9fe1a85ec53ULL;
+				hash ^= hash >> 33;
+
+				return hash;
+			}
+		}
+
+		BloomFilter::BloomFilter(size_t expectedStrings, size_t bitsPerString)
+		{
+			size_t totalBits = std::max<size_t>(expectedStrings * std::max<size_t>(bitsPerString, 1), 64);
+
+			bits.resize((totalBits + 63) / 64);
+
+			// ln(2) * bits per string minimizes the false positive rate
+			numHashes = std::max<size_t>((bitsPerString * 69 + 50) / 100, 1);
+		}
+
+		void BloomFilter::insert(const string_type& str)
+		{
+			boost::uint64_t hash = hashString(str);
+
+			// The probe positions are derived from two halves of one hash (Kirsch-Mitzenmacher)
+			boost::uint64_t first = hash & 0xFFFFFFFF;
+			boost::uint64_t second = (hash >> 32) | 1;
+
+			for (size_t i = 0; i < numHashes; ++i)
+			{
+				boost::uint64_t bit = (first + i * second) % numBits();
+
+				bits[bit / 64] |= boost::uint64_t(1) << (bit % 64);
+			}
+		}
+
+		bool BloomFilter::mayContain(const string_type& str) const
+		{
+			boost::uint64_t hash = hashString(str);
+
+			boost::uint64_t first = hash & 0xFFFFFFFF;
+			boost::uint64_t second = (hash >> 32) | 1;
+
+			for (size_t i = 0; i < numHashes; ++i)
+			{
+				boost::uint64_t bit = (first + i * second) % numBits();
+
+				if (!(bits[bit / 64] & (boost::uint64_t(1) << (bit % 64))))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
 	}
 }
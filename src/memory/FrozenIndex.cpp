@@ -0,0 +1,317 @@
+#include "FrozenIndex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include <boost/core/null_deleter.hpp>
+
+namespace vfspp
+{
+	namespace memory
+	{
+		namespace
+		{
+			// Average number of keys per bucket of the perfect hash
+			const size_t KeysPerBucket = 2;
+
+			// Displacements with this bit set are the slot of a bucket with a single key
+			const boost::uint32_t DirectSlot = 0x80000000;
+
+			// A bucket which doesn't fit after this many displacements contains keys with equal hashes
+			const boost::uint32_t MaxDisplacement = 1 << 20;
+
+			// Seeds which are tried before freezing fails
+			const boost::uint64_t MaxSeeds = 16;
+
+			const boost::uint32_t UnusedSlot = 0xFFFFFFFF;
+
+			boost::uint64_t mixHash(boost::uint64_t hash)
+			{
+				hash ^= hash >> 33;
+				hash *= 0xff51afd7ed558ccdULL;
+				hash ^= hash >> 33;
+				hash *= 0xc4ceb9fe1a85ec53ULL;
+				hash ^= hash >> 33;
+
+				return hash;
+			}
+
+			// Hashes eight bytes at a time, the seed is changed if the hashes of two paths collide
+			boost::uint64_t hashPath(const char* data, size_t size, boost::uint64_t seed)
+			{
+				const boost::uint64_t multiplier = 0xc6a4a7935bd1e995ULL;
+
+				boost::uint64_t hash = seed ^ (size * multiplier);
+
+				for (; size >= sizeof(boost::uint64_t); size -= sizeof(boost::uint64_t), data += sizeof(boost::uint64_t))
+				{
+					boost::uint64_t block;
+					memcpy(&block, data, sizeof(block));
+
+					block *= multiplier;
+					block ^= block >> 47;
+					block *= multiplier;
+
+					hash ^= block;
+					hash *= multiplier;
+				}
+
+				if (size > 0)
+				{
+					boost::uint64_t block = 0;
+					memcpy(&block, data, size);
+
+					hash ^= block;
+					hash *= multiplier;
+				}
+
+				return mixHash(hash);
+			}
+
+			struct BiggerBucket
+			{
+				const std::vector<boost::uint32_t>& offsets;
+
+				explicit BiggerBucket(const std::vector<boost::uint32_t>& offsetsIn) : offsets(offsetsIn) {}
+
+				bool operator()(boost::uint32_t left, boost::uint32_t right) const
+				{
+					return offsets[left + 1] - offsets[left] > offsets[right + 1] - offsets[right];
+				}
+			};
+		}
+
+		FrozenIndex::FrozenIndex(MemoryFileEntry* root) : seed(0)
+		{
+			nodes.push_back(boost::shared_ptr<MemoryFileEntry>(root, boost::null_deleter()));
+
+			// Breadth first, the children of a directory are appended together
+			for (size_t i = 0; i < nodes.size(); ++i)
+			{
+				if (nodes.size() >= DirectSlot)
+				{
+					throw FileSystemException("Too many entries to freeze the filesystem!");
+				}
+
+				childOffsets.push_back(static_cast<boost::uint32_t>(nodes.size()));
+
+				const MemoryFileEntry::ChildVector& children = nodes[i]->fileEntries;
+				std::copy(children.begin(), children.end(), std::back_inserter(nodes));
+			}
+			childOffsets.push_back(static_cast<boost::uint32_t>(nodes.size()));
+
+			std::vector<boost::uint64_t> hashes(nodes.size() - 1);
+			for (;; ++seed)
+			{
+				if (seed == MaxSeeds)
+				{
+					throw FileSystemException("Failed to build the index of the frozen filesystem!");
+				}
+
+				for (size_t i = 1; i < nodes.size(); ++i)
+				{
+					const string_type& path = nodes[i]->getPath();
+					hashes[i - 1] = hashPath(path.data(), path.size(), seed);
+				}
+
+				// Equal paths have equal hashes with every seed, the search would only fail after trying all
+				if (seed == 0)
+				{
+					checkUniquePaths(hashes);
+				}
+
+				if (buildHash(hashes))
+				{
+					break;
+				}
+			}
+
+			// The index owns the entries now, the child tables aren't needed anymore
+			for (size_t i = 0; i < nodes.size(); ++i)
+			{
+				MemoryFileEntry* entry = nodes[i].get();
+				MemoryFileEntry::ChildVector(entry->fileEntries.get_allocator()).swap(entry->fileEntries);
+				MemoryFileEntry::ChildMap(entry->indexMapping.get_allocator()).swap(entry->indexMapping);
+
+				entry->frozen = this;
+				entry->frozenId = static_cast<boost::uint32_t>(i);
+			}
+		}
+
+		void FrozenIndex::checkUniquePaths(const std::vector<boost::uint64_t>& hashes) const
+		{
+			std::vector<std::pair<boost::uint64_t, boost::uint32_t> > sorted(hashes.size());
+			for (size_t i = 0; i < hashes.size(); ++i)
+			{
+				sorted[i] = std::make_pair(hashes[i], static_cast<boost::uint32_t>(i + 1));
+			}
+
+			std::sort(sorted.begin(), sorted.end());
+
+			// Only the paths of colliding hashes are compared
+			for (size_t i = 1; i < sorted.size(); ++i)
+			{
+				if (sorted[i].first != sorted[i - 1].first)
+				{
+					continue;
+				}
+
+				for (size_t j = i; j > 0 && sorted[j - 1].first == sorted[i].first; --j)
+				{
+					const string_type& path = nodes[sorted[i].second]->getPath();
+
+					if (path == nodes[sorted[j - 1].second]->getPath())
+					{
+						throw FileSystemException("Can't freeze a filesystem containing the path '" + path + "' twice!");
+					}
+				}
+			}
+		}
+
+		size_t FrozenIndex::bucketOf(boost::uint64_t hash) const
+		{
+			return static_cast<size_t>(hash % displacements.size());
+		}
+
+		size_t FrozenIndex::slotOf(boost::uint64_t hash, boost::uint32_t displacement) const
+		{
+			if (displacement & DirectSlot)
+			{
+				return displacement & ~DirectSlot;
+			}
+
+			return static_cast<size_t>(mixHash(hash + displacement * 0x9e3779b97f4a7c15ULL) % slots.size());
+		}
+
+		bool FrozenIndex::buildHash(const std::vector<boost::uint64_t>& hashes)
+		{
+			size_t numKeys = hashes.size();
+			size_t numBuckets = numKeys / KeysPerBucket + 1;
+
+			displacements.assign(numBuckets, 0);
+			slots.assign(numKeys, UnusedSlot);
+
+			// Counting sort of the keys by their bucket
+			std::vector<boost::uint32_t> bucketOffsets(numBuckets + 1, 0);
+			for (size_t i = 0; i < numKeys; ++i)
+			{
+				++bucketOffsets[bucketOf(hashes[i]) + 1];
+			}
+
+			for (size_t i = 1; i < bucketOffsets.size(); ++i)
+			{
+				bucketOffsets[i] += bucketOffsets[i - 1];
+			}
+
+			std::vector<boost::uint32_t> insertPositions(bucketOffsets.begin(), bucketOffsets.end() - 1);
+			std::vector<boost::uint32_t> bucketKeys(numKeys);
+			for (size_t i = 0; i < numKeys; ++i)
+			{
+				bucketKeys[insertPositions[bucketOf(hashes[i])]++] = static_cast<boost::uint32_t>(i);
+			}
+
+			// Big buckets are placed first while most slots are still free
+			std::vector<boost::uint32_t> order(numBuckets);
+			for (size_t i = 0; i < numBuckets; ++i)
+			{
+				order[i] = static_cast<boost::uint32_t>(i);
+			}
+			std::stable_sort(order.begin(), order.end(), BiggerBucket(bucketOffsets));
+
+			std::vector<size_t> placed;
+			size_t nextFree = 0;
+
+			for (size_t i = 0; i < numBuckets; ++i)
+			{
+				boost::uint32_t bucket = order[i];
+				boost::uint32_t begin = bucketOffsets[bucket];
+				boost::uint32_t end = bucketOffsets[bucket + 1];
+
+				if (begin == end)
+				{
+					break;
+				}
+
+				// Single keys take the next free slot, searching a displacement for them would take long
+				// once the table is nearly full
+				if (end - begin == 1)
+				{
+					while (slots[nextFree] != UnusedSlot)
+					{
+						++nextFree;
+					}
+
+					displacements[bucket] = DirectSlot | static_cast<boost::uint32_t>(nextFree);
+					slots[nextFree] = bucketKeys[begin] + 1;
+
+					continue;
+				}
+
+				boost::uint32_t displacement = 0;
+				for (;; ++displacement)
+				{
+					if (displacement == MaxDisplacement)
+					{
+						return false;
+					}
+
+					placed.clear();
+					for (boost::uint32_t key = begin; key < end; ++key)
+					{
+						size_t slot = slotOf(hashes[bucketKeys[key]], displacement);
+
+						if (slots[slot] != UnusedSlot)
+						{
+							break;
+						}
+
+						slots[slot] = bucketKeys[key] + 1;
+						placed.push_back(slot);
+					}
+
+					if (placed.size() == end - begin)
+					{
+						break;
+					}
+
+					for (size_t j = 0; j < placed.size(); ++j)
+					{
+						slots[placed[j]] = UnusedSlot;
+					}
+				}
+
+				displacements[bucket] = displacement;
+			}
+
+			return true;
+		}
+
+		FileEntryPointer FrozenIndex::find(const char* path, size_t size) const
+		{
+			if (slots.empty())
+			{
+				return FileEntryPointer();
+			}
+
+			boost::uint64_t hash = hashPath(path, size, seed);
+
+			const boost::shared_ptr<MemoryFileEntry>& node = nodes[slots[slotOf(hash, displacements[bucketOf(hash)])]];
+
+			// Paths which aren't in the index hash to the slot of some other entry
+			const string_type& nodePath = node->getPath();
+			if (nodePath.size() != size || memcmp(nodePath.data(), path, size) != 0)
+			{
+				return FileEntryPointer();
+			}
+
+			return node;
+		}
+
+		void FrozenIndex::listChildren(boost::uint32_t node, std::vector<FileEntryPointer>& outVector) const
+		{
+			outVector.assign(nodes.begin() + childOffsets[node], nodes.begin() + childOffsets[node + 1]);
+		}
+	}
+}
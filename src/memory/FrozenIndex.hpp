@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "VFSPP/memory.hpp"
+
+namespace vfspp
+{
+	namespace memory
+	{
+		// Flat layout of a frozen memory filesystem. The entries are stored breadth first, so the children
+		// of every directory form a contiguous range, and a minimal perfect hash maps the full path of
+		// every entry to its position. A lookup hashes the path once and compares it with a single entry.
+		class FrozenIndex : private boost::noncopyable
+		{
+		public:
+			// Takes over the entries below the root, their child tables are released. The tree is left
+			// untouched if the index can't be built.
+			explicit FrozenIndex(MemoryFileEntry* root);
+
+			// Returns null if there is no entry with the normalized path
+			FileEntryPointer find(const char* path, size_t size) const;
+
+			size_t numChildren(boost::uint32_t node) const { return childOffsets[node + 1] - childOffsets[node]; }
+
+			void listChildren(boost::uint32_t node, std::vector<FileEntryPointer>& outVector) const;
+
+		private:
+			// Node 0 is the root which isn't owned by the index
+			std::vector<boost::shared_ptr<MemoryFileEntry> > nodes;
+
+			// The children of node i are nodes[childOffsets[i], childOffsets[i + 1])
+			std::vector<boost::uint32_t> childOffsets;
+
+			// Perfect hash, every bucket of keys has a displacement which moves its keys to free slots.
+			// Buckets with a single key store the slot directly.
+			std::vector<boost::uint32_t> displacements;
+
+			// Node of every slot
+			std::vector<boost::uint32_t> slots;
+
+			boost::uint64_t seed;
+
+			size_t bucketOf(boost::uint64_t hash) const;
+
+			size_t slotOf(boost::uint64_t hash, boost::uint32_t displacement) const;
+
+			// Throws if two entries have the same path
+			void checkUniquePaths(const std::vector<boost::uint64_t>& hashes) const;
+
+			bool buildHash(const std::vector<boost::uint64_t>& hashes);
+		};
+	}
+}
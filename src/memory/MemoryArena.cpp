@@ -0,0 +1,110 @@
+#include <VFSPP/memory.hpp>
+
+#include <boost/thread/lock_guard.hpp>
+
+namespace vfspp
+{
+	namespace memory
+	{
+		const size_t MemoryArena::SlabSize;
+		const size_t MemoryArena::MaxReusedSize;
+
+		namespace
+		{
+			// Reused blocks are aligned like every allocation of operator new
+			const size_t BlockAlignment = 16;
+
+			size_t sizeClass(size_t size)
+			{
+				return (size + BlockAlignment - 1) / BlockAlignment;
+			}
+		}
+
+		MemoryArena::MemoryArena() : current(NULL), remaining(0), totalSize(0), freeBlocks(sizeClass(MaxReusedSize) + 1, NULL)
+		{
+		}
+
+		void* MemoryArena::allocate(size_t size, size_t alignment)
+		{
+			boost::lock_guard<boost::mutex> guard(lock);
+
+			if (size <= MaxReusedSize && alignment <= BlockAlignment)
+			{
+				size_t index = sizeClass(size);
+
+				void* block = freeBlocks[index];
+				if (block != NULL)
+				{
+					freeBlocks[index] = *static_cast<void**>(block);
+					return block;
+				}
+
+				// Blocks have the full size of their class so they can be reused for any size of it
+				return allocateFromSlab(index * BlockAlignment, BlockAlignment);
+			}
+
+			return allocateFromSlab(size, alignment);
+		}
+
+		void MemoryArena::deallocate(void* block, size_t size)
+		{
+			if (block == NULL || size == 0 || size > MaxReusedSize)
+			{
+				return;
+			}
+
+			boost::lock_guard<boost::mutex> guard(lock);
+
+			size_t index = sizeClass(size);
+
+			*static_cast<void**>(block) = freeBlocks[index];
+			freeBlocks[index] = block;
+		}
+
+		void* MemoryArena::allocateFromSlab(size_t size, size_t alignment)
+		{
+			if (size > SlabSize / 4)
+			{
+				// Big allocations get a slab of their own, the rest of the current slab stays usable
+				boost::shared_array<char> slab(new char[size]);
+
+				slabs.push_back(slab);
+				totalSize += size;
+
+				return slab.get();
+			}
+
+			size_t padding = (alignment - reinterpret_cast<size_t>(current) % alignment) % alignment;
+
+			if (current == NULL || padding + size > remaining)
+			{
+				currentSlab.reset(new char[SlabSize]);
+				slabs.push_back(currentSlab);
+				totalSize += SlabSize;
+
+				current = currentSlab.get();
+				remaining = SlabSize;
+				padding = 0;
+			}
+
+			void* result = current + padding;
+
+			current += padding + size;
+			remaining -= padding + size;
+
+			return result;
+		}
+
+		boost::shared_array<char> MemoryArena::allocateShared(size_t size)
+		{
+			boost::lock_guard<boost::mutex> guard(lock);
+
+			// Shared blocks are never deallocated, they are taken from the slab directly
+			char* data = static_cast<char*>(allocateFromSlab(size, 1));
+
+			const boost::shared_array<char>& slab = size > SlabSize / 4 ? slabs.back() : currentSlab;
+
+			return boost::shared_array<char>(slab, data);
+		}
+	}
+}
@@ -0,0 +1,201 @@
+#include "MemoryFileContents.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vfspp
+{
+	namespace memory
+	{
+		const size_t MemoryFileContents::ChunkSize;
+		const size_t MemoryFileContents::MinChunkSize;
+
+		size_t MemoryFileContents::read(boost::uint64_t offset, void* buffer, size_t length) const
+		{
+			if (offset >= dataSize)
+			{
+				return 0;
+			}
+
+			size_t position = static_cast<size_t>(offset);
+			size_t end = position + std::min(length, dataSize - position);
+
+			char* out = static_cast<char*>(buffer);
+			while (position < end)
+			{
+				size_t available;
+				boost::shared_array<const char> block;
+				const char* data = readable(position, available, block);
+
+				available = std::min(available, end - position);
+				memcpy(out, data, available);
+
+				out += available;
+				position += available;
+			}
+
+			return end - static_cast<size_t>(offset);
+		}
+
+		const char* MemoryFileContents::readable(size_t offset, size_t& available,
+			boost::shared_array<const char>& outBuffer) const
+		{
+			if (offset >= dataSize)
+			{
+				available = 0;
+				outBuffer.reset();
+				return NULL;
+			}
+
+			if (chunks.empty())
+			{
+				available = dataSize - offset;
+				outBuffer = contiguous;
+				return contiguous.get() + offset;
+			}
+
+			size_t chunkOffset = offset % ChunkSize;
+
+			available = std::min(ChunkSize - chunkOffset, dataSize - offset);
+			outBuffer = chunks[offset / ChunkSize];
+			return outBuffer.get() + chunkOffset;
+		}
+
+		FileView MemoryFileContents::view() const
+		{
+			if (chunks.empty())
+			{
+				return FileView(contiguous, dataSize);
+			}
+
+			boost::shared_array<char> copy(new char[dataSize]);
+			read(0, copy.get(), dataSize);
+
+			return FileView(copy, dataSize);
+		}
+
+		char* MemoryFileContents::writable(size_t offset, size_t& available, boost::shared_array<const char>& outBuffer)
+		{
+			makeChunked();
+
+			reserve(offset + 1);
+
+			// Bytes skipped by seeking past the end read as zeros
+			size_t position = dataSize;
+			while (position < offset)
+			{
+				size_t chunkOffset = position % ChunkSize;
+				size_t length = std::min(ChunkSize - chunkOffset, offset - position);
+
+				memset(chunks[position / ChunkSize].get() + chunkOffset, 0, length);
+				position += length;
+			}
+
+			if (offset > dataSize)
+			{
+				dataSize = offset;
+			}
+
+			size_t index = offset / ChunkSize;
+			size_t chunkOffset = offset % ChunkSize;
+
+			available = (index + 1 == chunks.size() ? lastCapacity : ChunkSize) - chunkOffset;
+			outBuffer = chunks[index];
+			return chunks[index].get() + chunkOffset;
+		}
+
+		void MemoryFileContents::write(size_t offset, const char* data, size_t length)
+		{
+			size_t position = offset;
+			size_t end = offset + length;
+
+			boost::shared_array<const char> block;
+			while (position < end)
+			{
+				size_t available;
+				char* out = writable(position, available, block);
+
+				available = std::min(available, end - position);
+				memcpy(out, data + (position - offset), available);
+
+				position += available;
+			}
+
+			commit(end);
+		}
+
+		void MemoryFileContents::commit(size_t end)
+		{
+			dataSize = std::max(dataSize, end);
+			writeTime = time(NULL);
+		}
+
+		void MemoryFileContents::truncate()
+		{
+			chunks.clear();
+			contiguous.reset();
+
+			lastCapacity = 0;
+			dataSize = 0;
+			writeTime = time(NULL);
+
+			++layoutVersion;
+		}
+
+		void MemoryFileContents::makeChunked()
+		{
+			if (!chunks.empty() || dataSize == 0)
+			{
+				return;
+			}
+
+			// Added buffers may be read only, the data is copied once before it is written
+			reserve(dataSize);
+
+			for (size_t i = 0; i < chunks.size(); ++i)
+			{
+				size_t offset = i * ChunkSize;
+				memcpy(chunks[i].get(), contiguous.get() + offset, std::min(ChunkSize, dataSize - offset));
+			}
+
+			contiguous.reset();
+			++layoutVersion;
+		}
+
+		void MemoryFileContents::reserve(size_t end)
+		{
+			size_t numChunks = (end + ChunkSize - 1) / ChunkSize;
+
+			if (numChunks == 0 || (numChunks <= chunks.size()
+				&& (numChunks < chunks.size() || end - (numChunks - 1) * ChunkSize <= lastCapacity)))
+			{
+				return;
+			}
+
+			chunks.reserve(numChunks);
+
+			// The last chunk is filled up first, later chunks are only added once it is full
+			if (!chunks.empty() && lastCapacity < ChunkSize)
+			{
+				size_t lastEnd = numChunks > chunks.size() ? ChunkSize : end - (chunks.size() - 1) * ChunkSize;
+				size_t capacity = lastEnd == ChunkSize ? ChunkSize : std::min(ChunkSize, std::max(lastEnd, lastCapacity * 2));
+
+				boost::shared_array<char> grown(new char[capacity]);
+				memcpy(grown.get(), chunks.back().get(), lastCapacity);
+
+				chunks.back() = grown;
+				lastCapacity = capacity;
+				++layoutVersion;
+			}
+
+			while (chunks.size() < numChunks)
+			{
+				size_t lastEnd = chunks.size() + 1 == numChunks ? end - (numChunks - 1) * ChunkSize : ChunkSize;
+				size_t capacity = chunks.size() + 1 == numChunks ? std::max(lastEnd, MinChunkSize) : ChunkSize;
+
+				chunks.push_back(boost::shared_array<char>(new char[capacity]));
+				lastCapacity = capacity;
+			}
+		}
+	}
+}
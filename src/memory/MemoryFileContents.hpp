@@ -0,0 +1,84 @@
+#pragma once
+
+#include <ctime>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_array.hpp>
+
+#include "VFSPP/core.hpp"
+
+namespace vfspp
+{
+	namespace memory
+	{
+		// Contents of a memory file, shared by the entry and the streams opened on it.
+		// Added files keep the buffer they were created with. Written files are stored in chunks of
+		// ChunkSize bytes, so appending never moves more than the last chunk. The last chunk starts small
+		// and doubles until it is full, small files don't take a whole chunk.
+		// Reading is safe from several threads as long as nobody writes.
+		// The buffers are shared with the streams which expose them, so a stream can keep reading from a
+		// buffer which has been replaced, e.g. when the file was truncated or a chunk grew. Every such
+		// change increases the layout version, streams use it to notice that their put area is detached.
+		class MemoryFileContents : private boost::noncopyable
+		{
+		public:
+			static const size_t ChunkSize = 64 * 1024;
+
+			static const size_t MinChunkSize = 1024;
+
+			explicit MemoryFileContents(time_t writeTimeIn) :
+				lastCapacity(0), dataSize(0), writeTime(writeTimeIn), layoutVersion(0) {}
+
+			MemoryFileContents(const boost::shared_array<const char>& data, size_t size, time_t writeTimeIn) :
+				contiguous(data), lastCapacity(0), dataSize(size), writeTime(writeTimeIn), layoutVersion(0) {}
+
+			size_t size() const { return dataSize; }
+
+			size_t version() const { return layoutVersion; }
+
+			time_t lastWriteTime() const { return writeTime; }
+
+			size_t read(boost::uint64_t offset, void* buffer, size_t length) const;
+
+			// Returns the readable bytes starting at offset up to the end of the chunk or file, outBuffer
+			// keeps them alive
+			const char* readable(size_t offset, size_t& available, boost::shared_array<const char>& outBuffer) const;
+
+			// Views of written files are copies, they don't change when the file is written again
+			FileView view() const;
+
+			// Returns the memory for writing at offset up to the end of its chunk. A file smaller than
+			// offset is extended with zeros, the bytes written into the chunk count once commit() is called.
+			char* writable(size_t offset, size_t& available, boost::shared_array<const char>& outBuffer);
+
+			// Copies the data to offset and commits it
+			void write(size_t offset, const char* data, size_t length);
+
+			// Extends the file to end if it is smaller and updates the write time
+			void commit(size_t end);
+
+			void truncate();
+
+		private:
+			// Either contiguous holds the data or the chunks do
+			boost::shared_array<const char> contiguous;
+			std::vector<boost::shared_array<char> > chunks;
+
+			// All chunks except the last one have ChunkSize bytes
+			size_t lastCapacity;
+
+			size_t dataSize;
+
+			time_t writeTime;
+
+			size_t layoutVersion;
+
+			void makeChunked();
+
+			// Makes sure the chunks can hold end bytes
+			void reserve(size_t end);
+		};
+	}
+}
@@ -1,8 +1,16 @@
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <utility>
 
 #include <VFSPP/util.hpp>
 #include <VFSPP/memory.hpp>
 
-#include <boost/iostreams/stream_buffer.hpp>
+#include "FrozenIndex.hpp"
+#include "MemoryFileContents.hpp"
+#include "MemoryStreamBuffer.hpp"
+
+#include <boost/foreach.hpp>
 
 namespace vfspp
 {
@@ -12,21 +20,38 @@ namespace vfspp
 
 		namespace
 		{
-			template<typename Ch>
-			class MemoryBuffer : public boost::iostreams::basic_array<Ch>
+			// Lets a shared_array refer to memory which is owned by another object
+			struct OwnerDeleter
 			{
-			private:
-				// We keep this here so the data is deallocated when this object is deleted
-				boost::shared_array<Ch> dataPtr;
+				shared_ptr<const void> owner;
 
-			public:
-				MemoryBuffer(shared_array<Ch> data, size_t n) : dataPtr(data), boost::iostreams::basic_array<Ch>(data.get(), n)
-				{
-				}
+				OwnerDeleter(const shared_ptr<const void>& ownerIn) : owner(ownerIn) {}
+
+				void operator()(const char*) { owner.reset(); }
 			};
+
+			// Objects placed in an arena are only destroyed, their memory is released with the arena
+			struct ArenaDestroyer
+			{
+				template<typename T>
+				void operator()(T* object) const { object->~T(); }
+			};
+
+			// The last component of the path of an entry is the key of the entry in its parent
+			string_type entryName(const string_type& path)
+			{
+				return path.substr(path.find_last_of(DirectorySeparatorChar) + 1);
+			}
 		}
 
-		typedef unordered_map<string_type, size_t>::iterator ChildMapping;
+		MemoryFileEntry::~MemoryFileEntry()
+		{
+			// Children which are still referenced outlive their parent
+			BOOST_FOREACH(shared_ptr<MemoryFileEntry>& child, fileEntries)
+			{
+				child->parent = NULL;
+			}
+		}
 
 		FileEntryPointer MemoryFileEntry::getChildInternal(const string_type& path)
 		{
@@ -57,13 +82,103 @@ namespace vfspp
 		}
 
 		FileEntryPointer MemoryFileEntry::getChild(const string_type& path)
+		{
+			FileEntryPointer child;
+			util::throwStatus(tryGetChild(path, child));
+
+			return child;
+		}
+
+		Status MemoryFileEntry::tryGetChild(const string_type& path, FileEntryPointer& outEntry)
 		{
 			if (type != DIRECTORY)
 			{
-				throw InvalidOperationException("Entry is no directory!");
+				outEntry.reset();
+
+				return STATUS_NOT_DIRECTORY;
 			}
 
-			return getChildInternal(util::normalizePath(path));
+			string_type normalized = util::normalizePath(path);
+
+			if (frozen != NULL)
+			{
+				if (normalized.empty())
+				{
+					outEntry.reset();
+				}
+				else if (isRoot())
+				{
+					outEntry = frozen->find(normalized.data(), normalized.size());
+				}
+				else
+				{
+					string_type fullPath = this->path + DirectorySeparatorStr + normalized;
+					outEntry = frozen->find(fullPath.data(), fullPath.size());
+				}
+			}
+			else
+			{
+				outEntry = getChildInternal(normalized);
+			}
+
+			return outEntry ? STATUS_OK : STATUS_NOT_FOUND;
+		}
+
+		Status MemoryFileEntry::tryGetChild(const NormalizedPath& path, FileEntryPointer& outEntry)
+		{
+			outEntry.reset();
+
+			if (type != DIRECTORY)
+			{
+				return STATUS_NOT_DIRECTORY;
+			}
+
+			if (path.empty())
+			{
+				return STATUS_NOT_FOUND;
+			}
+
+			if (frozen != NULL)
+			{
+				boost::string_ref relative = path.str();
+
+				if (isRoot())
+				{
+					outEntry = frozen->find(relative.data(), relative.size());
+				}
+				else
+				{
+					string_type fullPath = this->path + DirectorySeparatorStr;
+					fullPath.append(relative.data(), relative.size());
+
+					outEntry = frozen->find(fullPath.data(), fullPath.size());
+				}
+
+				return outEntry ? STATUS_OK : STATUS_NOT_FOUND;
+			}
+
+			// Every level is looked up with the precomputed hash of its component
+			MemoryFileEntry* current = this;
+			for (size_t i = 0; i < path.numComponents(); ++i)
+			{
+				ChildMapping found = current->indexMapping.find(path.componentKey(i), PathKeyHash(), PathKeyEqual());
+
+				if (found == current->indexMapping.end())
+				{
+					return STATUS_NOT_FOUND;
+				}
+
+				if (i + 1 == path.numComponents())
+				{
+					outEntry = current->fileEntries[found->second];
+				}
+				else
+				{
+					current = current->fileEntries[found->second].get();
+				}
+			}
+
+			return STATUS_OK;
 		}
 
 		size_t MemoryFileEntry::numChildren()
@@ -73,7 +188,7 @@ namespace vfspp
 				throw InvalidOperationException("Entry is no directory!");
 			}
 
-			return fileEntries.size();
+			return frozen != NULL ? frozen->numChildren(frozenId) : fileEntries.size();
 		}
 
 		void MemoryFileEntry::listChildren(std::vector<FileEntryPointer>& outVector)
@@ -83,6 +198,13 @@ namespace vfspp
 				throw InvalidOperationException("Entry is no directory!");
 			}
 
+			if (frozen != NULL)
+			{
+				frozen->listChildren(frozenId, outVector);
+
+				return;
+			}
+
 			outVector.clear();
 
 			std::copy(fileEntries.begin(), fileEntries.end(), std::back_inserter(outVector));
@@ -90,22 +212,74 @@ namespace vfspp
 
 		boost::shared_ptr<std::streambuf> MemoryFileEntry::open(int mode)
 		{
+			shared_ptr<std::streambuf> buffer;
+			util::throwStatus(tryOpen(mode, buffer));
+
+			return buffer;
+		}
+
+		Status MemoryFileEntry::tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer)
+		{
+			outBuffer.reset();
+
 			if (type != FILE)
 			{
-				throw InvalidOperationException("Entry is no file!");
+				return STATUS_NOT_FILE;
 			}
 
-			if (mode & MODE_WRITE)
+			// Memory files are already in memory, getView() provides them without a stream
+			if (mode & MODE_MEMORY_MAPPED)
 			{
-				throw InvalidOperationException("Memory file is read only!");
+				return STATUS_NOT_SUPPORTED;
 			}
 
-			if (mode & MODE_MEMORY_MAPPED)
+			bool writable = (mode & MODE_WRITE) != 0;
+
+			if (writable && frozen != NULL)
+			{
+				return STATUS_NOT_SUPPORTED;
+			}
+
+			if (writable && (mode & MODE_READ) == 0)
+			{
+				contents->truncate();
+			}
+
+			outBuffer.reset(new MemoryStreamBuffer(contents, writable));
+
+			return STATUS_OK;
+		}
+
+		size_t MemoryFileEntry::readAt(boost::uint64_t offset, void* buffer, size_t length)
+		{
+			if (type != FILE)
 			{
-				throw InvalidOperationException("Cannot open in memory mapped mode!");
+				throw InvalidOperationException("Entry is no file!");
 			}
 
-			return shared_ptr<std::streambuf>(new iostreams::stream_buffer<MemoryBuffer<char>>(MemoryBuffer<char>(data, dataSize)));
+			return contents->read(offset, buffer, length);
+		}
+
+		bool MemoryFileEntry::getView(FileView& outView)
+		{
+			if (type != FILE)
+			{
+				throw InvalidOperationException("Entry is no file!");
+			}
+
+			outView = contents->view();
+
+			return true;
+		}
+
+		EntryStat MemoryFileEntry::stat()
+		{
+			EntryStat result;
+			result.type = type;
+			result.size = type == FILE ? contents->size() : 0;
+			result.writeTime = lastWriteTime();
+
+			return result;
 		}
 
 		EntryType MemoryFileEntry::getType() const
@@ -113,51 +287,360 @@ namespace vfspp
 			return type;
 		}
 
+		time_t MemoryFileEntry::lastWriteTime()
+		{
+			return type == FILE ? contents->lastWriteTime() : writeTime;
+		}
+
 		bool MemoryFileEntry::deleteChild(const string_type& name)
 		{
-			throw InvalidOperationException("Deleting not supported!");
+			if (type != DIRECTORY)
+			{
+				throw InvalidOperationException("Entry is no directory!");
+			}
+
+			checkNotFrozen();
+
+			string_type normalized = util::normalizePath(name);
+
+			MemoryFileEntry* directory = this;
+
+			size_t separator = normalized.find_last_of(DirectorySeparatorChar);
+			if (separator != string_type::npos)
+			{
+				FileEntryPointer entry = getChildInternal(normalized.substr(0, separator));
+
+				if (!entry || entry->getType() != DIRECTORY)
+				{
+					return false;
+				}
+
+				directory = static_cast<MemoryFileEntry*>(entry.get());
+				normalized.erase(0, separator + 1);
+			}
+
+			// Streams which are still open keep the contents of deleted files
+			return directory->removeChild(normalized) != NULL;
 		}
 
 		FileEntryPointer MemoryFileEntry::createEntry(EntryType type, const string_type& name)
 		{
-			throw InvalidOperationException("Creating not supported!");
+			if (this->type != DIRECTORY)
+			{
+				throw InvalidOperationException("Entry is no directory!");
+			}
+
+			if (!(type == DIRECTORY || type == FILE))
+			{
+				throw InvalidOperationException("Invalid entry type to create specified!");
+			}
+
+			checkNotFrozen();
+
+			string_type normalized = util::normalizePath(name);
+
+			if (normalized.empty())
+			{
+				throw InvalidOperationException("No name specified!");
+			}
+
+			time_t now = time(NULL);
+
+			// Missing parent directories are created as well
+			shared_ptr<MemoryFileEntry> entry;
+			MemoryFileEntry* directory = this;
+
+			size_t begin = 0;
+			while (begin < normalized.size())
+			{
+				size_t separator = normalized.find(DirectorySeparatorChar, begin);
+				if (separator == string_type::npos)
+				{
+					separator = normalized.size();
+				}
+
+				string_type component = normalized.substr(begin, separator - begin);
+				EntryType componentType = separator == normalized.size() ? type : DIRECTORY;
+
+				begin = separator + 1;
+
+				if (component.empty())
+				{
+					continue;
+				}
+
+				ChildMapping found = directory->indexMapping.find(component);
+
+				if (found != directory->indexMapping.end())
+				{
+					entry = directory->fileEntries[found->second];
+
+					if (entry->type != componentType)
+					{
+						throw InvalidOperationException(componentType == FILE ? "Path exists but is no file!" : "Path exists but is no directory!");
+					}
+				}
+				else
+				{
+					entry = directory->addChildEntry(component, componentType, now);
+					directory->writeTime = now;
+
+					if (componentType == FILE)
+					{
+						entry->contents = directory->createContents(shared_array<const char>(), 0, now);
+					}
+				}
+
+				directory = entry.get();
+			}
+
+			return entry;
 		}
 
 		void MemoryFileEntry::rename(const string_type& newPath)
 		{
-			throw InvalidOperationException("Renaming not supported!");
+			checkNotFrozen();
+
+			if (parent == NULL)
+			{
+				throw InvalidOperationException(isRoot() ? "The root can't be renamed!" : "Entry has been deleted!");
+			}
+
+			string_type normalized = util::normalizePath(newPath);
+
+			if (normalized.empty())
+			{
+				throw InvalidOperationException("No path specified!");
+			}
+
+			if (normalized == path)
+			{
+				return;
+			}
+
+			if (normalized.size() > path.size() && normalized.compare(0, path.size(), path) == 0
+				&& normalized[path.size()] == DirectorySeparatorChar)
+			{
+				throw InvalidOperationException("Entry can't be moved into itself!");
+			}
+
+			MemoryFileEntry* root = parent;
+			while (root->parent != NULL)
+			{
+				root = root->parent;
+			}
+
+			MemoryFileEntry* directory = root;
+			string_type newName = normalized;
+
+			size_t separator = normalized.find_last_of(DirectorySeparatorChar);
+			if (separator != string_type::npos)
+			{
+				FileEntryPointer entry = root->getChildInternal(normalized.substr(0, separator));
+
+				if (!entry || entry->getType() != DIRECTORY)
+				{
+					throw FileSystemException("Target directory doesn't exist!");
+				}
+
+				directory = static_cast<MemoryFileEntry*>(entry.get());
+				newName.erase(0, separator + 1);
+			}
+
+			if (directory->indexMapping.find(newName) != directory->indexMapping.end())
+			{
+				throw FileSystemException("Target already exists!");
+			}
+
+			shared_ptr<MemoryFileEntry> self = parent->removeChild(entryName(path));
+
+			directory->insertChild(newName, self);
+			directory->writeTime = time(NULL);
+
+			setPath(normalized);
 		}
 
-		boost::shared_ptr<MemoryFileEntry> MemoryFileEntry::addChild(const string_type& name, EntryType type,
-			time_t write_time, void* data, size_t dataSize)
+		boost::shared_ptr<MemoryFileEntry> MemoryFileEntry::addChildEntry(const string_type& name, EntryType type,
+			time_t write_time)
 		{
 			if (this->type != DIRECTORY)
 			{
 				throw InvalidOperationException("Can only add children to directory!");
 			}
 
+			checkNotFrozen();
+
 			if (name.find(DirectorySeparatorChar) != string_type::npos)
 			{
 				throw InvalidOperationException("No child path may be specified!");
 			}
 
+			string_type normalizedName = util::normalizePath(name);
+
+			// A second entry with the same name would break the mapping of names to children
+			if (indexMapping.find(normalizedName) != indexMapping.end())
+			{
+				throw FileSystemException("Entry already exists!");
+			}
+
 			string_type newPath(path);
-			newPath.append(DirectorySeparatorStr).append(util::normalizePath(name));
+			if (!newPath.empty())
+			{
+				newPath.append(DirectorySeparatorStr);
+			}
+			newPath.append(normalizedName);
+
+			MemoryArena* arena = getArena();
 
-			shared_ptr<MemoryFileEntry> entry = shared_ptr<MemoryFileEntry>(new MemoryFileEntry(name));
+			shared_ptr<MemoryFileEntry> entry;
+			if (arena != NULL)
+			{
+				// The control block is placed in the arena as well
+				void* memory = arena->allocate(sizeof(MemoryFileEntry), alignment_of<MemoryFileEntry>::value);
+
+				entry = shared_ptr<MemoryFileEntry>(new (memory) MemoryFileEntry(newPath, arena), ArenaDestroyer(),
+					ArenaAllocator<MemoryFileEntry>(arena));
+			}
+			else
+			{
+				entry = shared_ptr<MemoryFileEntry>(new MemoryFileEntry(newPath, NULL));
+			}
 
 			entry->type = type;
 			entry->writeTime = write_time;
 
-			if (type == FILE)
+			insertChild(normalizedName, entry);
+
+			return entry;
+		}
+
+		boost::shared_ptr<MemoryFileContents> MemoryFileEntry::createContents(const boost::shared_array<const char>& data,
+			size_t dataSize, time_t write_time)
+		{
+			MemoryArena* arena = getArena();
+
+			if (arena != NULL)
 			{
-				entry->data = shared_array<char>(new char[dataSize]);
-				memcpy(entry->data.get(), data, dataSize);
-				entry->dataSize = dataSize;
+				void* memory = arena->allocate(sizeof(MemoryFileContents), alignment_of<MemoryFileContents>::value);
+
+				return shared_ptr<MemoryFileContents>(new (memory) MemoryFileContents(data, dataSize, write_time),
+					ArenaDestroyer(), ArenaAllocator<MemoryFileContents>(arena));
 			}
 
+			return shared_ptr<MemoryFileContents>(new MemoryFileContents(data, dataSize, write_time));
+		}
+
+		void MemoryFileEntry::insertChild(const string_type& name, const boost::shared_ptr<MemoryFileEntry>& entry)
+		{
+			entry->parent = this;
+
 			fileEntries.push_back(entry);
-			indexMapping.insert(std::make_pair(util::normalizePath(name), fileEntries.size() - 1));
+			indexMapping.insert(std::make_pair(name, fileEntries.size() - 1));
+		}
+
+		boost::shared_ptr<MemoryFileEntry> MemoryFileEntry::removeChild(const string_type& name)
+		{
+			ChildMapping found = indexMapping.find(name);
+
+			if (found == indexMapping.end())
+			{
+				return shared_ptr<MemoryFileEntry>();
+			}
+
+			size_t index = found->second;
+			shared_ptr<MemoryFileEntry> entry = fileEntries[index];
+
+			indexMapping.erase(found);
+
+			// The last child takes the place of the removed one so no other index changes
+			if (index + 1 != fileEntries.size())
+			{
+				shared_ptr<MemoryFileEntry>& moved = fileEntries.back();
+
+				indexMapping[entryName(moved->path)] = index;
+				fileEntries[index] = moved;
+			}
+
+			fileEntries.pop_back();
+
+			entry->parent = NULL;
+			writeTime = time(NULL);
+
+			return entry;
+		}
+
+		void MemoryFileEntry::setPath(const string_type& newPath)
+		{
+			path = newPath;
+
+			BOOST_FOREACH(shared_ptr<MemoryFileEntry>& child, fileEntries)
+			{
+				child->setPath(newPath + DirectorySeparatorStr + entryName(child->path));
+			}
+		}
+
+		void MemoryFileEntry::checkNotFrozen() const
+		{
+			if (frozen != NULL)
+			{
+				throw InvalidOperationException("The filesystem is frozen!");
+			}
+		}
+
+		boost::shared_ptr<MemoryFileEntry> MemoryFileEntry::addChild(const string_type& name, EntryType type,
+			time_t write_time, void* data, size_t dataSize)
+		{
+			shared_ptr<MemoryFileEntry> entry = addChildEntry(name, type, write_time);
+
+			if (type == FILE)
+			{
+				MemoryArena* arena = getArena();
+
+				shared_array<char> copy;
+				if (arena != NULL && dataSize <= MemoryFileSystem::MaxArenaFileSize)
+				{
+					copy = arena->allocateShared(dataSize);
+				}
+				else
+				{
+					copy.reset(new char[dataSize]);
+				}
+
+				memcpy(copy.get(), data, dataSize);
+
+				entry->contents = createContents(copy, dataSize, write_time);
+			}
+
+			return entry;
+		}
+
+		boost::shared_ptr<MemoryFileEntry> MemoryFileEntry::addChild(const string_type& name,
+			const boost::shared_array<const char>& data, size_t dataSize, time_t write_time)
+		{
+			shared_ptr<MemoryFileEntry> entry = addChildEntry(name, FILE, write_time);
+
+			entry->contents = createContents(data, dataSize, write_time);
+
+			return entry;
+		}
+
+		boost::shared_ptr<MemoryFileEntry> MemoryFileEntry::addChild(const string_type& name,
+			const boost::shared_ptr<const void>& owner, const char* data, size_t dataSize, time_t write_time)
+		{
+			return addChild(name, shared_array<const char>(data, OwnerDeleter(owner)), dataSize, write_time);
+		}
+
+		boost::shared_ptr<MemoryFileEntry> MemoryFileEntry::addChild(const string_type& name, std::vector<char>&& data,
+			time_t write_time)
+		{
+			// The entry is added first so the vector is left untouched if the name is invalid
+			shared_ptr<MemoryFileEntry> entry = addChildEntry(name, FILE, write_time);
+
+			shared_ptr<std::vector<char> > owner(new std::vector<char>(std::move(data)));
+
+			const char* begin = owner->empty() ? NULL : &(*owner)[0];
+
+			entry->contents = createContents(shared_array<const char>(begin, OwnerDeleter(owner)), owner->size(), write_time);
 
 			return entry;
 		}
@@ -1,14 +1,39 @@
-
 #include <VFSPP/memory.hpp>
 
+#include "FrozenIndex.hpp"
+
 namespace vfspp
 {
 	namespace memory
 	{
-		MemoryFileSystem::MemoryFileSystem()
+		const size_t MemoryFileSystem::MaxArenaFileSize;
+
+		MemoryFileSystem::MemoryFileSystem(bool useArena)
 		{
-			rootEntry.reset(new MemoryFileEntry(""));
+			if (useArena)
+			{
+				arena.reset(new MemoryArena());
+			}
+
+			rootEntry.reset(new MemoryFileEntry("", arena.get()));
 			rootEntry->type = DIRECTORY;
 		}
+
+		MemoryFileSystem::~MemoryFileSystem()
+		{
+		}
+
+		int MemoryFileSystem::supportedOperations() const
+		{
+			return frozen ? OP_READ : OP_READ | OP_WRITE | OP_CREATE | OP_DELETE;
+		}
+
+		void MemoryFileSystem::freeze()
+		{
+			if (!frozen)
+			{
+				frozen.reset(new FrozenIndex(rootEntry.get()));
+			}
+		}
 	}
 }
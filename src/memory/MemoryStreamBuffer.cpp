@@ -0,0 +1,155 @@
+#include "MemoryStreamBuffer.hpp"
+
+#include <algorithm>
+
+namespace vfspp
+{
+	namespace memory
+	{
+		MemoryStreamBuffer::MemoryStreamBuffer(const boost::shared_ptr<MemoryFileContents>& contentsIn, bool writableIn) :
+			contents(contentsIn), writable(writableIn), areaStart(0), areaVersion(0)
+		{
+			setg(NULL, NULL, NULL);
+			setp(NULL, NULL);
+		}
+
+		MemoryStreamBuffer::~MemoryStreamBuffer()
+		{
+			flushAreas();
+		}
+
+		size_t MemoryStreamBuffer::position() const
+		{
+			if (pbase() != NULL)
+			{
+				return areaStart + static_cast<size_t>(pptr() - pbase());
+			}
+
+			if (eback() != NULL)
+			{
+				return areaStart + static_cast<size_t>(gptr() - eback());
+			}
+
+			return areaStart;
+		}
+
+		void MemoryStreamBuffer::flushAreas()
+		{
+			size_t current = position();
+
+			if (pbase() != NULL && pptr() != pbase())
+			{
+				if (areaVersion == contents->version())
+				{
+					contents->commit(current);
+				}
+				else
+				{
+					// The chunk has been replaced since the put area was set up
+					contents->write(areaStart, pbase(), static_cast<size_t>(pptr() - pbase()));
+				}
+			}
+
+			setg(NULL, NULL, NULL);
+			setp(NULL, NULL);
+			areaBuffer.reset();
+
+			areaStart = current;
+		}
+
+		MemoryStreamBuffer::int_type MemoryStreamBuffer::underflow()
+		{
+			flushAreas();
+
+			size_t available;
+			const char* data = contents->readable(areaStart, available, areaBuffer);
+			areaVersion = contents->version();
+
+			if (available == 0)
+			{
+				return traits_type::eof();
+			}
+
+			char* begin = const_cast<char*>(data);
+			setg(begin, begin, begin + available);
+
+			return traits_type::to_int_type(*gptr());
+		}
+
+		MemoryStreamBuffer::int_type MemoryStreamBuffer::overflow(int_type c)
+		{
+			if (!writable)
+			{
+				return traits_type::eof();
+			}
+
+			flushAreas();
+
+			size_t available;
+			char* data = contents->writable(areaStart, available, areaBuffer);
+			areaVersion = contents->version();
+
+			setp(data, data + available);
+
+			if (!traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+
+			return traits_type::not_eof(c);
+		}
+
+		int MemoryStreamBuffer::sync()
+		{
+			flushAreas();
+
+			return 0;
+		}
+
+		std::streamsize MemoryStreamBuffer::showmanyc()
+		{
+			size_t current = position();
+			size_t size = std::max(contents->size(), pbase() != NULL ? current : 0);
+
+			return current < size ? static_cast<std::streamsize>(size - current) : -1;
+		}
+
+		// The get and put areas share one position, so both are moved regardless of the open mode
+		MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir,
+			std::ios_base::openmode /* which */)
+		{
+			flushAreas();
+
+			off_type base;
+			switch (dir)
+			{
+			case std::ios_base::beg:
+				base = 0;
+				break;
+			case std::ios_base::cur:
+				base = static_cast<off_type>(areaStart);
+				break;
+			case std::ios_base::end:
+				base = static_cast<off_type>(contents->size());
+				break;
+			default:
+				return pos_type(off_type(-1));
+			}
+
+			if (base + off < 0)
+			{
+				return pos_type(off_type(-1));
+			}
+
+			areaStart = static_cast<size_t>(base + off);
+
+			return pos_type(static_cast<off_type>(areaStart));
+		}
+
+		MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+		{
+			return seekoff(off_type(pos), std::ios_base::beg, which);
+		}
+	}
+}
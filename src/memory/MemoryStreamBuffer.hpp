@@ -0,0 +1,58 @@
+#pragma once
+
+#include <streambuf>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "vfspp_compiler_detection.h"
+
+#include "MemoryFileContents.hpp"
+
+namespace vfspp
+{
+	namespace memory
+	{
+		// Reads and writes the chunks of a memory file directly, one chunk is exposed as the get or
+		// put area at a time. Written bytes become part of the file when the buffer is synced, when
+		// it moves to another chunk or when it is destroyed. The chunk of the current area is kept alive, if
+		// another stream replaced it meanwhile the written bytes are copied to the file when they are committed.
+		class MemoryStreamBuffer : public std::streambuf, private boost::noncopyable
+		{
+		public:
+			MemoryStreamBuffer(const boost::shared_ptr<MemoryFileContents>& contents, bool writable);
+
+			virtual ~MemoryStreamBuffer();
+
+		protected:
+			virtual int_type underflow() VFSPP_OVERRIDE;
+
+			virtual int_type overflow(int_type c) VFSPP_OVERRIDE;
+
+			virtual int sync() VFSPP_OVERRIDE;
+
+			virtual std::streamsize showmanyc() VFSPP_OVERRIDE;
+
+			virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) VFSPP_OVERRIDE;
+
+			virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) VFSPP_OVERRIDE;
+
+		private:
+			boost::shared_ptr<MemoryFileContents> contents;
+			bool writable;
+
+			// File offset of the start of the current get or put area, or of the stream position if
+			// there is no area
+			size_t areaStart;
+
+			// Buffer of the get or put area and the layout version of the contents when it was set
+			boost::shared_array<const char> areaBuffer;
+			size_t areaVersion;
+
+			size_t position() const;
+
+			// Commits written bytes and resets the get and put areas to the current position
+			void flushAreas();
+		};
+	}
+}
@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <utility>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <VFSPP/memory.hpp>
+#include <VFSPP/util.hpp>
+#include <VFSPP/walk.hpp>
+
+namespace vfspp
+{
+	namespace memory
+	{
+		namespace
+		{
+			struct SourceEntry
+			{
+				FileEntryPointer entry;
+
+				// Relative to the source directory
+				string_type path;
+
+				EntryStat stat;
+
+				// Directory of the target the file is added to
+				MemoryFileEntry* targetParent;
+
+				SourceEntry(const FileEntryPointer& entryIn, const string_type& pathIn, const EntryStat& statIn) :
+					entry(entryIn), path(pathIn), stat(statIn), targetParent(NULL) {}
+
+				bool operator<(const SourceEntry& other) const { return path < other.path; }
+			};
+
+			bool matchesAny(const std::vector<string_type>& patterns, const string_type& path)
+			{
+				BOOST_FOREACH(const string_type& pattern, patterns)
+				{
+					if (util::matchPattern(pattern, path))
+					{
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			// Splits a relative path into the path of its directory and its name
+			void splitPath(const string_type& path, string_type& outDirectory, string_type& outName)
+			{
+				size_t separator = path.find_last_of(DirectorySeparatorChar);
+
+				if (separator == string_type::npos)
+				{
+					outDirectory.clear();
+					outName = path;
+				}
+				else
+				{
+					outDirectory = path.substr(0, separator);
+					outName = path.substr(separator + 1);
+				}
+			}
+
+			MemoryFileEntry* getDirectory(MemoryFileEntry* target, const string_type& path)
+			{
+				if (path.empty())
+				{
+					return target;
+				}
+
+				// Parents are created before their children, the tree owns the directory
+				return static_cast<MemoryFileEntry*>(target->getChild(path).get());
+			}
+
+			// Directories are created first, in the order of their paths so every parent exists before
+			// its children. The files are then read concurrently, only adding them to the tree is locked.
+			class Preloader : private boost::noncopyable
+			{
+			private:
+				IFileSystemEntry* source;
+				MemoryFileEntry* target;
+				const PreloadOptions& options;
+
+				std::vector<SourceEntry> directories;
+				std::vector<SourceEntry> files;
+
+				// Guards the collected entries while walking and the target while reading
+				boost::mutex lock;
+
+				boost::atomic<size_t> nextFile;
+				boost::atomic<boost::uint64_t> loadedBytes;
+
+				boost::atomic<bool> failed;
+				std::exception_ptr error;
+				boost::mutex errorLock;
+
+				string_type relativePath(const FileEntryPointer& entry) const
+				{
+					return source->isRoot() ? entry->getPath() : entry->getPath().substr(source->getPath().size() + 1);
+				}
+
+				bool descend(const FileEntryPointer& directory, int)
+				{
+					return !matchesAny(options.exclude, relativePath(directory));
+				}
+
+				void collect(const FileEntryPointer& entry, int)
+				{
+					string_type path = relativePath(entry);
+
+					if (matchesAny(options.exclude, path))
+					{
+						return;
+					}
+
+					EntryType type = entry->getType();
+
+					if (type == DIRECTORY)
+					{
+						EntryStat stat;
+						stat.type = DIRECTORY;
+						stat.writeTime = entry->lastWriteTime();
+
+						boost::lock_guard<boost::mutex> guard(lock);
+						directories.push_back(SourceEntry(entry, path, stat));
+					}
+					else if (type == FILE && (options.include.empty() || matchesAny(options.include, path)))
+					{
+						EntryStat stat = entry->stat();
+
+						boost::lock_guard<boost::mutex> guard(lock);
+						files.push_back(SourceEntry(entry, path, stat));
+					}
+				}
+
+				void createDirectories(PreloadResult& result)
+				{
+					std::sort(directories.begin(), directories.end());
+
+					string_type parentPath;
+					string_type name;
+
+					BOOST_FOREACH(SourceEntry& directory, directories)
+					{
+						splitPath(directory.path, parentPath, name);
+
+						MemoryFileEntry* parent = getDirectory(target, parentPath);
+
+						FileEntryPointer existing;
+						if (parent->tryGetChild(name, existing) == STATUS_OK)
+						{
+							if (existing->getType() != DIRECTORY)
+							{
+								throw FileSystemException("Target already exists!");
+							}
+
+							continue;
+						}
+
+						parent->addChild(name, DIRECTORY, directory.stat.writeTime);
+						++result.numDirectories;
+					}
+
+					directories.clear();
+				}
+
+				// Decides which files fit into the budget before anything is read
+				void selectFiles(PreloadResult& result)
+				{
+					std::sort(files.begin(), files.end());
+
+					std::vector<SourceEntry> selected;
+					selected.reserve(files.size());
+
+					boost::uint64_t totalBytes = 0;
+
+					string_type parentPath;
+					string_type lastParentPath;
+					string_type name;
+					MemoryFileEntry* parent = NULL;
+
+					BOOST_FOREACH(SourceEntry& file, files)
+					{
+						if (options.maxBytes != 0 && totalBytes + file.stat.size > options.maxBytes)
+						{
+							++result.numSkipped;
+							continue;
+						}
+
+						if (file.stat.size > std::numeric_limits<size_t>::max())
+						{
+							throw FileSystemException("File is too big to be preloaded!");
+						}
+
+						splitPath(file.path, parentPath, name);
+
+						// Sorted files of the same directory are next to each other
+						if (parent == NULL || parentPath != lastParentPath)
+						{
+							parent = getDirectory(target, parentPath);
+							lastParentPath = parentPath;
+						}
+
+						FileEntryPointer existing;
+						if (parent->tryGetChild(name, existing) == STATUS_OK)
+						{
+							throw FileSystemException("Target already exists!");
+						}
+
+						totalBytes += file.stat.size;
+
+						file.targetParent = parent;
+						selected.push_back(file);
+					}
+
+					files.swap(selected);
+				}
+
+				void load(SourceEntry& file)
+				{
+					size_t size = static_cast<size_t>(file.stat.size);
+
+					std::vector<char> data(size);
+
+					// Files which shrink after they have been listed are loaded with their new size
+					size_t position = 0;
+					while (position < size)
+					{
+						size_t read = file.entry->readAt(position, &data[position], size - position);
+
+						if (read == 0)
+						{
+							break;
+						}
+
+						position += read;
+					}
+
+					data.resize(position);
+
+					string_type directory;
+					string_type name;
+					splitPath(file.path, directory, name);
+
+					{
+						boost::lock_guard<boost::mutex> guard(lock);
+
+						file.targetParent->addChild(name, std::move(data), file.stat.writeTime);
+					}
+
+					loadedBytes.fetch_add(position, boost::memory_order_relaxed);
+
+					file.entry.reset();
+				}
+
+				void fail()
+				{
+					boost::lock_guard<boost::mutex> guard(errorLock);
+
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+
+					failed.store(true);
+				}
+
+				void work()
+				{
+					while (!failed.load(boost::memory_order_relaxed))
+					{
+						size_t index = nextFile.fetch_add(1);
+
+						if (index >= files.size())
+						{
+							return;
+						}
+
+						try
+						{
+							load(files[index]);
+						}
+						catch (...)
+						{
+							fail();
+						}
+					}
+				}
+
+			public:
+				Preloader(IFileSystemEntry* sourceIn, MemoryFileEntry* targetIn, const PreloadOptions& optionsIn) :
+					source(sourceIn), target(targetIn), options(optionsIn), nextFile(0), loadedBytes(0), failed(false)
+				{
+				}
+
+				PreloadResult run()
+				{
+					WalkOptions walkOptions;
+					walkOptions.numThreads = options.numThreads;
+					walkOptions.descend = boost::bind(&Preloader::descend, this, _1, _2);
+
+					walk(source, boost::bind(&Preloader::collect, this, _1, _2), walkOptions);
+
+					PreloadResult result;
+					createDirectories(result);
+					selectFiles(result);
+
+					size_t numThreads = options.numThreads;
+					if (numThreads == 0)
+					{
+						numThreads = std::max(boost::thread::hardware_concurrency(), 1u);
+					}
+
+					// The calling thread is the first reader
+					boost::thread_group threads;
+					for (size_t i = 1; i < std::min(numThreads, files.size()); ++i)
+					{
+						threads.create_thread(boost::bind(&Preloader::work, this));
+					}
+
+					work();
+
+					threads.join_all();
+
+					if (error)
+					{
+						std::rethrow_exception(error);
+					}
+
+					result.numFiles = files.size();
+					result.numBytes = loadedBytes.load();
+
+					return result;
+				}
+			};
+		}
+
+		PreloadResult preload(IFileSystemEntry* source, MemoryFileEntry* target, const PreloadOptions& options)
+		{
+			if (source == NULL || target == NULL)
+			{
+				throw InvalidOperationException("Entry pointer is null!");
+			}
+
+			if (source->getType() != DIRECTORY || target->getType() != DIRECTORY)
+			{
+				throw InvalidOperationException("Entry is no directory!");
+			}
+
+			Preloader preloader(source, target, options);
+
+			return preloader.run();
+		}
+
+		PreloadResult preload(IFileSystem* source, MemoryFileSystem* target, const PreloadOptions& options)
+		{
+			if (source == NULL || target == NULL)
+			{
+				throw InvalidOperationException("File system pointer is null!");
+			}
+
+			return preload(source->getRootEntry(), target->getRootEntry(), options);
+		}
+	}
+}
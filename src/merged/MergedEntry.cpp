@@ -1,4 +1,6 @@
 
+#include <algorithm>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
 #include <boost/thread/lock_guard.hpp>
@@ -32,15 +34,15 @@ namespace
 	}
 }
 
-typedef unordered_map<string_type, shared_ptr<MergedEntry> >::iterator ChildMapping;
+typedef unordered_map<string_type, shared_ptr<MergedEntry> >::const_iterator ChildMapping;
 
-MergedEntry::MergedEntry(MergedFileSystem* parentSystem, FileEntryPointer contained) :
+MergedEntry::MergedEntry(MergedFileSystem* parentSystem, FileEntryPointer contained, size_t layer) :
 IFileSystemEntry(contained ? contained->getPath() : ""), parentSystem(parentSystem), containedEntry(contained),
-dirty(true)
+containedLayer(layer), dirty(true)
 {
 }
 
-void MergedEntry::addChildren(IFileSystemEntry* entry)
+void MergedEntry::addChildren(size_t layer, IFileSystemEntry* entry, ChildTable& table)
 {
 	if (entry->getType() != DIRECTORY)
 	{
@@ -53,25 +55,32 @@ void MergedEntry::addChildren(IFileSystemEntry* entry)
 
 	BOOST_FOREACH(FileEntryPointer& childEntry, entries)
 	{
-		string_type entryName = util::normalizePath(childEntry->getPath(), parentSystem->caseInsensitive);
-		if (!isRoot())
-		{
-			entryName = util::normalizePath(entryName.substr(path.size()));
-		}
-		size_t slash = entryName.find_first_of(DirectorySeparatorChar);
+		// The paths of entries are normalized already, only the part after this directory is needed
+		const string_type& childPath = childEntry->getPath();
 
-		if (slash != string_type::npos)
+		const char* nameBegin = childPath.data() + (isRoot() ? 0 : std::min(path.size(), childPath.size()));
+		const char* nameEnd = childPath.data() + childPath.size();
+		util::trimPath(nameBegin, nameEnd);
+
+		string_type entryName(nameBegin, std::find(nameBegin, nameEnd, DirectorySeparatorChar));
+
+		if (parentSystem->caseInsensitive)
 		{
-			entryName.resize(slash);
+			boost::to_lower(entryName);
 		}
 
-		if (cachedChildMapping.find(entryName) == cachedChildMapping.end())
+		if (table.mapping.find(entryName) == table.mapping.end())
 		{
 			// This entry hasn't been found yet
-			shared_ptr<MergedEntry> newEntry(new MergedEntry(parentSystem, childEntry));
+			shared_ptr<MergedEntry> newEntry(new MergedEntry(parentSystem, childEntry, layer));
 
-			cachedChildMapping.insert(std::make_pair(entryName, newEntry));
-			cachedChildEntries.push_back(newEntry);
+			table.mapping.insert(std::make_pair(entryName, newEntry));
+			table.entries.push_back(newEntry);
+
+			if (parentSystem->flatIndexEnabled)
+			{
+				parentSystem->indexEntry(childKey(entryName), newEntry);
+			}
 		}
 	}
 }
@@ -80,51 +89,124 @@ void MergedEntry::cacheChildren()
 {
 	boost::lock_guard<boost::mutex> lock(childrenLock);
 
-	if (!dirty)
+	shared_ptr<const ChildTable> previous = atomic_load(&childTable);
+
+	if (previous && !dirty.load(memory_order_acquire))
 	{
+		// Another thread rebuilt the table while we were waiting
 		return;
 	}
 
-	cachedChildEntries.clear();
-	cachedChildMapping.clear();
+	rebuildChildTable(previous);
+}
 
-	BOOST_FOREACH(shared_ptr<IFileSystem>& system, parentSystem->fileSystems)
+void MergedEntry::rebuildChildTable(const shared_ptr<const ChildTable>& previous)
+{
+	// Cleared before the rebuild so a modification happening meanwhile triggers another one
+	dirty.store(false, memory_order_release);
+
+	shared_ptr<ChildTable> table(new ChildTable());
+
+	for (size_t i = 0; i < parentSystem->fileSystems.size(); ++i)
 	{
+		shared_ptr<IFileSystem>& system = parentSystem->fileSystems[i];
+
 		if (system->supportedOperations() & OP_READ)
 		{
 			if (isRoot())
 			{
-				addChildren(system->getRootEntry());
+				addChildren(i, system->getRootEntry(), *table);
 			}
 			else
 			{
-				FileEntryPointer entry = system->getRootEntry()->getChild(path);
+				FileEntryPointer entry = parentSystem->getLayerEntry(i, path);
 
 				if (entry)
 				{
-					addChildren(entry.get());
+					addChildren(i, entry.get(), *table);
 				}
 			}
 		}
 	}
 
-	dirty = false;
+	if (parentSystem->flatIndexEnabled && previous)
+	{
+		// Entries which disappeared since the directory was cached the last time must not be found anymore
+		for (ChildMapping iter = previous->mapping.begin(); iter != previous->mapping.end(); ++iter)
+		{
+			if (table->mapping.find(iter->first) == table->mapping.end())
+			{
+				parentSystem->unindexEntry(childKey(iter->first));
+			}
+		}
+	}
+
+	// Readers still using the previous table keep it alive until they are done
+	atomic_store(&childTable, shared_ptr<const ChildTable>(table));
 }
 
-boost::shared_ptr<MergedEntry> MergedEntry::getEntryInternal(const string_type& path)
+void MergedEntry::insertChild(const string_type& name, const shared_ptr<MergedEntry>& entry)
 {
-	if (dirty)
+	boost::lock_guard<boost::mutex> lock(childrenLock);
+
+	shared_ptr<const ChildTable> current = atomic_load(&childTable);
+
+	if (!current)
+	{
+		// Not cached yet, the entry will be picked up when the table is built
+		return;
+	}
+
+	if (current->mapping.find(name) != current->mapping.end())
+	{
+		// Which filesystem provides the entry depends on their order
+		rebuildChildTable(current);
+		return;
+	}
+
+	shared_ptr<ChildTable> table(new ChildTable(*current));
+
+	table->mapping.insert(std::make_pair(name, entry));
+	table->entries.push_back(entry);
+
+	atomic_store(&childTable, shared_ptr<const ChildTable>(table));
+}
+
+shared_ptr<const MergedEntry::ChildTable> MergedEntry::getChildTable()
+{
+	shared_ptr<const ChildTable> table = atomic_load(&childTable);
+
+	if (!table || dirty.load(memory_order_acquire))
 	{
 		cacheChildren();
+
+		table = atomic_load(&childTable);
+	}
+
+	return table;
+}
+
+string_type MergedEntry::childKey(const string_type& name) const
+{
+	if (isRoot())
+	{
+		return name;
 	}
 
+	return parentSystem->indexKey(path) + DirectorySeparatorChar + name;
+}
+
+boost::shared_ptr<MergedEntry> MergedEntry::getEntryInternal(const string_type& path)
+{
+	shared_ptr<const ChildTable> table = getChildTable();
+
 	size_t separator = path.find_first_of(DirectorySeparatorChar);
 
 	if (separator == string_type::npos)
 	{
-		ChildMapping found = cachedChildMapping.find(path);
+		ChildMapping found = table->mapping.find(path);
 
-		if (found != cachedChildMapping.end())
+		if (found != table->mapping.end())
 		{
 			return found->second;
 		}
@@ -133,9 +215,9 @@ boost::shared_ptr<MergedEntry> MergedEntry::getEntryInternal(const string_type&
 	{
 		string_type thisLevel = path.substr(0, separator);
 
-		ChildMapping found = cachedChildMapping.find(thisLevel);
+		ChildMapping found = table->mapping.find(thisLevel);
 
-		if (found != cachedChildMapping.end())
+		if (found != table->mapping.end())
 		{
 			return found->second->getEntryInternal(path.substr(separator + 1));
 		}
@@ -146,97 +228,222 @@ boost::shared_ptr<MergedEntry> MergedEntry::getEntryInternal(const string_type&
 
 FileEntryPointer MergedEntry::getChild(const string_type& path)
 {
+	FileEntryPointer child;
+	util::throwStatus(tryGetChild(path, child));
+
+	return child;
+}
+
+Status MergedEntry::tryGetChild(const string_type& path, FileEntryPointer& outEntry)
+{
+	outEntry.reset();
+
 	if (getType() != DIRECTORY)
 	{
-		throw InvalidOperationException("Entry is no directory!");
+		return STATUS_NOT_DIRECTORY;
 	}
 
-	return getEntryInternal(util::normalizePath(path, parentSystem->caseInsensitive));
+	string_type normalized = util::normalizePath(path, parentSystem->caseInsensitive);
+
+	if (parentSystem->flatIndexEnabled)
+	{
+		outEntry = parentSystem->findIndexed(childKey(normalized));
+
+		if (outEntry)
+		{
+			return STATUS_OK;
+		}
+
+		// Directories which haven't been cached yet aren't indexed, they are cached on the way down
+	}
+
+	outEntry = getEntryInternal(normalized);
+
+	return outEntry ? STATUS_OK : STATUS_NOT_FOUND;
 }
 
-size_t MergedEntry::numChildren()
+Status MergedEntry::tryGetChild(const NormalizedPath& path, FileEntryPointer& outEntry)
 {
+	if (parentSystem->caseInsensitive && !path.isLowerCase())
+	{
+		// The children are mapped by their lower case names
+		return tryGetChild(path.toString(), outEntry);
+	}
+
+	outEntry.reset();
+
 	if (getType() != DIRECTORY)
 	{
-		throw InvalidOperationException("Entry is no directory!");
+		return STATUS_NOT_DIRECTORY;
 	}
 
-	if (dirty)
+	if (path.empty())
 	{
-		cacheChildren();
+		return STATUS_NOT_FOUND;
+	}
+
+	if (parentSystem->flatIndexEnabled && isRoot())
+	{
+		outEntry = parentSystem->findIndexed(path.key());
+
+		if (outEntry)
+		{
+			return STATUS_OK;
+		}
+	}
+
+	// Keeps the directory alive in case its parent replaces its children meanwhile
+	shared_ptr<MergedEntry> current;
+	MergedEntry* directory = this;
+
+	for (size_t i = 0; i < path.numComponents(); ++i)
+	{
+		shared_ptr<const ChildTable> table = directory->getChildTable();
+
+		ChildMapping found = table->mapping.find(path.componentKey(i), PathKeyHash(), PathKeyEqual());
+
+		if (found == table->mapping.end())
+		{
+			return STATUS_NOT_FOUND;
+		}
+
+		current = found->second;
+		directory = current.get();
 	}
 
-	return cachedChildEntries.size();
+	outEntry = current;
+
+	return STATUS_OK;
 }
 
-void MergedEntry::listChildren(std::vector<FileEntryPointer>& outVector)
+size_t MergedEntry::numChildren()
 {
 	if (getType() != DIRECTORY)
 	{
 		throw InvalidOperationException("Entry is no directory!");
 	}
 
-	if (dirty)
+	return getChildTable()->entries.size();
+}
+
+void MergedEntry::listChildren(std::vector<FileEntryPointer>& outVector)
+{
+	if (getType() != DIRECTORY)
 	{
-		cacheChildren();
+		throw InvalidOperationException("Entry is no directory!");
 	}
 
+	shared_ptr<const ChildTable> table = getChildTable();
+
 	outVector.clear();
 
-	std::copy(cachedChildEntries.begin(), cachedChildEntries.end(), std::back_inserter(outVector));
+	std::copy(table->entries.begin(), table->entries.end(), std::back_inserter(outVector));
 }
 
 boost::shared_ptr<std::streambuf> MergedEntry::open(int mode)
 {
+	shared_ptr<std::streambuf> buffer;
+	util::throwStatus(tryOpen(mode, buffer));
+
+	return buffer;
+}
+
+Status MergedEntry::tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer)
+{
+	outBuffer.reset();
+
 	int ops = util::modeToOperation(mode);
 
 	if (!(parentSystem->supportedOperations() & ops))
 	{
-		throw InvalidOperationException("No filesystem supports the requested operations!");
+		return STATUS_NOT_SUPPORTED;
 	}
 
 	if (getType() != FILE)
 	{
-		throw InvalidOperationException("Entry is no file!");
+		return STATUS_NOT_FILE;
 	}
 
-	try
+	// First try to open the contained entry, if that fails try to open a file of another filesystem
+	if ((parentSystem->fileSystems[containedLayer]->supportedOperations() & ops)
+		&& containedEntry->tryOpen(mode, outBuffer) == STATUS_OK)
 	{
-		// First try to open the contained entry
-		return containedEntry->open(mode);
+		return STATUS_OK;
 	}
-	catch (...)
+
+	for (size_t i = 0; i < parentSystem->fileSystems.size(); ++i)
 	{
-		// If that fails try to open a file of another filesystem
+		if (i != containedLayer && (parentSystem->fileSystems[i]->supportedOperations() & ops))
+		{
+			shared_ptr<IFileSystemEntry> entry = parentSystem->getLayerEntry(i, path);
+
+			// Errors of single filesystems are ignored, the search continues with the next one
+			if (entry && entry->getType() == FILE && entry->tryOpen(mode, outBuffer) == STATUS_OK)
+			{
+				return STATUS_OK;
+			}
+		}
+	}
+
+	return STATUS_IO_ERROR;
+}
+
+FileEntryPointer MergedEntry::getReadableEntry()
+{
+	if (!(parentSystem->supportedOperations() & OP_READ))
+	{
+		throw InvalidOperationException("No filesystem supports the requested operations!");
+	}
+
+	if (getType() != FILE)
+	{
+		throw InvalidOperationException("Entry is no file!");
+	}
+
+	// The contained entry is the one open() would use as well
+	if (parentSystem->fileSystems[containedLayer]->supportedOperations() & OP_READ)
+	{
+		return containedEntry;
 	}
 
-	BOOST_FOREACH(shared_ptr<IFileSystem>& system, parentSystem->fileSystems)
+	// Otherwise use the file of the first other filesystem which provides it
+	for (size_t i = 0; i < parentSystem->fileSystems.size(); ++i)
 	{
-		if (system->supportedOperations() & ops)
+		if (i != containedLayer && (parentSystem->fileSystems[i]->supportedOperations() & OP_READ))
 		{
-			shared_ptr<IFileSystemEntry> entry = system->getRootEntry()->getChild(path);
+			FileEntryPointer entry = parentSystem->getLayerEntry(i, path);
 
 			if (entry && entry->getType() == FILE)
 			{
-				try
-				{
-					shared_ptr<std::streambuf> buffer = entry->open(mode);
-
-					if (buffer)
-					{
-						// Stop if we have sucessfully opened a file
-						return buffer;
-					}
-				}
-				catch (const FileSystemException&)
-				{
-					// Ignore filesystem errors and continue searching
-				}
+				return entry;
 			}
 		}
 	}
 
-	throw FileSystemException("Failed to open file from any filesystem!");
+	throw FileSystemException("Failed to read file from any filesystem!");
+}
+
+size_t MergedEntry::readAt(boost::uint64_t offset, void* buffer, size_t length)
+{
+	return getReadableEntry()->readAt(offset, buffer, length);
+}
+
+bool MergedEntry::getView(FileView& outView)
+{
+	return getReadableEntry()->getView(outView);
+}
+
+EntryStat MergedEntry::stat()
+{
+	if (isRoot())
+	{
+		EntryStat result;
+		result.type = DIRECTORY;
+
+		return result;
+	}
+
+	return containedEntry->stat();
 }
 
 EntryType MergedEntry::getType() const
@@ -287,11 +494,11 @@ bool MergedEntry::deleteChild(const string_type& name)
 	}
 
 	bool success = false;
-	BOOST_FOREACH(shared_ptr<IFileSystem>& system, parentSystem->fileSystems)
+	for (size_t i = 0; i < parentSystem->fileSystems.size(); ++i)
 	{
-		if (system->supportedOperations() & OP_DELETE)
+		if (parentSystem->fileSystems[i]->supportedOperations() & OP_DELETE)
 		{
-			FileEntryPointer entry = system->getRootEntry()->getChild(path);
+			FileEntryPointer entry = parentSystem->getLayerEntry(i, path);
 
 			if (entry && entry->getType() == DIRECTORY)
 			{
@@ -309,7 +516,22 @@ bool MergedEntry::deleteChild(const string_type& name)
 
 	if (success)
 	{
-		dirty = true;
+		{
+			// A lower filesystem may still provide an entry with that name
+			boost::lock_guard<boost::mutex> lock(childrenLock);
+
+			shared_ptr<const ChildTable> current = atomic_load(&childTable);
+
+			if (current)
+			{
+				rebuildChildTable(current);
+			}
+		}
+
+		if (parentSystem->flatIndexEnabled)
+		{
+			parentSystem->unindexEntry(childKey(util::normalizePath(name, parentSystem->caseInsensitive)));
+		}
 	}
 
 	return success;
@@ -327,11 +549,11 @@ FileEntryPointer MergedEntry::createEntry(EntryType type, const string_type& nam
 		throw InvalidOperationException("Entry is no directory!");
 	}
 
-	BOOST_FOREACH(shared_ptr<IFileSystem>& system, parentSystem->fileSystems)
+	for (size_t i = 0; i < parentSystem->fileSystems.size(); ++i)
 	{
-		if (system->supportedOperations() & OP_CREATE)
+		if (parentSystem->fileSystems[i]->supportedOperations() & OP_CREATE)
 		{
-			FileEntryPointer entry = system->getRootEntry()->getChild(path);
+			FileEntryPointer entry = parentSystem->getLayerEntry(i, path);
 
 			if (entry && entry->getType() == DIRECTORY)
 			{
@@ -341,10 +563,23 @@ FileEntryPointer MergedEntry::createEntry(EntryType type, const string_type& nam
 
 					if (newEntry)
 					{
-						dirty = true;
+						shared_ptr<MergedEntry> mergedEntry(new MergedEntry(parentSystem, newEntry, i));
+
+						string_type childName = util::normalizePath(name, parentSystem->caseInsensitive);
+
+						insertChild(childName, mergedEntry);
+
+						if (parentSystem->flatIndexEnabled)
+						{
+							// The new entry may hide one of a lower filesystem
+							string_type key = childKey(childName);
+
+							parentSystem->unindexEntry(key);
+							parentSystem->indexEntry(key, mergedEntry);
+						}
 
 						// Stop if we have sucessfully created an entry
-						return shared_ptr<MergedEntry>(new MergedEntry(parentSystem, newEntry));
+						return mergedEntry;
 					}
 				}
 				catch (const FileSystemException&)
@@ -377,6 +612,29 @@ void MergedEntry::rename(const string_type& newPath)
 	{
 		parentSystem->getRootEntry()->dirty = true;
 	}
+
+	string_type newKey = parentSystem->indexKey(newPath);
+
+	if (parentSystem->flatIndexEnabled)
+	{
+		parentSystem->unindexEntry(parentSystem->indexKey(path));
+		parentSystem->unindexEntry(newKey);
+	}
+
+	// The directory receiving the entry has to pick it up as well
+	size_t slash = newKey.find_last_of(DirectorySeparatorChar);
+	if (slash == string_type::npos)
+	{
+		parentSystem->getRootEntry()->dirty = true;
+	}
+	else
+	{
+		FileEntryPointer newParent;
+		if (parentSystem->getRootEntry()->tryGetChild(newKey.substr(0, slash), newParent) == STATUS_OK)
+		{
+			static_pointer_cast<MergedEntry>(newParent)->dirty = true;
+		}
+	}
 }
 
 time_t MergedEntry::lastWriteTime()
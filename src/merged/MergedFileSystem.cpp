@@ -1,14 +1,17 @@
 
 #include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
 
 #include "VFSPP/merged.hpp"
+#include "VFSPP/util.hpp"
+#include "VFSPP/walk.hpp"
 
 using namespace vfspp;
 using namespace vfspp::merged;
 
 using namespace boost;
 
-MergedFileSystem::MergedFileSystem()
+MergedFileSystem::MergedFileSystem() : caseInsensitive(false), flatIndexEnabled(false)
 {
 	rootEntry.reset(new MergedEntry(this, shared_ptr<IFileSystemEntry>()));
 }
@@ -21,6 +24,7 @@ void MergedFileSystem::addFileSystem(IFileSystem* fileSystem)
 	}
 
 	fileSystems.push_back(shared_ptr<IFileSystem>(fileSystem));
+	layerFilters.push_back(shared_ptr<util::BloomFilter>());
 }
 
 MergedEntry* MergedFileSystem::getRootEntry()
@@ -40,25 +44,138 @@ int MergedFileSystem::supportedOperations() const
 	return ops;
 }
 
-void MergedFileSystem::populateChildren(MergedEntry* entry, int level)
+void MergedFileSystem::populateEntries(int levels)
 {
-	if (level <= 0)
-	{
-		return;
-	}
+	// Listing the directories caches their children, the entries themselves aren't needed here
+	WalkOptions options;
+	options.maxDepth = levels;
 
-	entry->cacheChildren();
+	walk(rootEntry.get(), WalkCallback(), options);
+}
 
-	BOOST_FOREACH(shared_ptr<MergedEntry> childEntry, entry->cachedChildEntries)
+void MergedFileSystem::buildLayerFilters()
+{
+	for (size_t i = 0; i < fileSystems.size(); ++i)
 	{
-		if (childEntry->getType() == DIRECTORY)
+		if (fileSystems[i]->supportedOperations() & (OP_WRITE | OP_CREATE | OP_DELETE))
 		{
-			populateChildren(childEntry.get(), level - 1);
+			// The contents may change, a filter could hide new entries
+			layerFilters[i].reset();
+			continue;
 		}
+
+		std::vector<FileEntryPointer> entries;
+		walk(fileSystems[i]->getRootEntry(), entries);
+
+		shared_ptr<util::BloomFilter> filter(new util::BloomFilter(entries.size() + 1));
+
+		// Lower case so lookups in filesystems which ignore the case are never filtered out
+		filter->insert(string_type());
+		BOOST_FOREACH(const FileEntryPointer& entry, entries)
+		{
+			filter->insert(util::normalizePath(entry->getPath(), true));
+		}
+
+		layerFilters[i] = filter;
 	}
 }
 
-void MergedFileSystem::populateEntries(int levels)
+FileEntryPointer MergedFileSystem::getLayerEntry(size_t layer, const string_type& path) const
+{
+	const shared_ptr<util::BloomFilter>& filter = layerFilters[layer];
+
+	if (filter && !filter->mayContain(util::normalizePath(path, true)))
+	{
+		return FileEntryPointer();
+	}
+
+	FileEntryPointer entry;
+	fileSystems[layer]->getRootEntry()->tryGetChild(path, entry);
+
+	return entry;
+}
+
+void MergedFileSystem::setFlatIndexEnabled(bool enabled)
+{
+	boost::unique_lock<boost::shared_mutex> lock(flatIndexLock);
+
+	flatIndexEnabled = enabled;
+	flatIndex.clear();
+
+	if (enabled)
+	{
+		// Directories which have already been cached are indexed again the next time they're used
+		rootEntry->dirty = true;
+	}
+}
+
+string_type MergedFileSystem::indexKey(const string_type& path) const
+{
+	return util::normalizePath(path, caseInsensitive);
+}
+
+shared_ptr<MergedEntry> MergedFileSystem::findIndexed(const string_type& key) const
+{
+	boost::shared_lock<boost::shared_mutex> lock(flatIndexLock);
+
+	unordered_map<string_type, shared_ptr<MergedEntry> >::const_iterator found = flatIndex.find(key);
+
+	if (found == flatIndex.end())
+	{
+		return shared_ptr<MergedEntry>();
+	}
+
+	return found->second;
+}
+
+shared_ptr<MergedEntry> MergedFileSystem::findIndexed(const PathKey& key) const
 {
-	populateChildren(rootEntry.get(), levels);
+	boost::shared_lock<boost::shared_mutex> lock(flatIndexLock);
+
+	unordered_map<string_type, shared_ptr<MergedEntry> >::const_iterator found = flatIndex.find(key, PathKeyHash(), PathKeyEqual());
+
+	if (found == flatIndex.end())
+	{
+		return shared_ptr<MergedEntry>();
+	}
+
+	return found->second;
+}
+
+void MergedFileSystem::indexEntry(const string_type& key, const shared_ptr<MergedEntry>& entry)
+{
+	boost::unique_lock<boost::shared_mutex> lock(flatIndexLock);
+
+	if (flatIndexEnabled)
+	{
+		flatIndex[key] = entry;
+	}
+}
+
+void MergedFileSystem::unindexEntry(const string_type& key)
+{
+	boost::unique_lock<boost::shared_mutex> lock(flatIndexLock);
+
+	if (!flatIndexEnabled)
+	{
+		return;
+	}
+
+	flatIndex.erase(key);
+
+	// Modifications are rare compared to lookups so the descendants are found by scanning
+	string_type prefix = key + DirectorySeparatorChar;
+
+	unordered_map<string_type, shared_ptr<MergedEntry> >::iterator iter = flatIndex.begin();
+	while (iter != flatIndex.end())
+	{
+		if (boost::starts_with(iter->first, prefix))
+		{
+			iter = flatIndex.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
 }
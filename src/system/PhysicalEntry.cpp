@@ -1,62 +1,50 @@
 
 #include <algorithm>
+#include <cerrno>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <boost/filesystem/fstream.hpp>
+#include <boost/system/error_code.hpp>
 
 #include <boost/iostreams/stream_buffer.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
 
 #include "VFSPP/system.hpp"
+#include "VFSPP/util.hpp"
+
+#include "ReadHandle.hpp"
 
 namespace
 {
-	boost::filesystem::path uncomplete(const boost::filesystem::path& base, const boost::filesystem::path& path)
+	vfspp::EntryType statusToType(const boost::filesystem::file_status& status)
 	{
-		if (path.has_root_path())
+		if (!boost::filesystem::exists(status))
 		{
-			if (path.root_path() != base.root_path())
-			{
-				return path;
-			}
-			else
-			{
-				return uncomplete(base.relative_path(), path.relative_path());
-			}
+			return vfspp::UNKNOWN;
+		}
+		else if (boost::filesystem::is_directory(status))
+		{
+			return vfspp::DIRECTORY;
 		}
 		else
 		{
-			if (base.has_root_path())
-			{
-				throw vfspp::InvalidOperationException("Cannot uncomplete a path relative path from a rooted base");
-			}
-			else
-			{
-				typedef boost::filesystem::path::const_iterator path_iterator;
-
-				path_iterator path_it = path.begin();
-				path_iterator base_it = base.begin();
-
-				while (path_it != path.end() && base_it != base.end())
-				{
-					if (*path_it != *base_it) break;
-					++path_it; ++base_it;
-				}
+			return vfspp::FILE;
+		}
+	}
 
-				boost::filesystem::path result;
-				for (; base_it != base.end(); ++base_it)
-				{
-					result /= "..";
-				}
+	// Keeps the mapping open as long as a view into it exists
+	struct MappingOwner
+	{
+		boost::iostreams::mapped_file_source mapping;
 
-				for (; path_it != path.end(); ++path_it)
-				{
-					result /= *path_it;
-				}
+		explicit MappingOwner(const boost::iostreams::mapped_file_source& mappingIn) : mapping(mappingIn) {}
 
-				return result;
-			}
-		}
-	}
+		void operator()(const char*) const {}
+	};
 }
 
 using namespace vfspp;
@@ -66,11 +54,22 @@ using namespace boost;
 using namespace boost::filesystem;
 
 PhysicalEntry::PhysicalEntry(PhysicalFileSystem* parentSystemIn, const vfspp::string_type& pathIn)
-: IFileSystemEntry(pathIn), parentSystem(parentSystemIn)
+: IFileSystemEntry(pathIn), parentSystem(parentSystemIn), cachedType(-1)
 {
 	entryPath = parentSystem->getPhysicalRoot() / this->path;
 }
 
+PhysicalEntry::PhysicalEntry(PhysicalFileSystem* parentSystemIn, const vfspp::string_type& pathIn, EntryType knownType)
+: IFileSystemEntry(pathIn), parentSystem(parentSystemIn), cachedType(knownType)
+{
+	entryPath = parentSystem->getPhysicalRoot() / this->path;
+}
+
+PhysicalEntry::~PhysicalEntry()
+{
+	parentSystem->closeReadHandle(this);
+}
+
 size_t PhysicalEntry::numChildren()
 {
 	if ((parentSystem->supportedOperations() & OP_READ) == 0)
@@ -88,21 +87,37 @@ size_t PhysicalEntry::numChildren()
 
 FileEntryPointer PhysicalEntry::getChild(const string_type& path)
 {
+	FileEntryPointer child;
+	util::throwStatus(tryGetChild(path, child));
+
+	return child;
+}
+
+Status PhysicalEntry::tryGetChild(const string_type& path, FileEntryPointer& outEntry)
+{
+	outEntry.reset();
+
 	if (getType() != DIRECTORY)
 	{
-		throw InvalidOperationException("Entry is no directory!");
+		return STATUS_NOT_DIRECTORY;
 	}
 
 	boost::filesystem::path childPath = entryPath / path;
 
-	if (exists(childPath))
-	{
-		return FileEntryPointer(new PhysicalEntry(parentSystem, path));
-	}
-	else
+	boost::system::error_code errorCode;
+	EntryType type = statusToType(status(childPath, errorCode));
+
+	if (type == UNKNOWN)
 	{
-		return FileEntryPointer();
+		return STATUS_NOT_FOUND;
 	}
+
+	// The child path is relative to this entry, the new entry needs it relative to the root
+	string_type childEntryPath = (boost::filesystem::path(this->path) / path).generic_string();
+
+	outEntry.reset(new PhysicalEntry(parentSystem, childEntryPath, type));
+
+	return STATUS_OK;
 }
 
 void PhysicalEntry::listChildren(std::vector<FileEntryPointer>& outVector)
@@ -123,26 +138,104 @@ void PhysicalEntry::listChildren(std::vector<FileEntryPointer>& outVector)
 
 	for (directory_iterator iter(entryPath); iter != end; ++iter)
 	{
-		boost::filesystem::path relativ = uncomplete(parentSystem->getPhysicalRoot(), iter->path());
+		// Children are directly inside this entry so the relative path doesn't need to be computed from the root
+		string_type relativ = iter->path().filename().generic_string();
+		if (!path.empty())
+		{
+			relativ = path + DirectorySeparatorChar + relativ;
+		}
+
+		// The status is filled from the directory listing where the OS provides it, only symlinks
+		// and file systems without type information need an extra stat
+		boost::system::error_code errorCode;
+		EntryType type = statusToType(iter->status(errorCode));
 
-		outVector.push_back(FileEntryPointer(new PhysicalEntry(parentSystem, relativ.generic_string())));
+		if (errorCode)
+		{
+			outVector.push_back(FileEntryPointer(new PhysicalEntry(parentSystem, relativ)));
+		}
+		else
+		{
+			outVector.push_back(FileEntryPointer(new PhysicalEntry(parentSystem, relativ, type)));
+		}
 	}
 }
 
 EntryType PhysicalEntry::getType() const
 {
-	if (!exists(entryPath))
+	int type = cachedType.load(boost::memory_order_relaxed);
+
+	if (type >= 0)
 	{
-		return UNKNOWN;
+		return static_cast<EntryType>(type);
 	}
-	else if (is_directory(entryPath))
+
+	boost::system::error_code errorCode;
+	return statusToType(status(entryPath, errorCode));
+}
+
+void PhysicalEntry::refresh()
+{
+	if (cachedType.load(boost::memory_order_relaxed) >= 0)
 	{
-		return DIRECTORY;
+		boost::system::error_code errorCode;
+		cachedType.store(statusToType(status(entryPath, errorCode)), boost::memory_order_relaxed);
+	}
+}
+
+EntryStat PhysicalEntry::stat()
+{
+	EntryStat result;
+
+#ifndef WIN32
+	// A single stat call instead of the separate queries of getType() and lastWriteTime()
+	struct stat info;
+
+	if (::stat(entryPath.c_str(), &info) != 0)
+	{
+		if (errno == ENOENT || errno == ENOTDIR)
+		{
+			return result;
+		}
+
+		boost::system::error_code e(errno, boost::system::system_category());
+
+		throw FileSystemException("Failed to stat file: " + e.message());
+	}
+
+	if (S_ISDIR(info.st_mode))
+	{
+		result.type = DIRECTORY;
+	}
+	else
+	{
+		result.type = FILE;
+		result.size = static_cast<boost::uint64_t>(info.st_size);
+	}
+
+	result.writeTime = info.st_mtime;
+#else
+	file_status fileStatus = status(entryPath);
+
+	if (!exists(fileStatus))
+	{
+		return result;
+	}
+
+	if (is_directory(fileStatus))
+	{
+		result.type = DIRECTORY;
 	}
 	else
 	{
-		return FILE;
+		result.type = FILE;
+		result.size = file_size(entryPath);
 	}
+
+	result.writeTime = last_write_time(entryPath);
+#endif
+
+	return result;
 }
 
 bool PhysicalEntry::deleteChild(const string_type& name)
@@ -261,26 +354,36 @@ FileEntryPointer PhysicalEntry::createEntry(EntryType type, const string_type& n
 		}
 	}
 
-	return FileEntryPointer(new PhysicalEntry(parentSystem, name));
+	return FileEntryPointer(new PhysicalEntry(parentSystem, (boost::filesystem::path(path) / name).generic_string(), type));
 }
 
 boost::shared_ptr<std::streambuf> PhysicalEntry::open(int mode)
+{
+	shared_ptr<std::streambuf> buffer;
+	util::throwStatus(tryOpen(mode, buffer));
+
+	return buffer;
+}
+
+Status PhysicalEntry::tryOpen(int mode, boost::shared_ptr<std::streambuf>& outBuffer)
 {
 	using namespace boost::iostreams;
 
+	outBuffer.reset();
+
 	if ((mode & MODE_WRITE) != 0 && (parentSystem->supportedOperations() & OP_WRITE) == 0)
 	{
-		throw InvalidOperationException("System does not support writing!");
+		return STATUS_NOT_SUPPORTED;
 	}
 
 	if ((mode & MODE_READ) != 0 && (parentSystem->supportedOperations() & OP_READ) == 0)
 	{
-		throw InvalidOperationException("System does not support writing!");
+		return STATUS_NOT_SUPPORTED;
 	}
 
 	if (getType() != FILE)
 	{
-		throw InvalidOperationException("Entry is no file!");
+		return STATUS_NOT_FILE;
 	}
 
 	std::ios_base::openmode openmode = std::ios::binary;
@@ -297,19 +400,24 @@ boost::shared_ptr<std::streambuf> PhysicalEntry::open(int mode)
 
 	if (mode & MODE_MEMORY_MAPPED)
 	{
-		typedef stream_buffer<mapped_file> mapped_buffer;
-
 		basic_mapped_file_params<boost::filesystem::path> params(getEntryPath());
 		params.mode = openmode;
 
-		shared_ptr<mapped_buffer> buffer = shared_ptr<mapped_buffer>(new mapped_buffer(params));
-		if (!buffer->is_open())
+		try
 		{
-			throw FileSystemException("Failed to open memory mapped file!");
+			if (mode & MODE_WRITE)
+			{
+				outBuffer.reset(new stream_buffer<mapped_file>(mapped_file(params)));
+			}
+			else
+			{
+				// A read only mapped_file never reports its stream buffer as open
+				outBuffer.reset(new stream_buffer<mapped_file_source>(mapped_file_source(params)));
+			}
 		}
-		else
+		catch (const std::exception&)
 		{
-			return buffer;
+			return STATUS_IO_ERROR;
 		}
 	}
 	else
@@ -320,13 +428,114 @@ boost::shared_ptr<std::streambuf> PhysicalEntry::open(int mode)
 
 		if (!buffer->is_open())
 		{
-			throw FileSystemException("Failed to open file!");
+			return STATUS_IO_ERROR;
 		}
-		else
+
+		outBuffer = buffer;
+	}
+
+	return STATUS_OK;
+}
+
+size_t PhysicalEntry::readAt(boost::uint64_t offset, void* buffer, size_t length)
+{
+	if ((parentSystem->supportedOperations() & OP_READ) == 0)
+	{
+		throw InvalidOperationException("System does not support reading!");
+	}
+
+	if (getType() != FILE)
+	{
+		throw InvalidOperationException("Entry is no file!");
+	}
+
+#ifndef WIN32
+	shared_ptr<ReadHandle> readHandle = parentSystem->getReadHandle(this);
+	int handle = readHandle->descriptor();
+
+	char* out = static_cast<char*>(buffer);
+	size_t total = 0;
+
+	while (total < length)
+	{
+		ssize_t read = ::pread(handle, out + total, length - total, static_cast<off_t>(offset + total));
+
+		if (read < 0)
 		{
-			return buffer;
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			boost::system::error_code e(errno, boost::system::system_category());
+
+			throw FileSystemException("Failed to read file: " + e.message());
 		}
+
+		if (read == 0)
+		{
+			// End of file
+			break;
+		}
+
+		total += static_cast<size_t>(read);
+	}
+
+	return total;
+#else
+	// There is no pread, use a new stream for every read
+	return IFileSystemEntry::readAt(offset, buffer, length);
+#endif
+}
+
+bool PhysicalEntry::getView(FileView& outView)
+{
+	using namespace boost::iostreams;
+
+	if ((parentSystem->supportedOperations() & OP_READ) == 0)
+	{
+		throw InvalidOperationException("System does not support reading!");
+	}
+
+	if (getType() != FILE)
+	{
+		throw InvalidOperationException("Entry is no file!");
+	}
+
+	boost::system::error_code errorCode;
+	uintmax_t size = file_size(entryPath, errorCode);
+
+	if (errorCode)
+	{
+		return false;
+	}
+
+	if (size == 0)
+	{
+		// Empty files can't be mapped
+		outView = FileView(shared_array<const char>(new char[0]), 0);
+		return true;
+	}
+
+	mapped_file_source mapping;
+
+	try
+	{
+		mapping.open(basic_mapped_file_params<boost::filesystem::path>(entryPath));
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	if (!mapping.is_open())
+	{
+		return false;
 	}
+
+	outView = FileView(shared_array<const char>(mapping.data(), MappingOwner(mapping)), mapping.size());
+
+	return true;
 }
 
 void PhysicalEntry::rename(const string_type& newName)
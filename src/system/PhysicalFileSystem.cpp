@@ -1,10 +1,49 @@
 
+#include <cerrno>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <boost/system/error_code.hpp>
+#include <boost/thread/lock_guard.hpp>
+
 #include "VFSPP/system.hpp"
 
+#include "ReadHandle.hpp"
+
+using namespace vfspp;
 using namespace vfspp::system;
 
 using namespace boost::filesystem;
 
+const size_t PhysicalFileSystem::MaxReadHandles;
+
+ReadHandle::ReadHandle(const char* path) : handle(-1)
+{
+#ifndef WIN32
+	handle = ::open(path, O_RDONLY | O_CLOEXEC);
+
+	if (handle < 0)
+	{
+		boost::system::error_code e(errno, boost::system::system_category());
+
+		throw FileSystemException("Failed to open file: " + e.message());
+	}
+#endif
+}
+
+ReadHandle::~ReadHandle()
+{
+#ifndef WIN32
+	if (handle >= 0)
+	{
+		::close(handle);
+	}
+#endif
+}
+
 PhysicalFileSystem::PhysicalFileSystem(const boost::filesystem::path& physicalRoot)
 : physicalRoot(physicalRoot), operations(OP_READ | OP_WRITE | OP_DELETE | OP_CREATE)
 {
@@ -20,3 +59,53 @@ void PhysicalFileSystem::setAllowedOperations(int ops)
 {
 	operations = ops;
 }
+
+boost::shared_ptr<ReadHandle> PhysicalFileSystem::getReadHandle(const PhysicalEntry* entry)
+{
+	{
+		boost::lock_guard<boost::mutex> guard(readHandleLock);
+
+		boost::unordered_map<const PhysicalEntry*, ReadHandleList::iterator>::iterator found = readHandleMapping.find(entry);
+		if (found != readHandleMapping.end())
+		{
+			readHandles.splice(readHandles.begin(), readHandles, found->second);
+
+			return found->second->second;
+		}
+	}
+
+	// Opened without holding the lock so a slow open doesn't block reads of other files
+	boost::shared_ptr<ReadHandle> handle(new ReadHandle(entry->getEntryPath().c_str()));
+
+	boost::lock_guard<boost::mutex> guard(readHandleLock);
+
+	boost::unordered_map<const PhysicalEntry*, ReadHandleList::iterator>::iterator found = readHandleMapping.find(entry);
+	if (found != readHandleMapping.end())
+	{
+		// Another thread opened the file meanwhile, the new descriptor is closed again
+		return found->second->second;
+	}
+
+	readHandles.push_front(std::make_pair(entry, handle));
+	readHandleMapping[entry] = readHandles.begin();
+
+	if (readHandles.size() > MaxReadHandles)
+	{
+		readHandleMapping.erase(readHandles.back().first);
+		readHandles.pop_back();
+	}
+
+	return handle;
+}
+
+void PhysicalFileSystem::closeReadHandle(const PhysicalEntry* entry)
+{
+	boost::lock_guard<boost::mutex> guard(readHandleLock);
+
+	boost::unordered_map<const PhysicalEntry*, ReadHandleList::iterator>::iterator found = readHandleMapping.find(entry);
+	if (found != readHandleMapping.end())
+	{
+		readHandles.erase(found->second);
+		readHandleMapping.erase(found);
+	}
+}
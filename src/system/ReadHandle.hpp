@@ -0,0 +1,24 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+namespace vfspp
+{
+	namespace system
+	{
+		// File descriptor which readAt uses for positional reads, it's closed when the last read using it is done
+		class ReadHandle : private boost::noncopyable
+		{
+		public:
+			// Throws a FileSystemException if the file can't be opened
+			explicit ReadHandle(const char* path);
+
+			~ReadHandle();
+
+			int descriptor() const { return handle; }
+
+		private:
+			int handle;
+		};
+	}
+}
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "VFSPP/walk.hpp"
+
+using namespace vfspp;
+
+namespace
+{
+	struct Task
+	{
+		IFileSystemEntry* directory;
+
+		// Keeps the directory alive, empty for the start entry
+		FileEntryPointer owner;
+
+		int depth;
+
+		Task() : directory(NULL), depth(0) {}
+
+		Task(IFileSystemEntry* directoryIn, const FileEntryPointer& ownerIn, int depthIn) :
+			directory(directoryIn), owner(ownerIn), depth(depthIn) {}
+	};
+
+	// Every worker owns a deque of directories. The owner works on the newest directory so it
+	// stays close to the data it just listed, idle workers steal the oldest ones which tend to
+	// be the biggest subtrees.
+	class Walker : private boost::noncopyable
+	{
+	private:
+		struct Worker
+		{
+			boost::mutex lock;
+			std::deque<Task> tasks;
+		};
+
+		const WalkCallback& callback;
+		const WalkOptions& options;
+
+		std::vector<boost::shared_ptr<Worker> > workers;
+
+		// Directories which are queued or currently enumerated, the walk is done when this drops to 0
+		boost::atomic<size_t> pendingTasks;
+
+		// Directories which are queued and not taken yet. It is increased before a task is queued, so a
+		// worker may see a task which isn't in a deque yet but never misses one.
+		boost::atomic<size_t> queuedTasks;
+
+		// Workers without a task sleep until one is queued or the walk ends
+		boost::atomic<size_t> idleWorkers;
+		boost::mutex idleLock;
+		boost::condition_variable wakeUp;
+
+		boost::atomic<bool> failed;
+		std::exception_ptr error;
+		boost::mutex errorLock;
+
+		void push(size_t worker, const Task& task)
+		{
+			pendingTasks.fetch_add(1, boost::memory_order_relaxed);
+			queuedTasks.fetch_add(1);
+
+			{
+				boost::lock_guard<boost::mutex> guard(workers[worker]->lock);
+				workers[worker]->tasks.push_back(task);
+			}
+
+			// An idle worker either sees the queued task before it sleeps or is counted here
+			if (idleWorkers.load() > 0)
+			{
+				boost::lock_guard<boost::mutex> guard(idleLock);
+				wakeUp.notify_one();
+			}
+		}
+
+		void wakeAll()
+		{
+			boost::lock_guard<boost::mutex> guard(idleLock);
+			wakeUp.notify_all();
+		}
+
+		void waitForTask()
+		{
+			boost::unique_lock<boost::mutex> guard(idleLock);
+
+			idleWorkers.fetch_add(1);
+
+			while (queuedTasks.load() == 0 && pendingTasks.load() > 0 && !failed.load())
+			{
+				wakeUp.wait(guard);
+			}
+
+			idleWorkers.fetch_sub(1);
+		}
+
+		bool pop(size_t worker, Task& task)
+		{
+			boost::lock_guard<boost::mutex> guard(workers[worker]->lock);
+
+			if (workers[worker]->tasks.empty())
+			{
+				return false;
+			}
+
+			task = workers[worker]->tasks.back();
+			workers[worker]->tasks.pop_back();
+			queuedTasks.fetch_sub(1);
+
+			return true;
+		}
+
+		bool steal(size_t thief, Task& task)
+		{
+			for (size_t i = 1; i < workers.size(); ++i)
+			{
+				Worker& victim = *workers[(thief + i) % workers.size()];
+
+				boost::lock_guard<boost::mutex> guard(victim.lock);
+
+				if (!victim.tasks.empty())
+				{
+					task = victim.tasks.front();
+					victim.tasks.pop_front();
+					queuedTasks.fetch_sub(1);
+
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void process(size_t worker, const Task& task)
+		{
+			std::vector<FileEntryPointer> children;
+			task.directory->listChildren(children);
+
+			int depth = task.depth + 1;
+			bool enumerate = options.maxDepth < 0 || depth < options.maxDepth;
+
+			BOOST_FOREACH(const FileEntryPointer& child, children)
+			{
+				if (failed.load(boost::memory_order_relaxed))
+				{
+					return;
+				}
+
+				if (callback)
+				{
+					callback(child, depth);
+				}
+
+				if (enumerate && child->getType() == DIRECTORY && (!options.descend || options.descend(child, depth)))
+				{
+					push(worker, Task(child.get(), child, depth));
+				}
+			}
+		}
+
+		void fail()
+		{
+			boost::lock_guard<boost::mutex> guard(errorLock);
+
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+
+			failed.store(true);
+
+			wakeAll();
+		}
+
+		void work(size_t worker)
+		{
+			Task task;
+
+			while (!failed.load(boost::memory_order_relaxed) && pendingTasks.load() > 0)
+			{
+				if (pop(worker, task) || steal(worker, task))
+				{
+					try
+					{
+						process(worker, task);
+					}
+					catch (...)
+					{
+						fail();
+					}
+
+					// Release the entry before the directory counts as done
+					task = Task();
+
+					if (pendingTasks.fetch_sub(1) == 1)
+					{
+						wakeAll();
+					}
+				}
+				else
+				{
+					waitForTask();
+				}
+			}
+		}
+
+	public:
+		Walker(const WalkCallback& callbackIn, const WalkOptions& optionsIn) :
+			callback(callbackIn), options(optionsIn), pendingTasks(0), queuedTasks(0), idleWorkers(0), failed(false)
+		{
+			size_t numThreads = options.numThreads;
+			if (numThreads == 0)
+			{
+				numThreads = std::max(boost::thread::hardware_concurrency(), 1u);
+			}
+
+			for (size_t i = 0; i < numThreads; ++i)
+			{
+				workers.push_back(boost::shared_ptr<Worker>(new Worker()));
+			}
+		}
+
+		void run(IFileSystemEntry* start)
+		{
+			if (options.maxDepth == 0)
+			{
+				return;
+			}
+
+			push(0, Task(start, FileEntryPointer(), 0));
+
+			// The calling thread is the first worker
+			boost::thread_group threads;
+			for (size_t i = 1; i < workers.size(); ++i)
+			{
+				threads.create_thread(boost::bind(&Walker::work, this, i));
+			}
+
+			work(0);
+
+			threads.join_all();
+
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+	};
+
+	void collectEntry(std::vector<FileEntryPointer>* outEntries, boost::mutex* outLock, const FileEntryPointer& entry, int)
+	{
+		boost::lock_guard<boost::mutex> guard(*outLock);
+
+		outEntries->push_back(entry);
+	}
+}
+
+namespace vfspp
+{
+	void walk(IFileSystemEntry* start, const WalkCallback& callback, const WalkOptions& options)
+	{
+		if (start == NULL)
+		{
+			throw InvalidOperationException("Entry pointer is null!");
+		}
+
+		Walker walker(callback, options);
+
+		walker.run(start);
+	}
+
+	void walk(IFileSystem* fileSystem, const WalkCallback& callback, const WalkOptions& options)
+	{
+		if (fileSystem == NULL)
+		{
+			throw InvalidOperationException("File system pointer is null!");
+		}
+
+		walk(fileSystem->getRootEntry(), callback, options);
+	}
+
+	void walk(IFileSystemEntry* start, std::vector<FileEntryPointer>& outEntries, const WalkOptions& options)
+	{
+		boost::mutex outLock;
+
+		outEntries.clear();
+
+		walk(start, boost::bind(collectEntry, &outEntries, &outLock, _1, _2), options);
+	}
+}
@@ -2,10 +2,17 @@
 #include <VFSPP/7zip.hpp>
 #include <globals.hpp>
 
+#include <7zCrc.h>
+
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "gtest/gtest.h"
 
+#include <fstream>
+#include <map>
+#include <stdexcept>
 #include <iostream>
 
 using namespace vfspp;
@@ -15,6 +22,47 @@ using namespace vfspp::test;
 
 using namespace boost;
 
+namespace
+{
+	std::string readContent(IFileSystemEntry* root, const std::string& path, int mode = IFileSystemEntry::MODE_READ)
+	{
+		boost::shared_ptr<std::streambuf> buffer = root->getChild(path)->open(mode);
+		std::istream stream(buffer.get());
+
+		std::string content;
+		content.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+		return content;
+	}
+
+	void readConcurrently(SevenZipFileSystem* fs, int iterations, bool* success)
+	{
+		IFileSystemEntry *root = fs->getRootEntry();
+
+		*success = true;
+		for (int i = 0; i < iterations; ++i)
+		{
+			*success = *success && readContent(root, "folder1/test1.txt") == "TestTestTest";
+			*success = *success && readContent(root, "folder2/test3.txt") == "Test3";
+			*success = *success && readContent(root, "folder1/test2.txt") == "Test2";
+		}
+	}
+
+	UInt32 bitwiseCrc(const unsigned char* data, size_t size)
+	{
+		UInt32 crc = CRC_INIT_VAL;
+		for (size_t i = 0; i < size; ++i)
+		{
+			crc ^= data[i];
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+			}
+		}
+
+		return CRC_GET_DIGEST(crc);
+	}
+}
 
 TEST(SevenZipFileEntryTest, NumChildren)
 {
@@ -46,6 +94,61 @@ TEST(SevenZipFileEntryTest, FillChildren)
 	}
 }
 
+TEST(SevenZipFileEntryTest, ImplicitDirectories)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/implicit.7z");
+
+	std::vector<shared_ptr<IFileSystemEntry> > children;
+	{
+		IFileSystemEntry* rootDir = fs.getRootEntry();
+		rootDir->listChildren(children);
+
+		ASSERT_EQ(2, rootDir->numChildren());
+		ASSERT_EQ(2, children.size());
+
+		ASSERT_TRUE(vectorContainsEntry(children, "implicit", DIRECTORY));
+		ASSERT_TRUE(vectorContainsEntry(children, "test3.txt", vfspp::FILE));
+	}
+	{
+		FileEntryPointer dir = fs.getRootEntry()->getChild("implicit");
+		ASSERT_TRUE(dir.get() != NULL);
+		ASSERT_EQ(DIRECTORY, dir->getType());
+
+		dir->listChildren(children);
+
+		ASSERT_EQ(2, dir->numChildren());
+		ASSERT_EQ(2, children.size());
+
+		ASSERT_TRUE(vectorContainsEntry(children, "implicit/sub", DIRECTORY));
+		ASSERT_TRUE(vectorContainsEntry(children, "implicit/test2.txt", vfspp::FILE));
+	}
+	{
+		FileEntryPointer dir = fs.getRootEntry()->getChild("implicit/sub");
+		ASSERT_TRUE(dir.get() != NULL);
+
+		dir->listChildren(children);
+
+		ASSERT_EQ(1, children.size());
+		ASSERT_TRUE(vectorContainsEntry(children, "implicit/sub/test1.txt", vfspp::FILE));
+	}
+}
+
+TEST(SevenZipFileEntryTest, NormalizedLookup)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/implicit.7z");
+
+	FileEntryPointer child;
+	ASSERT_EQ(STATUS_OK, fs.getRootEntry()->tryGetChild(NormalizedPath("implicit/sub"), child));
+	ASSERT_EQ(DIRECTORY, child->getType());
+	ASSERT_STREQ("implicit/sub", child->getPath().c_str());
+
+	FileEntryPointer dir = fs.getRootEntry()->getChild("implicit");
+	ASSERT_EQ(STATUS_OK, dir->tryGetChild(NormalizedPath("sub"), child));
+	ASSERT_STREQ("implicit/sub", child->getPath().c_str());
+
+	ASSERT_EQ(STATUS_NOT_FOUND, fs.getRootEntry()->tryGetChild(NormalizedPath("implicit/foo"), child));
+}
+
 TEST(SevenZipFileEntryTest, DeleteChild)
 {
 	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/7zip.7z");
@@ -110,3 +213,416 @@ TEST(SevenZipFileEntryTest, OpenWrite)
 		ASSERT_THROW(root->open(IFileSystemEntry::MODE_WRITE), vfspp::InvalidOperationException);
 	}
 }
+
+TEST(SevenZipFileEntryTest, ReadAt)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z");
+
+	IFileSystemEntry *root = fs.getRootEntry();
+
+	char buffer[16] = {};
+
+	ASSERT_EQ(4, root->getChild("folder1/test2.txt")->readAt(1, buffer, sizeof(buffer)));
+	ASSERT_STREQ("est2", buffer);
+
+	ASSERT_EQ(0, root->getChild("folder1/test2.txt")->readAt(5, buffer, sizeof(buffer)));
+	ASSERT_EQ(0, root->getChild("folder2/empty.txt")->readAt(0, buffer, sizeof(buffer)));
+
+	// Only the first read of a file decodes its folder
+	ASSERT_EQ(3, root->getChild("folder1/test1.txt")->readAt(9, buffer, 3));
+	ASSERT_EQ(1, fs.getCacheStatistics().misses);
+
+	ASSERT_THROW(root->readAt(0, buffer, sizeof(buffer)), vfspp::InvalidOperationException);
+}
+
+TEST(SevenZipFileEntryTest, GetView)
+{
+	FileView stored;
+	FileView decoded;
+	{
+		// folders.7z only contains stored data which is mapped without decoding
+		SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z");
+
+		ASSERT_TRUE(fs.getRootEntry()->getChild("folder2/test3.txt")->getView(stored));
+		ASSERT_EQ(0, fs.getCacheStatistics().misses);
+
+		FileView empty;
+		ASSERT_TRUE(fs.getRootEntry()->getChild("folder2/empty.txt")->getView(empty));
+		ASSERT_EQ(0, empty.size());
+	}
+	{
+		SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/lzma.7z");
+
+		ASSERT_TRUE(fs.getRootEntry()->getChild("lzma/after.txt")->getView(decoded));
+		ASSERT_EQ(1, fs.getCacheStatistics().misses);
+	}
+
+	// Views stay valid after the filesystem has been destroyed
+	ASSERT_EQ("Test3", std::string(stored.begin(), stored.end()));
+	ASSERT_EQ("After", std::string(decoded.begin(), decoded.end()));
+}
+
+TEST(SevenZipFileEntryTest, Stat)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/lzma.7z");
+
+	IFileSystemEntry *root = fs.getRootEntry();
+
+	{
+		EntryStat info = root->getChild("lzma2/small.txt")->stat();
+
+		ASSERT_EQ(vfspp::FILE, info.type);
+		ASSERT_EQ(5, info.size);
+		ASSERT_TRUE(info.hasCrc);
+
+		// The solid block contains more than this file
+		ASSERT_FALSE(info.hasPackedSize);
+	}
+	{
+		EntryStat info = root->getChild("lzma")->stat();
+
+		ASSERT_EQ(vfspp::DIRECTORY, info.type);
+		ASSERT_EQ(0, info.size);
+	}
+
+	ASSERT_EQ(vfspp::DIRECTORY, root->stat().type);
+
+	// Nothing has to be decoded
+	ASSERT_EQ(0, fs.getCacheStatistics().misses);
+}
+
+TEST(SevenZipFileEntryTest, OpenStreamed)
+{
+	const int mode = IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_STREAMED;
+
+	const char* archives[] = { "/7z/lzma.7z", "/7z/folders.7z", "/7z/7zip.7z" };
+
+	BOOST_FOREACH(const char* archive, archives)
+	{
+		SevenZipFileSystem extracted(std::string(TEST_RESOURCE_DIR) + archive);
+		SevenZipFileSystem streamed(std::string(TEST_RESOURCE_DIR) + archive);
+
+		std::vector<shared_ptr<IFileSystemEntry> > stack;
+		streamed.getRootEntry()->listChildren(stack);
+
+		while (!stack.empty())
+		{
+			shared_ptr<IFileSystemEntry> entry = stack.back();
+			stack.pop_back();
+
+			if (entry->getType() == DIRECTORY)
+			{
+				entry->listChildren(stack);
+				continue;
+			}
+
+			std::string expected = readContent(extracted.getRootEntry(), entry->getPath());
+
+			ASSERT_EQ(expected, readContent(streamed.getRootEntry(), entry->getPath(), mode)) << archive << ": " << entry->getPath();
+		}
+
+		// Nothing was decoded as a whole
+		ASSERT_EQ(0, streamed.getCacheStatistics().misses);
+	}
+
+	{
+		SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/lzma.7z");
+
+		ASSERT_EQ(168000, readContent(fs.getRootEntry(), "lzma/big.txt", mode).size());
+		ASSERT_STREQ("After", readContent(fs.getRootEntry(), "lzma/after.txt", mode).c_str());
+		ASSERT_STREQ("Test2", readContent(fs.getRootEntry(), "lzma2/small.txt", mode).c_str());
+
+		// Already decoded blocks are used instead of decoding them again
+		readContent(fs.getRootEntry(), "lzma/small.txt");
+		ASSERT_STREQ("TestTestTest", readContent(fs.getRootEntry(), "lzma/small.txt", mode).c_str());
+		ASSERT_EQ(1, fs.getCacheStatistics().hits);
+	}
+}
+
+TEST(SevenZipFileSystemTest, UnmappedArchive)
+{
+	const int streamed = IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_STREAMED;
+
+	const char* archives[] = { "/7z/lzma.7z", "/7z/folders.7z", "/7z/7zip.7z" };
+
+	BOOST_FOREACH(const char* archive, archives)
+	{
+		SevenZipFileSystem mapped(std::string(TEST_RESOURCE_DIR) + archive);
+		SevenZipFileSystem unmapped(std::string(TEST_RESOURCE_DIR) + archive, false);
+
+		ASSERT_TRUE(unmapped.verifyArchive()) << archive;
+
+		std::vector<shared_ptr<IFileSystemEntry> > stack;
+		unmapped.getRootEntry()->listChildren(stack);
+
+		while (!stack.empty())
+		{
+			shared_ptr<IFileSystemEntry> entry = stack.back();
+			stack.pop_back();
+
+			if (entry->getType() == DIRECTORY)
+			{
+				entry->listChildren(stack);
+				continue;
+			}
+
+			std::string expected = readContent(mapped.getRootEntry(), entry->getPath());
+
+			ASSERT_EQ(expected, readContent(unmapped.getRootEntry(), entry->getPath())) << archive << ": " << entry->getPath();
+			ASSERT_EQ(expected, readContent(unmapped.getRootEntry(), entry->getPath(), streamed)) << archive << ": " << entry->getPath();
+		}
+	}
+
+	// Stored entries have to be decoded if the archive isn't mapped
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z", false);
+
+	FileView view;
+	ASSERT_TRUE(fs.getRootEntry()->getChild("folder2/test3.txt")->getView(view));
+	ASSERT_EQ("Test3", std::string(view.begin(), view.end()));
+	ASSERT_EQ(1, fs.getCacheStatistics().misses);
+}
+
+TEST(SevenZipFileSystemTest, FolderCache)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z");
+
+	IFileSystemEntry *root = fs.getRootEntry();
+
+	ASSERT_STREQ("TestTestTest", readContent(root, "folder1/test1.txt").c_str());
+	ASSERT_STREQ("Test3", readContent(root, "folder2/test3.txt").c_str());
+	ASSERT_STREQ("Test2", readContent(root, "folder1/test2.txt").c_str());
+	ASSERT_STREQ("", readContent(root, "folder2/empty.txt").c_str());
+
+	FolderCacheStatistics stats = fs.getCacheStatistics();
+
+	ASSERT_EQ(1, stats.hits);
+	ASSERT_EQ(2, stats.misses);
+	ASSERT_EQ(0, stats.evictions);
+	ASSERT_EQ(2, stats.cachedFolders);
+	ASSERT_EQ(22, stats.cachedBytes);
+}
+
+TEST(SevenZipFileSystemTest, FolderCacheEviction)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z");
+	fs.setCacheSize(1);
+
+	IFileSystemEntry *root = fs.getRootEntry();
+
+	ASSERT_STREQ("TestTestTest", readContent(root, "folder1/test1.txt").c_str());
+	ASSERT_STREQ("Test2", readContent(root, "folder1/test2.txt").c_str());
+	ASSERT_STREQ("Test3", readContent(root, "folder2/test3.txt").c_str());
+	ASSERT_STREQ("TestTestTest", readContent(root, "folder1/test1.txt").c_str());
+
+	FolderCacheStatistics stats = fs.getCacheStatistics();
+
+	ASSERT_EQ(1, stats.hits);
+	ASSERT_EQ(3, stats.misses);
+	ASSERT_EQ(2, stats.evictions);
+	ASSERT_EQ(1, stats.cachedFolders);
+	ASSERT_EQ(17, stats.cachedBytes);
+
+	fs.clearCache();
+
+	ASSERT_EQ(0, fs.getCacheStatistics().cachedBytes);
+}
+
+TEST(SevenZipFileSystemTest, SharedFolderBuffer)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z");
+
+	IFileSystemEntry *root = fs.getRootEntry();
+
+	boost::shared_ptr<std::streambuf> buffer = root->getChild("folder1/test2.txt")->open(IFileSystemEntry::MODE_READ);
+
+	// The buffer points into the cached folder so it must not be writable
+	ASSERT_ANY_THROW(buffer->sputc('x'));
+
+	// The open entry keeps the folder alive even if the cache drops it
+	fs.clearCache();
+
+	std::istream stream(buffer.get());
+
+	std::string content;
+	content.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+	ASSERT_STREQ("Test2", content.c_str());
+	ASSERT_STREQ("TestTestTest", readContent(root, "folder1/test1.txt").c_str());
+}
+
+TEST(SevenZipFileSystemTest, ConcurrentReads)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z");
+
+	// Force folders to be decoded over and over again
+	fs.setCacheSize(1);
+
+	const int numThreads = 8;
+	bool results[numThreads];
+
+	boost::thread_group threads;
+	for (int i = 0; i < numThreads; ++i)
+	{
+		threads.create_thread(boost::bind(readConcurrently, &fs, 100, &results[i]));
+	}
+	threads.join_all();
+
+	for (int i = 0; i < numThreads; ++i)
+	{
+		ASSERT_TRUE(results[i]);
+	}
+
+	FolderCacheStatistics stats = fs.getCacheStatistics();
+	ASSERT_EQ(numThreads * 100 * 3, stats.hits + stats.misses);
+}
+
+TEST(SevenZipFileSystemTest, VerifyArchive)
+{
+	{
+		SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z");
+
+		std::vector<std::string> corrupted;
+		ASSERT_TRUE(fs.verifyArchive(&corrupted, 4));
+		ASSERT_TRUE(corrupted.empty());
+
+		// Verifying doesn't fill the cache
+		ASSERT_EQ(0, fs.getCacheStatistics().cachedFolders);
+		ASSERT_STREQ("TestTestTest", readContent(fs.getRootEntry(), "folder1/test1.txt").c_str());
+	}
+
+	// Flip a byte of the packed data which starts right after the signature header
+	std::string archivePath = TEST_WRITE_DIR "/corrupted.7z";
+	boost::filesystem::copy_file(TEST_RESOURCE_DIR "/7z/folders.7z", archivePath, boost::filesystem::copy_option::overwrite_if_exists);
+	{
+		std::fstream file(archivePath.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		file.seekg(40);
+		char c = static_cast<char>(file.get());
+		file.seekp(40);
+		file.put(static_cast<char>(c ^ 0x55));
+	}
+
+	{
+		SevenZipFileSystem fs(archivePath);
+
+		std::vector<std::string> corrupted;
+		ASSERT_FALSE(fs.verifyArchive(&corrupted));
+		ASSERT_FALSE(corrupted.empty());
+
+		BOOST_FOREACH(const std::string& path, corrupted)
+		{
+			ASSERT_ANY_THROW(readContent(fs.getRootEntry(), path)) << path;
+		}
+	}
+}
+
+namespace
+{
+	void collectFile(std::map<std::string, std::string>* files, boost::mutex* lock,
+		const std::string& path, const FileView& view)
+	{
+		boost::lock_guard<boost::mutex> guard(*lock);
+
+		(*files)[path] = std::string(view.begin(), view.end());
+	}
+
+	void failExtraction(const std::string&, const FileView&)
+	{
+		throw std::runtime_error("Callback failed");
+	}
+}
+
+TEST(SevenZipFileSystemTest, ExtractFiles)
+{
+	SevenZipFileSystem fs(TEST_RESOURCE_DIR "/7z/folders.7z");
+
+	std::vector<std::string> paths;
+	paths.push_back("folder2/test3.txt");
+	paths.push_back("folder1/test1.txt");
+	paths.push_back("folder1/test2.txt");
+
+	std::map<std::string, std::string> files;
+	boost::mutex lock;
+	fs.extractFiles(paths, boost::bind(collectFile, &files, &lock, _1, _2), 4);
+
+	ASSERT_EQ(3, files.size());
+	ASSERT_STREQ("TestTestTest", files["folder1/test1.txt"].c_str());
+	ASSERT_STREQ("Test2", files["folder1/test2.txt"].c_str());
+	ASSERT_STREQ("Test3", files["folder2/test3.txt"].c_str());
+
+	// Stored files are viewed in the archive without decoding
+	ASSERT_EQ(0, fs.getCacheStatistics().misses);
+
+	{
+		SevenZipFileSystem compressed(TEST_RESOURCE_DIR "/7z/lzma.7z");
+
+		std::vector<std::string> compressedPaths;
+		compressedPaths.push_back("lzma/small.txt");
+		compressedPaths.push_back("lzma2/small.txt");
+		compressedPaths.push_back("lzma/big.txt");
+		compressedPaths.push_back("lzma/after.txt");
+
+		std::map<std::string, std::string> compressedFiles;
+		compressed.extractFiles(compressedPaths, boost::bind(collectFile, &compressedFiles, &lock, _1, _2), 4);
+
+		ASSERT_EQ(4, compressedFiles.size());
+		ASSERT_EQ(168000, compressedFiles["lzma/big.txt"].size());
+		ASSERT_STREQ("After", compressedFiles["lzma/after.txt"].c_str());
+		ASSERT_STREQ("Test2", compressedFiles["lzma2/small.txt"].c_str());
+
+		// Every folder has been decoded once
+		FolderCacheStatistics stats = compressed.getCacheStatistics();
+		ASSERT_LT(0, stats.misses);
+		ASSERT_EQ(0, stats.hits);
+		ASSERT_EQ(stats.misses, stats.cachedFolders);
+	}
+
+	paths.push_back("unknown.txt");
+	ASSERT_THROW(fs.extractFiles(paths, boost::bind(collectFile, &files, &lock, _1, _2)), FileSystemException);
+
+	paths.pop_back();
+	ASSERT_THROW(fs.extractFiles(paths, failExtraction, 2), std::runtime_error);
+}
+
+TEST(SevenZipCrcTest, Implementations)
+{
+	CrcGenerateTable();
+	ECrcImpl defaultImpl = CrcGetImpl();
+
+	std::vector<unsigned char> data(4096 + 16);
+	UInt32 state = 1;
+	BOOST_FOREACH(unsigned char& c, data)
+	{
+		state = state * 1103515245 + 12345;
+		c = static_cast<unsigned char>(state >> 16);
+	}
+
+	ECrcImpl impls[] = { CRC_IMPL_TABLE, CRC_IMPL_CLMUL };
+	BOOST_FOREACH(ECrcImpl impl, impls)
+	{
+		if (!CrcSetImpl(impl))
+		{
+			// Not supported by this CPU
+			continue;
+		}
+
+		ASSERT_EQ(0xCBF43926, CrcCalc("123456789", 9));
+
+		// Every alignment and all remainders of the folded blocks
+		for (size_t offset = 0; offset < 16; ++offset)
+		{
+			for (size_t size = 0; size < 300; ++size)
+			{
+				ASSERT_EQ(bitwiseCrc(&data[offset], size), CrcCalc(&data[offset], size)) << impl << ": " << offset << ", " << size;
+			}
+		}
+
+		ASSERT_EQ(bitwiseCrc(&data[3], 4096), CrcCalc(&data[3], 4096));
+
+		// Updating in pieces gives the same result
+		UInt32 crc = CrcUpdate(CRC_INIT_VAL, &data[0], 1000);
+		crc = CrcUpdate(crc, &data[1000], 3000);
+		ASSERT_EQ(bitwiseCrc(&data[0], 4000), CRC_GET_DIGEST(crc));
+	}
+
+	ASSERT_TRUE(CrcSetImpl(defaultImpl));
+}
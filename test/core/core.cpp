@@ -1,6 +1,9 @@
 
 #include <VFSPP/util.hpp>
 
+#include <boost/functional/hash.hpp>
+#include <boost/lexical_cast.hpp>
+
 #include <gtest/gtest.h>
 
 using namespace vfspp::util;
@@ -22,3 +25,124 @@ TEST(UtilityTest, NormalizePath)
 	ASSERT_STREQ("test/test", normalizePath("///test/test").c_str());
 	ASSERT_STREQ("test/test", normalizePath("///test/test///").c_str());
 }
+
+TEST(UtilityTest, MatchPattern)
+{
+	ASSERT_TRUE(matchPattern("", ""));
+	ASSERT_TRUE(matchPattern("file.txt", "file.txt"));
+	ASSERT_FALSE(matchPattern("file.txt", "file.txt2"));
+	ASSERT_FALSE(matchPattern("file.txt", "dir/file.txt"));
+
+	ASSERT_TRUE(matchPattern("*.txt", "file.txt"));
+	ASSERT_TRUE(matchPattern("*.txt", ".txt"));
+	ASSERT_FALSE(matchPattern("*.txt", "dir/file.txt"));
+	ASSERT_TRUE(matchPattern("dir/*", "dir/file.txt"));
+	ASSERT_FALSE(matchPattern("dir/*", "dir/sub/file.txt"));
+	ASSERT_TRUE(matchPattern("*/*.txt", "dir/file.txt"));
+	ASSERT_TRUE(matchPattern("f*e*.t*", "file.txt"));
+
+	ASSERT_TRUE(matchPattern("file.???", "file.txt"));
+	ASSERT_FALSE(matchPattern("file.???", "file.tx"));
+	ASSERT_FALSE(matchPattern("dir?file", "dir/file"));
+
+	ASSERT_TRUE(matchPattern("**", "dir/sub/file.txt"));
+	ASSERT_TRUE(matchPattern("**.txt", "dir/sub/file.txt"));
+	ASSERT_TRUE(matchPattern("**/*.txt", "dir/sub/file.txt"));
+	ASSERT_TRUE(matchPattern("**/*.txt", "file.txt"));
+	ASSERT_TRUE(matchPattern("dir/**/file.txt", "dir/file.txt"));
+	ASSERT_TRUE(matchPattern("dir/**/file.txt", "dir/a/b/file.txt"));
+	ASSERT_FALSE(matchPattern("dir/**/file.txt", "other/file.txt"));
+	ASSERT_FALSE(matchPattern("**/*.txt", "dir/file.dat"));
+}
+
+TEST(UtilityTest, BloomFilter)
+{
+	BloomFilter filter(1000);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		filter.insert("dir/file" + boost::lexical_cast<std::string>(i));
+	}
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		ASSERT_TRUE(filter.mayContain("dir/file" + boost::lexical_cast<std::string>(i)));
+	}
+
+	int falsePositives = 0;
+	for (int i = 0; i < 10000; ++i)
+	{
+		if (filter.mayContain("other/file" + boost::lexical_cast<std::string>(i)))
+		{
+			++falsePositives;
+		}
+	}
+
+	ASSERT_LT(falsePositives, 300);
+}
+
+TEST(UtilityTest, NormalizedPath)
+{
+	std::string input = " /Dir/Sub/File.txt/ ";
+	vfspp::NormalizedPath path(input);
+
+	ASSERT_EQ("Dir/Sub/File.txt", path.toString());
+	ASSERT_EQ(normalizePath(input), path.toString());
+
+	// The path refers to the input
+	ASSERT_EQ(input.data() + 2, path.str().data());
+
+	ASSERT_EQ(boost::hash<std::string>()("Dir/Sub/File.txt"), path.hash());
+
+	ASSERT_EQ(3, path.numComponents());
+	ASSERT_EQ("Dir", path.component(0));
+	ASSERT_EQ("Sub", path.component(1));
+	ASSERT_EQ("File.txt", path.component(2));
+	ASSERT_EQ(boost::hash<std::string>()("File.txt"), path.componentKey(2).hash);
+
+	vfspp::NormalizedPath lower(input, true);
+	ASSERT_EQ("dir/sub/file.txt", lower.toString());
+	ASSERT_EQ(boost::hash<std::string>()("dir/sub/file.txt"), lower.hash());
+	ASSERT_EQ(boost::hash<std::string>()("sub"), lower.componentKey(1).hash);
+
+	ASSERT_TRUE(vfspp::NormalizedPath("//").empty());
+	ASSERT_EQ(0, vfspp::NormalizedPath("").numComponents());
+}
+
+TEST(UtilityTest, PathTable)
+{
+	vfspp::PathTable table;
+
+	ASSERT_EQ(1, table.size());
+	ASSERT_EQ(vfspp::PathTable::RootPath, table.find(""));
+
+	vfspp::PathTable::PathId file = table.intern("dir/sub/file.txt");
+	vfspp::PathTable::PathId other = table.intern("other/sub/file.txt");
+
+	// Both parents are added, the names "sub" and "file.txt" are only stored once
+	ASSERT_EQ(7, table.size());
+	ASSERT_EQ(5, table.numNames());
+
+	ASSERT_EQ(file, table.intern("dir/sub/file.txt"));
+	ASSERT_EQ(file, table.find("dir/sub/file.txt"));
+	ASSERT_EQ(other, table.find(vfspp::NormalizedPath("/other/sub/file.txt")));
+	ASSERT_EQ(vfspp::PathTable::InvalidPath, table.find("dir/file.txt"));
+	ASSERT_EQ(vfspp::PathTable::InvalidPath, table.find(vfspp::NormalizedPath("dir/unknown")));
+
+	vfspp::PathTable::PathId sub = table.getParent(file);
+	ASSERT_EQ("sub", table.getName(sub));
+	ASSERT_EQ(file, table.findChild(sub, "file.txt"));
+	ASSERT_EQ(vfspp::PathTable::RootPath, table.getParent(table.getParent(sub)));
+
+	ASSERT_EQ("dir/sub/file.txt", table.getPath(file));
+	ASSERT_EQ("other/sub", table.getPath(table.getParent(other)));
+	ASSERT_EQ("", table.getPath(vfspp::PathTable::RootPath));
+
+	// Enough paths to grow the hash tables a few times
+	for (int i = 0; i < 1000; ++i)
+	{
+		table.intern("many/" + boost::lexical_cast<std::string>(i));
+	}
+	ASSERT_EQ("many/999", table.getPath(table.find("many/999")));
+	ASSERT_EQ(file, table.find("dir/sub/file.txt"));
+}
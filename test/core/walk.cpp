@@ -0,0 +1,117 @@
+#include <VFSPP/system.hpp>
+#include <VFSPP/walk.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+
+#include "globals.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace vfspp;
+using namespace vfspp::system;
+using namespace vfspp::test;
+
+namespace
+{
+	std::vector<std::string> sortedPaths(const std::vector<FileEntryPointer>& entries)
+	{
+		std::vector<std::string> paths;
+
+		BOOST_FOREACH(const FileEntryPointer& entry, entries)
+		{
+			paths.push_back(entry->getPath());
+		}
+
+		std::sort(paths.begin(), paths.end());
+
+		return paths;
+	}
+
+	bool skipDirectory(const std::string& name, const FileEntryPointer& directory, int)
+	{
+		return directory->getPath() != name;
+	}
+
+	void failOnFile(const FileEntryPointer& entry, int)
+	{
+		if (entry->getType() == vfspp::FILE)
+		{
+			throw FileSystemException("Callback failed");
+		}
+	}
+}
+
+TEST(WalkTest, AllEntries)
+{
+	PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
+
+	std::vector<FileEntryPointer> entries;
+
+	WalkOptions options;
+	options.numThreads = 1;
+	walk(fs.getRootEntry(), entries, options);
+
+	std::vector<std::string> paths = sortedPaths(entries);
+
+	ASSERT_EQ(6, paths.size());
+	ASSERT_STREQ("test1", paths[0].c_str());
+	ASSERT_STREQ("test1.txt", paths[1].c_str());
+	ASSERT_STREQ("test1/test1.txt", paths[2].c_str());
+	ASSERT_STREQ("test4.txt", paths[5].c_str());
+
+	// More threads than directories still finds the same entries
+	std::vector<FileEntryPointer> parallelEntries;
+
+	options.numThreads = 8;
+	walk(fs.getRootEntry(), parallelEntries, options);
+
+	ASSERT_EQ(paths, sortedPaths(parallelEntries));
+}
+
+TEST(WalkTest, Pruning)
+{
+	PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
+
+	std::vector<FileEntryPointer> entries;
+
+	{
+		WalkOptions options;
+		options.maxDepth = 1;
+		walk(fs.getRootEntry(), entries, options);
+
+		ASSERT_EQ(5, entries.size());
+	}
+	{
+		WalkOptions options;
+		options.descend = boost::bind(skipDirectory, std::string("test1"), _1, _2);
+		walk(fs.getRootEntry(), entries, options);
+
+		// The directory itself is still reported
+		ASSERT_EQ(5, entries.size());
+		ASSERT_TRUE(vectorContainsEntry(entries, "test1", DIRECTORY));
+	}
+	{
+		WalkOptions options;
+		options.maxDepth = 0;
+		walk(fs.getRootEntry(), entries, options);
+
+		ASSERT_EQ(0, entries.size());
+	}
+}
+
+TEST(WalkTest, Exceptions)
+{
+	PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
+
+	WalkOptions options;
+	options.numThreads = 4;
+
+	ASSERT_THROW(walk(&fs, failOnFile, options), vfspp::FileSystemException);
+
+	// Walking a file fails when it is listed
+	PhysicalEntry file(&fs, "test1.txt");
+	ASSERT_THROW(walk(&file, WalkCallback(), options), vfspp::InvalidOperationException);
+}
@@ -3,18 +3,47 @@
 
 #include <VFSPP/memory.hpp>
 
+#include <boost/lexical_cast.hpp>
+
 #include "globals.hpp"
 
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
 using namespace vfspp;
 using namespace vfspp::memory;
 
 using namespace boost;
 
+namespace
+{
+	std::string readContent(IFileSystemEntry* entry, int mode = IFileSystemEntry::MODE_READ)
+	{
+		boost::shared_ptr<std::streambuf> buffer = entry->open(mode);
+		std::istream stream(buffer.get());
+
+		std::string content;
+		content.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+		return content;
+	}
+
+	void writeContent(IFileSystemEntry* entry, const std::string& content, int mode = IFileSystemEntry::MODE_WRITE)
+	{
+		boost::shared_ptr<std::streambuf> buffer = entry->open(mode);
+		std::ostream stream(buffer.get());
+
+		stream << content;
+		stream.flush();
+	}
+}
+
 TEST(MemoryTest, TestSupportedOperations)
 {
 	MemoryFileSystem fs;
 
-	ASSERT_EQ(OP_READ, fs.supportedOperations());
+	ASSERT_EQ(OP_READ | OP_WRITE | OP_CREATE | OP_DELETE, fs.supportedOperations());
 }
 
 TEST(MemoryTest, TestAddChild)
@@ -42,3 +71,618 @@ TEST(MemoryTest, TestAddChild)
 		ASSERT_STREQ("TestTestTest", content.c_str());
 	}
 }
+
+TEST(MemoryTest, TestNormalizedLookup)
+{
+	MemoryFileSystem fs;
+	MemoryFileEntry* rootEntry = fs.getRootEntry();
+
+	const char* testData = "TestTestTest";
+	shared_ptr<MemoryFileEntry> dir = rootEntry->addChild("Dir", vfspp::DIRECTORY);
+	shared_ptr<MemoryFileEntry> file = dir->addChild("Test", vfspp::FILE, 0,
+		reinterpret_cast<void*>(const_cast<char*>(testData)), strlen(testData));
+
+	FileEntryPointer child;
+
+	ASSERT_EQ(STATUS_OK, rootEntry->tryGetChild(NormalizedPath("/Dir/Test"), child));
+	ASSERT_EQ(file, child);
+
+	ASSERT_EQ(STATUS_OK, rootEntry->tryGetChild(NormalizedPath("Dir"), child));
+	ASSERT_EQ(dir, child);
+
+	ASSERT_EQ(STATUS_NOT_FOUND, rootEntry->tryGetChild(NormalizedPath("Dir/Foo"), child));
+	ASSERT_FALSE(child);
+
+	ASSERT_EQ(STATUS_NOT_FOUND, rootEntry->tryGetChild(NormalizedPath("Dir/Test/Foo"), child));
+
+	ASSERT_EQ(STATUS_NOT_DIRECTORY, file->tryGetChild(NormalizedPath("Foo"), child));
+}
+
+TEST(MemoryTest, TestReadAt)
+{
+	MemoryFileSystem fs;
+
+	const char* testData = "TestTestTest";
+	shared_ptr<MemoryFileEntry> newEntry = fs.getRootEntry()->addChild("Test", vfspp::FILE, 0,
+		reinterpret_cast<void*>(const_cast<char*>(testData)), strlen(testData));
+
+	char buffer[16] = {};
+
+	ASSERT_EQ(8, newEntry->readAt(4, buffer, sizeof(buffer)));
+	ASSERT_STREQ("TestTest", buffer);
+
+	ASSERT_EQ(0, newEntry->readAt(12, buffer, sizeof(buffer)));
+
+	ASSERT_THROW(fs.getRootEntry()->readAt(0, buffer, sizeof(buffer)), vfspp::InvalidOperationException);
+}
+
+TEST(MemoryTest, TestGetView)
+{
+	MemoryFileSystem fs;
+
+	const char* testData = "TestTestTest";
+	shared_ptr<MemoryFileEntry> newEntry = fs.getRootEntry()->addChild("Test", vfspp::FILE, 0,
+		reinterpret_cast<void*>(const_cast<char*>(testData)), strlen(testData));
+
+	FileView view;
+	ASSERT_TRUE(newEntry->getView(view));
+
+	ASSERT_EQ("TestTestTest", std::string(view.begin(), view.end()));
+
+	// The view shares the data of the entry
+	FileView second;
+	newEntry->getView(second);
+	ASSERT_EQ(view.data(), second.data());
+}
+
+TEST(MemoryTest, TestStat)
+{
+	MemoryFileSystem fs;
+
+	const char* testData = "TestTestTest";
+	shared_ptr<MemoryFileEntry> newEntry = fs.getRootEntry()->addChild("Test", vfspp::FILE, 1234,
+		reinterpret_cast<void*>(const_cast<char*>(testData)), strlen(testData));
+
+	EntryStat info = newEntry->stat();
+
+	ASSERT_EQ(vfspp::FILE, info.type);
+	ASSERT_EQ(12, info.size);
+	ASSERT_EQ(1234, info.writeTime);
+}
+
+TEST(MemoryTest, TestAdoptBuffers)
+{
+	shared_array<const char> array(strdup("Array"), free);
+
+	shared_ptr<std::string> owner(new std::string("OwnerOwner"));
+	weak_ptr<std::string> ownerAlive(owner);
+
+	std::vector<char> vector(3, 'v');
+	const char* vectorData = &vector[0];
+
+	FileView view;
+	{
+		MemoryFileSystem fs;
+		shared_ptr<MemoryFileEntry> dir = fs.getRootEntry()->addChild("Dir", vfspp::DIRECTORY);
+
+		shared_ptr<MemoryFileEntry> arrayEntry = dir->addChild("Array", array, 5, 1234);
+		ASSERT_STREQ("Dir/Array", arrayEntry->getPath().c_str());
+		ASSERT_EQ(1234, arrayEntry->lastWriteTime());
+
+		ASSERT_TRUE(arrayEntry->getView(view));
+		ASSERT_EQ(array.get(), view.data());
+
+		// Only the second half of the owned string is used
+		shared_ptr<MemoryFileEntry> ownerEntry = dir->addChild("Owner", owner, owner->data() + 5, 5);
+		owner.reset();
+
+		ASSERT_FALSE(ownerAlive.expired());
+		ASSERT_EQ(5, ownerEntry->stat().size);
+
+		char buffer[8] = {};
+		ASSERT_EQ(5, ownerEntry->readAt(0, buffer, sizeof(buffer)));
+		ASSERT_STREQ("Owner", buffer);
+
+		shared_ptr<MemoryFileEntry> vectorEntry = dir->addChild("Vector", std::move(vector));
+		ASSERT_TRUE(vector.empty());
+
+		FileView vectorView;
+		ASSERT_TRUE(fs.getRootEntry()->getChild("Dir/Vector")->getView(vectorView));
+		ASSERT_EQ(vectorData, vectorView.data());
+		ASSERT_EQ("vvv", std::string(vectorView.begin(), vectorView.end()));
+
+		std::vector<char> invalid(3, 'i');
+		ASSERT_THROW(dir->addChild("Foo/Bar", std::move(invalid)), vfspp::InvalidOperationException);
+		ASSERT_EQ(3, invalid.size());
+	}
+
+	// The owner is released with the filesystem, views keep their buffer alive
+	ASSERT_TRUE(ownerAlive.expired());
+	ASSERT_EQ("Array", std::string(view.begin(), view.end()));
+}
+
+TEST(MemoryTest, TestWrite)
+{
+	MemoryFileSystem fs;
+	MemoryFileEntry* rootEntry = fs.getRootEntry();
+
+	FileEntryPointer file = rootEntry->createEntry(vfspp::FILE, "Dir/Sub/Test.txt");
+	ASSERT_STREQ("Dir/Sub/Test.txt", file->getPath().c_str());
+	ASSERT_EQ(vfspp::DIRECTORY, rootEntry->getChild("Dir/Sub")->getType());
+	ASSERT_EQ(0, file->stat().size);
+
+	// Creating an existing entry returns it
+	ASSERT_EQ(file, rootEntry->createEntry(vfspp::FILE, "Dir/Sub/Test.txt"));
+	ASSERT_THROW(rootEntry->createEntry(vfspp::DIRECTORY, "Dir/Sub/Test.txt"), vfspp::InvalidOperationException);
+	ASSERT_THROW(rootEntry->createEntry(vfspp::FILE, "Dir/Sub"), vfspp::InvalidOperationException);
+
+	writeContent(file.get(), "TestTestTest");
+	ASSERT_EQ("TestTestTest", readContent(file.get()));
+	ASSERT_NE(0, file->lastWriteTime());
+
+	// Writing without reading truncates the file
+	writeContent(file.get(), "Test");
+	ASSERT_EQ("Test", readContent(file.get()));
+
+	// Reading and writing keeps the contents
+	{
+		boost::shared_ptr<std::streambuf> buffer = file->open(IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_WRITE);
+
+		buffer->pubseekoff(0, std::ios_base::end);
+		buffer->sputn("Appended", 8);
+
+		buffer->pubseekpos(2);
+		ASSERT_EQ('s', buffer->sgetc());
+		buffer->sputc('S');
+	}
+	ASSERT_EQ("TeStAppended", readContent(file.get()));
+
+	// Seeking past the end fills the gap with zeros
+	{
+		boost::shared_ptr<std::streambuf> buffer = file->open(IFileSystemEntry::MODE_WRITE);
+
+		buffer->pubseekpos(3);
+		buffer->sputc('x');
+	}
+	ASSERT_EQ(std::string("\0\0\0x", 4), readContent(file.get()));
+
+	// Streams of read only modes can't write
+	boost::shared_ptr<std::streambuf> readBuffer = file->open(IFileSystemEntry::MODE_READ);
+	ASSERT_EQ(std::char_traits<char>::eof(), readBuffer->sputc('y'));
+}
+
+TEST(MemoryTest, TestWriteChunks)
+{
+	MemoryFileSystem fs;
+
+	// Spans several chunks and doesn't end at a chunk boundary
+	std::string content;
+	for (int i = 0; i < 300000; ++i)
+	{
+		content.push_back(static_cast<char>('a' + i % 23));
+	}
+
+	FileEntryPointer file = fs.getRootEntry()->createEntry(vfspp::FILE, "Big");
+	{
+		boost::shared_ptr<std::streambuf> buffer = file->open(IFileSystemEntry::MODE_WRITE);
+
+		// Appending in pieces of different sizes
+		size_t offset = 0;
+		for (size_t piece = 1; offset < content.size(); piece = piece * 3 + 1)
+		{
+			size_t length = std::min(piece, content.size() - offset);
+			ASSERT_EQ(static_cast<std::streamsize>(length), buffer->sputn(content.data() + offset, length));
+			offset += length;
+		}
+	}
+
+	ASSERT_EQ(content.size(), file->stat().size);
+	ASSERT_EQ(content, readContent(file.get()));
+
+	std::vector<char> buffer(100000);
+	ASSERT_EQ(buffer.size(), file->readAt(65000, &buffer[0], buffer.size()));
+	ASSERT_EQ(content.substr(65000, buffer.size()), std::string(buffer.begin(), buffer.end()));
+
+	// Views are copies which don't change when the file is written again
+	FileView view;
+	ASSERT_TRUE(file->getView(view));
+	ASSERT_EQ(content, std::string(view.begin(), view.end()));
+
+	writeContent(file.get(), "Small");
+	ASSERT_EQ(content, std::string(view.begin(), view.end()));
+	ASSERT_EQ("Small", readContent(file.get()));
+}
+
+TEST(MemoryTest, TestWriteAddedBuffer)
+{
+	MemoryFileSystem fs;
+
+	// The buffer of added files is copied before it is written
+	shared_array<char> data(new char[4]);
+	memcpy(data.get(), "Test", 4);
+
+	shared_ptr<MemoryFileEntry> file = fs.getRootEntry()->addChild("Test", shared_array<const char>(data), 4);
+
+	writeContent(file.get(), "!", IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_WRITE);
+
+	ASSERT_EQ("!est", readContent(file.get()));
+	ASSERT_EQ("Test", std::string(data.get(), 4));
+}
+
+TEST(MemoryTest, TestStreamsSurviveLayoutChanges)
+{
+	MemoryFileSystem fs;
+
+	std::string content(100, 'a');
+	shared_ptr<MemoryFileEntry> file = fs.getRootEntry()->addChild("Test", vfspp::FILE, 0, &content[0], content.size());
+
+	// Writing copies the added buffer into chunks while the reader still uses it
+	shared_ptr<std::streambuf> reader = file->open(IFileSystemEntry::MODE_READ);
+	ASSERT_EQ('a', reader->sbumpc());
+
+	{
+		shared_ptr<std::streambuf> writer = file->open(IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_WRITE);
+		ASSERT_EQ('b', writer->sputc('b'));
+	}
+
+	char buffer[99];
+	ASSERT_EQ(99, reader->sgetn(buffer, sizeof(buffer)));
+	ASSERT_EQ(std::string(99, 'a'), std::string(buffer, sizeof(buffer)));
+	ASSERT_EQ("b" + std::string(99, 'a'), readContent(file.get()));
+
+	// Bytes written into a chunk which another stream replaced still end up in the file
+	shared_ptr<std::streambuf> first = file->open(IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_WRITE);
+	first->pubseekpos(50);
+	first->sputc('c');
+
+	{
+		shared_ptr<std::streambuf> second = file->open(IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_WRITE);
+		second->pubseekpos(100);
+
+		std::string grow(2000, 'd');
+		second->sputn(grow.data(), grow.size());
+	}
+
+	first->sputc('c');
+	first->pubsync();
+
+	std::string written = readContent(file.get());
+	ASSERT_EQ(2100, written.size());
+	ASSERT_EQ("cc", written.substr(50, 2));
+	ASSERT_EQ(std::string(2000, 'd'), written.substr(100));
+
+	// And in a file which has been truncated meanwhile
+	first->sputc('e');
+	file->open(IFileSystemEntry::MODE_WRITE);
+	first->pubsync();
+
+	written = readContent(file.get());
+	ASSERT_EQ(53, written.size());
+	ASSERT_EQ(std::string(52, '\0') + "e", written);
+}
+
+TEST(MemoryTest, TestDuplicateName)
+{
+	MemoryFileSystem fs;
+	MemoryFileEntry* rootEntry = fs.getRootEntry();
+
+	shared_ptr<MemoryFileEntry> first = rootEntry->addChild("Name", vfspp::FILE, 0, const_cast<char*>("1"), 1);
+	rootEntry->addChild("Other", vfspp::DIRECTORY);
+
+	ASSERT_THROW(rootEntry->addChild("Name", vfspp::DIRECTORY), FileSystemException);
+	ASSERT_THROW(rootEntry->addChild(" Name ", vfspp::FILE, 0, const_cast<char*>("2"), 1), FileSystemException);
+
+	std::vector<char> data(1, '3');
+	ASSERT_THROW(rootEntry->addChild("Name", std::move(data)), FileSystemException);
+	ASSERT_EQ(1, data.size());
+
+	ASSERT_EQ(2, rootEntry->numChildren());
+	ASSERT_EQ(first, rootEntry->getChild("Name"));
+
+	// Removing a child moves the last one into its slot, the mapping has to stay consistent
+	ASSERT_TRUE(rootEntry->deleteChild("Name"));
+	ASSERT_TRUE(rootEntry->getChild("Other") != NULL);
+	ASSERT_TRUE(rootEntry->getChild("Name") == NULL);
+}
+
+TEST(MemoryTest, TestDeleteChild)
+{
+	MemoryFileSystem fs;
+	MemoryFileEntry* rootEntry = fs.getRootEntry();
+
+	FileEntryPointer file = rootEntry->createEntry(vfspp::FILE, "Dir/Test1.txt");
+	rootEntry->createEntry(vfspp::FILE, "Dir/Test2.txt");
+	rootEntry->createEntry(vfspp::FILE, "Dir/Test3.txt");
+	writeContent(file.get(), "Test");
+
+	boost::shared_ptr<std::streambuf> buffer = file->open();
+
+	ASSERT_TRUE(rootEntry->deleteChild("Dir/Test1.txt"));
+	ASSERT_FALSE(rootEntry->deleteChild("Dir/Test1.txt"));
+	ASSERT_FALSE(rootEntry->deleteChild("Foo/Test1.txt"));
+
+	FileEntryPointer child;
+	ASSERT_EQ(STATUS_NOT_FOUND, rootEntry->tryGetChild("Dir/Test1.txt", child));
+
+	// The remaining children can still be found
+	ASSERT_EQ(2, rootEntry->getChild("Dir")->numChildren());
+	ASSERT_EQ("Dir/Test2.txt", rootEntry->getChild("Dir/Test2.txt")->getPath());
+	ASSERT_EQ("Dir/Test3.txt", rootEntry->getChild("Dir/Test3.txt")->getPath());
+
+	// Open streams keep the contents
+	std::istream stream(buffer.get());
+	std::string content;
+	stream >> content;
+	ASSERT_EQ("Test", content);
+
+	ASSERT_TRUE(rootEntry->deleteChild("Dir"));
+	ASSERT_EQ(0, rootEntry->numChildren());
+
+	ASSERT_THROW(file->rename("Test.txt"), vfspp::InvalidOperationException);
+	ASSERT_THROW(file->deleteChild("Test.txt"), vfspp::InvalidOperationException);
+}
+
+TEST(MemoryTest, TestRename)
+{
+	MemoryFileSystem fs;
+	MemoryFileEntry* rootEntry = fs.getRootEntry();
+
+	FileEntryPointer file = rootEntry->createEntry(vfspp::FILE, "Dir/Sub/Test.txt");
+	writeContent(file.get(), "Test");
+
+	FileEntryPointer dir = rootEntry->getChild("Dir");
+	rootEntry->createEntry(vfspp::DIRECTORY, "Other");
+
+	dir->rename("Other/Moved");
+
+	ASSERT_STREQ("Other/Moved", dir->getPath().c_str());
+	ASSERT_STREQ("Other/Moved/Sub/Test.txt", file->getPath().c_str());
+	ASSERT_EQ(file, rootEntry->getChild("Other/Moved/Sub/Test.txt"));
+	ASSERT_EQ("Test", readContent(rootEntry->getChild("Other/Moved/Sub/Test.txt").get()));
+
+	FileEntryPointer child;
+	ASSERT_EQ(STATUS_NOT_FOUND, rootEntry->tryGetChild("Dir", child));
+
+	file->rename("Test.txt");
+	ASSERT_EQ(file, rootEntry->getChild("Test.txt"));
+	ASSERT_EQ(0, rootEntry->getChild("Other/Moved/Sub")->numChildren());
+
+	ASSERT_THROW(file->rename("Other"), vfspp::FileSystemException);
+	ASSERT_THROW(file->rename("Missing/Test.txt"), vfspp::FileSystemException);
+	ASSERT_THROW(dir->rename("Other/Moved/Sub/Dir"), vfspp::InvalidOperationException);
+	ASSERT_THROW(rootEntry->rename("Root"), vfspp::InvalidOperationException);
+}
+
+TEST(MemoryTest, TestArena)
+{
+	FileView view;
+	{
+		MemoryFileSystem fs(true);
+		MemoryFileEntry* rootEntry = fs.getRootEntry();
+
+		ASSERT_TRUE(fs.getArena() != NULL);
+		ASSERT_TRUE(MemoryFileSystem().getArena() == NULL);
+
+		shared_ptr<MemoryFileEntry> dir = rootEntry->addChild("Dir", vfspp::DIRECTORY);
+		for (int i = 0; i < 1000; ++i)
+		{
+			std::string content = boost::lexical_cast<std::string>(i);
+			dir->addChild(content + ".txt", vfspp::FILE, i, const_cast<char*>(content.data()), content.size());
+		}
+
+		// Big files are not copied into the arena
+		std::string big(MemoryFileSystem::MaxArenaFileSize + 1, 'x');
+		size_t arenaSize = fs.getArena()->size();
+		rootEntry->addChild("Big", vfspp::FILE, 0, &big[0], big.size());
+
+		ASSERT_LT(0, arenaSize);
+		ASSERT_EQ(arenaSize, fs.getArena()->size());
+
+		ASSERT_EQ(1000, dir->numChildren());
+		ASSERT_EQ("123", readContent(rootEntry->getChild("Dir/123.txt").get()));
+		ASSERT_EQ(999, rootEntry->getChild("Dir/999.txt")->lastWriteTime());
+
+		FileEntryPointer child;
+		ASSERT_EQ(STATUS_OK, rootEntry->tryGetChild(NormalizedPath("Dir/500.txt"), child));
+		ASSERT_TRUE(child->getView(view));
+
+		// Changing the tree works as without an arena
+		FileEntryPointer file = rootEntry->createEntry(vfspp::FILE, "New/File.txt");
+		writeContent(file.get(), "Written");
+		file->rename("Dir/File.txt");
+
+		ASSERT_EQ("Written", readContent(rootEntry->getChild("Dir/File.txt").get()));
+		ASSERT_TRUE(rootEntry->deleteChild("Dir/0.txt"));
+		ASSERT_EQ(1000, dir->numChildren());
+	}
+
+	// Views keep the slab of their file alive
+	ASSERT_EQ("500", std::string(view.begin(), view.end()));
+}
+
+TEST(MemoryTest, TestFreeze)
+{
+	for (int useArena = 0; useArena < 2; ++useArena)
+	{
+		MemoryFileSystem fs(useArena != 0);
+		MemoryFileEntry* rootEntry = fs.getRootEntry();
+
+		shared_ptr<MemoryFileEntry> dir = rootEntry->addChild("Dir", vfspp::DIRECTORY, 5);
+		for (int i = 0; i < 1000; ++i)
+		{
+			std::string content = boost::lexical_cast<std::string>(i);
+			shared_ptr<MemoryFileEntry> subdir = dir->addChild("Sub" + content, vfspp::DIRECTORY);
+			subdir->addChild(content + ".txt", vfspp::FILE, i, const_cast<char*>(content.data()), content.size());
+		}
+		rootEntry->addChild("File.txt", vfspp::FILE, 0, const_cast<char*>("Root"), 4);
+		rootEntry->addChild("Empty", vfspp::DIRECTORY);
+
+		ASSERT_FALSE(fs.isFrozen());
+		fs.freeze();
+		ASSERT_TRUE(fs.isFrozen());
+
+		// Freezing twice does nothing
+		fs.freeze();
+
+		ASSERT_EQ(vfspp::OP_READ, fs.supportedOperations());
+
+		ASSERT_EQ(3, rootEntry->numChildren());
+		ASSERT_EQ(1000, dir->numChildren());
+		ASSERT_EQ(0, rootEntry->getChild("Empty")->numChildren());
+		ASSERT_EQ(5, dir->lastWriteTime());
+
+		std::vector<FileEntryPointer> children;
+		dir->listChildren(children);
+		ASSERT_EQ(1000, children.size());
+		ASSERT_EQ("Dir/Sub0", children[0]->getPath());
+		ASSERT_EQ(1, children[0]->numChildren());
+
+		for (int i = 0; i < 1000; ++i)
+		{
+			std::string content = boost::lexical_cast<std::string>(i);
+			std::string path = "Dir/Sub" + content + "/" + content + ".txt";
+
+			FileEntryPointer child;
+			ASSERT_EQ(STATUS_OK, rootEntry->tryGetChild(NormalizedPath(path), child));
+			ASSERT_EQ(path, child->getPath());
+			ASSERT_EQ(content, readContent(child.get()));
+			ASSERT_EQ(i, child->lastWriteTime());
+
+			ASSERT_EQ(child, rootEntry->getChild(path));
+		}
+
+		// Lookups relative to other directories
+		ASSERT_EQ("Dir/Sub7/7.txt", dir->getChild("Sub7/7.txt")->getPath());
+		ASSERT_EQ("Dir/Sub7/7.txt", dir->getChild("Sub7")->getChild("/7.txt/")->getPath());
+
+		FileEntryPointer child;
+		ASSERT_EQ(STATUS_OK, dir->tryGetChild(NormalizedPath("Sub8/8.txt"), child));
+		ASSERT_EQ("8", readContent(child.get()));
+
+		ASSERT_EQ(STATUS_NOT_FOUND, rootEntry->tryGetChild("Dir/Sub1000", child));
+		ASSERT_EQ(STATUS_NOT_FOUND, rootEntry->tryGetChild(NormalizedPath("Sub7/7.txt"), child));
+		ASSERT_EQ(STATUS_NOT_FOUND, dir->tryGetChild("Dir", child));
+		ASSERT_EQ(STATUS_NOT_FOUND, rootEntry->tryGetChild("", child));
+		ASSERT_EQ(STATUS_NOT_DIRECTORY, rootEntry->getChild("File.txt")->tryGetChild("Dir", child));
+		ASSERT_EQ("Root", readContent(rootEntry->getChild("File.txt").get()));
+
+		// The tree can't be changed anymore
+		ASSERT_THROW(rootEntry->addChild("New", vfspp::DIRECTORY), InvalidOperationException);
+		ASSERT_THROW(rootEntry->createEntry(vfspp::FILE, "File.txt"), InvalidOperationException);
+		ASSERT_THROW(rootEntry->deleteChild("File.txt"), InvalidOperationException);
+		ASSERT_THROW(dir->rename("Moved"), InvalidOperationException);
+
+		std::vector<char> data(4, 'x');
+		ASSERT_THROW(rootEntry->addChild("Adopted", std::move(data)), InvalidOperationException);
+		ASSERT_EQ(4, data.size());
+
+		shared_ptr<std::streambuf> buffer;
+		ASSERT_EQ(STATUS_NOT_SUPPORTED, rootEntry->getChild("File.txt")->tryOpen(IFileSystemEntry::MODE_WRITE, buffer));
+		ASSERT_EQ(STATUS_OK, rootEntry->getChild("File.txt")->tryOpen(IFileSystemEntry::MODE_READ, buffer));
+	}
+
+	// An empty filesystem can be frozen as well
+	MemoryFileSystem fs;
+	fs.freeze();
+
+	FileEntryPointer child;
+	ASSERT_EQ(STATUS_NOT_FOUND, fs.getRootEntry()->tryGetChild(NormalizedPath("File"), child));
+	ASSERT_EQ(0, fs.getRootEntry()->numChildren());
+}
+
+TEST(MemoryTest, TestPreload)
+{
+	MemoryFileSystem source;
+	{
+		MemoryFileEntry* root = source.getRootEntry();
+
+		shared_ptr<MemoryFileEntry> dir = root->addChild("Dir", vfspp::DIRECTORY, 10);
+		dir->addChild("A.txt", vfspp::FILE, 1, const_cast<char*>("aaaa"), 4);
+
+		shared_ptr<MemoryFileEntry> sub = dir->addChild("Sub", vfspp::DIRECTORY, 11);
+		sub->addChild("B.txt", vfspp::FILE, 2, const_cast<char*>("bb"), 2);
+		sub->addChild("C.dat", vfspp::FILE, 3, const_cast<char*>("cccccc"), 6);
+
+		root->addChild("Skip", vfspp::DIRECTORY, 12)->addChild("D.txt", vfspp::FILE, 4, const_cast<char*>("ddd"), 3);
+		root->addChild("E.txt", vfspp::FILE, 5, const_cast<char*>("e"), 1);
+		root->addChild("Empty", vfspp::DIRECTORY, 13);
+	}
+
+	PreloadOptions options;
+	options.numThreads = 4;
+
+	{
+		MemoryFileSystem target;
+		PreloadResult result = preload(&source, &target, options);
+
+		ASSERT_EQ(4, result.numDirectories);
+		ASSERT_EQ(5, result.numFiles);
+		ASSERT_EQ(16, result.numBytes);
+		ASSERT_EQ(0, result.numSkipped);
+
+		MemoryFileEntry* root = target.getRootEntry();
+		ASSERT_EQ("aaaa", readContent(root->getChild("Dir/A.txt").get()));
+		ASSERT_EQ("cccccc", readContent(root->getChild("Dir/Sub/C.dat").get()));
+		ASSERT_EQ("ddd", readContent(root->getChild("Skip/D.txt").get()));
+
+		ASSERT_EQ(1, root->getChild("Dir/A.txt")->lastWriteTime());
+		ASSERT_EQ(3, root->getChild("Dir/Sub/C.dat")->lastWriteTime());
+		ASSERT_EQ(10, root->getChild("Dir")->lastWriteTime());
+		ASSERT_EQ(11, root->getChild("Dir/Sub")->lastWriteTime());
+		ASSERT_EQ(0, root->getChild("Empty")->numChildren());
+
+		// Files which exist already aren't replaced
+		ASSERT_THROW(preload(&source, &target, options), FileSystemException);
+	}
+
+	// Patterns
+	{
+		PreloadOptions filtered(options);
+		filtered.include.push_back("**/*.txt");
+		filtered.exclude.push_back("Skip");
+
+		MemoryFileSystem target;
+		PreloadResult result = preload(&source, &target, filtered);
+
+		ASSERT_EQ(3, result.numFiles);
+
+		FileEntryPointer child;
+		ASSERT_EQ(STATUS_OK, target.getRootEntry()->tryGetChild("Dir/Sub/B.txt", child));
+		ASSERT_EQ(STATUS_OK, target.getRootEntry()->tryGetChild("E.txt", child));
+		ASSERT_EQ(STATUS_NOT_FOUND, target.getRootEntry()->tryGetChild("Dir/Sub/C.dat", child));
+		ASSERT_EQ(STATUS_NOT_FOUND, target.getRootEntry()->tryGetChild("Skip", child));
+	}
+
+	// The budget is filled in the order of the paths
+	{
+		PreloadOptions limited(options);
+		limited.maxBytes = 5;
+
+		MemoryFileSystem target;
+		PreloadResult result = preload(&source, &target, limited);
+
+		ASSERT_EQ(2, result.numFiles);
+		ASSERT_EQ(5, result.numBytes);
+		ASSERT_EQ(3, result.numSkipped);
+
+		FileEntryPointer child;
+		ASSERT_EQ(STATUS_OK, target.getRootEntry()->tryGetChild("Dir/A.txt", child));
+		ASSERT_EQ(STATUS_OK, target.getRootEntry()->tryGetChild("E.txt", child));
+		ASSERT_EQ(STATUS_NOT_FOUND, target.getRootEntry()->tryGetChild("Dir/Sub/B.txt", child));
+	}
+
+	// From a subdirectory into a subdirectory
+	{
+		MemoryFileSystem target;
+		shared_ptr<MemoryFileEntry> cache = target.getRootEntry()->addChild("Cache", vfspp::DIRECTORY);
+
+		PreloadResult result = preload(source.getRootEntry()->getChild("Dir").get(), cache.get(), options);
+
+		ASSERT_EQ(1, result.numDirectories);
+		ASSERT_EQ(3, result.numFiles);
+		ASSERT_EQ("bb", readContent(target.getRootEntry()->getChild("Cache/Sub/B.txt").get()));
+	}
+
+	MemoryFileSystem target;
+	ASSERT_THROW(preload(source.getRootEntry()->getChild("E.txt").get(), target.getRootEntry(), options), InvalidOperationException);
+}
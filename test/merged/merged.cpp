@@ -2,10 +2,14 @@
 #include <VFSPP/merged.hpp>
 #include <VFSPP/system.hpp>
 #include <VFSPP/7zip.hpp>
+#include <VFSPP/walk.hpp>
 
 #include <globals.hpp>
 
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "gtest/gtest.h"
 
@@ -48,6 +52,27 @@ namespace
 		}
 	}
 
+	void lookupRepeatedly(MergedEntry* root, boost::atomic<bool>* running, boost::atomic<int>* failures)
+	{
+		while (running->load())
+		{
+			try
+			{
+				std::vector<FileEntryPointer> children;
+				root->listChildren(children);
+
+				if (children.size() < 8 || !root->getChild("test1/test1.txt"))
+				{
+					++*failures;
+				}
+			}
+			catch (...)
+			{
+				++*failures;
+			}
+		}
+	}
+
 	class MergedEntryTest : public ::testing::Test
 	{
 	public:
@@ -117,3 +142,199 @@ TEST_F(MergedEntryTest, OpenRead)
 	ASSERT_STREQ("TestTestTest", content.c_str());
 }
 
+
+TEST_F(MergedEntryTest, TryOpen)
+{
+	MergedEntry* root = fileSystem.getRootEntry();
+
+	FileEntryPointer child;
+	ASSERT_EQ(STATUS_NOT_FOUND, root->tryGetChild("foo.txt", child));
+	ASSERT_EQ(STATUS_OK, root->tryGetChild("test1.txt", child));
+
+	shared_ptr<std::streambuf> buffer;
+	ASSERT_EQ(STATUS_NOT_FILE, root->tryOpen(IFileSystemEntry::MODE_READ, buffer));
+	ASSERT_EQ(STATUS_OK, child->tryOpen(IFileSystemEntry::MODE_READ, buffer));
+
+	std::istream stream(buffer.get());
+
+	std::string content;
+	content.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+	ASSERT_STREQ("TestTestTest", content.c_str());
+}
+
+TEST_F(MergedEntryTest, NormalizedLookup)
+{
+	MergedEntry* root = fileSystem.getRootEntry();
+
+	FileEntryPointer child;
+	ASSERT_EQ(STATUS_OK, root->tryGetChild(NormalizedPath("test1/test1.txt"), child));
+	ASSERT_STREQ("test1/test1.txt", child->getPath().c_str());
+	ASSERT_EQ(child, root->getChild("test1/test1.txt"));
+
+	ASSERT_EQ(STATUS_NOT_FOUND, root->tryGetChild(NormalizedPath("test1/foo.txt"), child));
+	ASSERT_EQ(STATUS_NOT_FOUND, root->tryGetChild(NormalizedPath("test1.txt/foo.txt"), child));
+}
+
+TEST_F(MergedEntryTest, ReadAt)
+{
+	char buffer[16] = {};
+
+	ASSERT_EQ(8, fileSystem.getRootEntry()->getChild("test1.txt")->readAt(4, buffer, sizeof(buffer)));
+	ASSERT_STREQ("TestTest", buffer);
+}
+
+TEST(MergedFileSystemTest, ReadAtFallback)
+{
+	PhysicalFileSystem* hiddenSystem = new PhysicalFileSystem(TEST_RESOURCE_DIR "/system");
+
+	MergedFileSystem fileSystem;
+	fileSystem.addFileSystem(hiddenSystem);
+	fileSystem.addFileSystem(new PhysicalFileSystem(TEST_RESOURCE_DIR "/system"));
+
+	FileEntryPointer file = fileSystem.getRootEntry()->getChild("test1.txt");
+
+	// The entry was found in the first filesystem, reads have to use the second one now
+	hiddenSystem->setAllowedOperations(OP_WRITE);
+
+	char buffer[16] = {};
+
+	ASSERT_EQ(8, file->readAt(4, buffer, sizeof(buffer)));
+	ASSERT_STREQ("TestTest", buffer);
+
+	shared_ptr<std::streambuf> stream;
+	ASSERT_EQ(STATUS_OK, file->tryOpen(IFileSystemEntry::MODE_READ, stream));
+	ASSERT_TRUE(stream != NULL);
+
+	FileView view;
+	ASSERT_TRUE(file->getView(view));
+	ASSERT_EQ(12, view.size());
+}
+
+TEST_F(MergedEntryTest, GetView)
+{
+	FileView view;
+
+	ASSERT_TRUE(fileSystem.getRootEntry()->getChild("test1.txt")->getView(view));
+	ASSERT_EQ("TestTestTest", std::string(view.begin(), view.end()));
+}
+
+TEST_F(MergedEntryTest, Stat)
+{
+	EntryStat info = fileSystem.getRootEntry()->getChild("test1.txt")->stat();
+
+	ASSERT_EQ(vfspp::FILE, info.type);
+	ASSERT_EQ(12, info.size);
+
+	ASSERT_EQ(vfspp::DIRECTORY, fileSystem.getRootEntry()->stat().type);
+}
+
+TEST_F(MergedEntryTest, FlatIndex)
+{
+	fileSystem.setFlatIndexEnabled(true);
+	fileSystem.populateEntries(3);
+
+	MergedEntry* root = fileSystem.getRootEntry();
+
+	{
+		FileEntryPointer child = root->getChild("test1/test1.txt");
+
+		ASSERT_TRUE(child.get() != NULL);
+		ASSERT_STREQ("test1/test1.txt", child->getPath().c_str());
+
+		// The same entry is found relative to its directory
+		ASSERT_EQ(child, root->getChild("test1")->getChild("test1.txt"));
+
+		ASSERT_FALSE(root->getChild("test1/foo.txt"));
+	}
+	{
+		FileEntryPointer created = root->createEntry(vfspp::FILE, "flat.txt");
+
+		ASSERT_EQ(created, root->getChild("flat.txt"));
+
+		created->rename("flat2.txt");
+
+		ASSERT_FALSE(root->getChild("flat.txt"));
+		ASSERT_TRUE(root->getChild("flat2.txt").get() != NULL);
+
+		ASSERT_TRUE(root->deleteChild("flat2.txt"));
+
+		ASSERT_FALSE(root->getChild("flat2.txt"));
+	}
+}
+
+TEST_F(MergedEntryTest, RenameIntoCachedDirectory)
+{
+	MergedEntry* root = fileSystem.getRootEntry();
+
+	FileEntryPointer source = root->createEntry(vfspp::DIRECTORY, "renameSource");
+	FileEntryPointer target = root->createEntry(vfspp::DIRECTORY, "renameTarget");
+
+	FileEntryPointer created = source->createEntry(vfspp::FILE, "renamed.txt");
+
+	ASSERT_EQ(0, target->numChildren());
+
+	created->rename("renameTarget/renamed.txt");
+
+	// Both directories have cached their children already
+	ASSERT_EQ(0, source->numChildren());
+	ASSERT_EQ(1, target->numChildren());
+
+	ASSERT_TRUE(target->deleteChild("renamed.txt"));
+	ASSERT_TRUE(root->deleteChild("renameSource"));
+	ASSERT_TRUE(root->deleteChild("renameTarget"));
+}
+
+TEST_F(MergedEntryTest, ConcurrentLookups)
+{
+	MergedEntry* root = fileSystem.getRootEntry();
+
+	boost::atomic<bool> running(true);
+	boost::atomic<int> failures(0);
+
+	boost::thread_group readers;
+	for (int i = 0; i < 4; ++i)
+	{
+		readers.create_thread(boost::bind(&lookupRepeatedly, root, &running, &failures));
+	}
+
+	// Readers have to see either the old or the new children while they are replaced
+	for (int i = 0; i < 50; ++i)
+	{
+		EXPECT_TRUE(root->createEntry(vfspp::FILE, "concurrent.txt").get() != NULL);
+		EXPECT_EQ(9, root->numChildren());
+
+		EXPECT_TRUE(root->deleteChild("concurrent.txt"));
+		EXPECT_EQ(8, root->numChildren());
+	}
+
+	running = false;
+	readers.join_all();
+
+	ASSERT_EQ(0, failures.load());
+}
+
+TEST_F(MergedEntryTest, LayerFilters)
+{
+	fileSystem.buildLayerFilters();
+
+	MergedEntry* root = fileSystem.getRootEntry();
+
+	// Everything is still found through the filtered layers
+	std::vector<FileEntryPointer> entries;
+	walk(root, entries);
+
+	BOOST_FOREACH(const FileEntryPointer& entry, entries)
+	{
+		ASSERT_TRUE(root->getChild(entry->getPath()).get() != NULL);
+	}
+
+	{
+		char buffer[16] = {};
+
+		ASSERT_EQ(8, root->getChild("test1.txt")->readAt(4, buffer, sizeof(buffer)));
+		ASSERT_STREQ("TestTest", buffer);
+	}
+
+	ASSERT_FALSE(root->getChild("test1/foo.txt"));
+}
@@ -87,6 +87,13 @@ TEST(PhysicalEntryTest, GetChild)
 
 		ASSERT_FALSE(child);
 	}
+	{
+		// Paths of children are relative to the entry they were requested from
+		shared_ptr<IFileSystemEntry> child = fs.getRootEntry()->getChild("test1")->getChild("test1.txt");
+
+		ASSERT_STREQ("test1/test1.txt", child->getPath().c_str());
+		ASSERT_EQ(vfspp::FILE, child->getType());
+	}
 	{
 		PhysicalEntry entry(&fs, "test1.txt");
 
@@ -94,6 +101,39 @@ TEST(PhysicalEntryTest, GetChild)
 	}
 }
 
+TEST(PhysicalEntryTest, CachedType)
+{
+	using namespace boost::filesystem;
+
+	path testPath = path(TEST_WRITE_DIR "/system/cached");
+	path testFile = testPath / "test1.txt";
+
+	create_directories(testPath);
+
+	boost::filesystem::ofstream out(testFile);
+	out << "Test" << std::endl;
+	out.close();
+
+	PhysicalFileSystem fs(TEST_WRITE_DIR "/system");
+
+	std::vector<shared_ptr<IFileSystemEntry> > children;
+	fs.getRootEntry()->getChild("cached")->listChildren(children);
+
+	ASSERT_EQ(1, children.size());
+
+	shared_ptr<PhysicalEntry> entry = static_pointer_cast<PhysicalEntry>(children[0]);
+	ASSERT_EQ(vfspp::FILE, entry->getType());
+
+	remove_all(testPath);
+
+	// The type is served from the directory listing until the entry is refreshed
+	ASSERT_EQ(vfspp::FILE, entry->getType());
+
+	entry->refresh();
+
+	ASSERT_EQ(vfspp::UNKNOWN, entry->getType());
+}
+
 TEST(PhysicalEntryTest, DirectoryGetType)
 {
 	PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
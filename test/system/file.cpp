@@ -3,6 +3,10 @@
 
 #include <boost/filesystem/fstream.hpp>
 
+#include <cstring>
+#include <iterator>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 using namespace vfspp;
@@ -51,6 +55,159 @@ TEST(PhysicalEntryTest, OpenRead)
 	}
 }
 
+TEST(PhysicalEntryTest, TryOpen)
+{
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system/test1.txt");
+
+		boost::shared_ptr<std::streambuf> buffer;
+		ASSERT_EQ(STATUS_OK, fs.getRootEntry()->tryOpen(IFileSystemEntry::MODE_READ | IFileSystemEntry::MODE_MEMORY_MAPPED, buffer));
+
+		std::istream stream(buffer.get());
+
+		std::string content;
+		content.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+		ASSERT_STREQ("TestTestTest", content.c_str());
+	}
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system/test1.txt");
+		fs.setAllowedOperations(0);
+
+		boost::shared_ptr<std::streambuf> buffer;
+		ASSERT_EQ(STATUS_NOT_SUPPORTED, fs.getRootEntry()->tryOpen(IFileSystemEntry::MODE_READ, buffer));
+		ASSERT_FALSE(buffer);
+	}
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
+
+		boost::shared_ptr<std::streambuf> buffer;
+		ASSERT_EQ(STATUS_NOT_FILE, fs.getRootEntry()->tryOpen(IFileSystemEntry::MODE_READ, buffer));
+
+		FileEntryPointer child;
+		ASSERT_EQ(STATUS_OK, fs.getRootEntry()->tryGetChild("test1.txt", child));
+		ASSERT_TRUE(child.get() != NULL);
+
+		ASSERT_EQ(STATUS_NOT_FOUND, fs.getRootEntry()->tryGetChild("foo.txt", child));
+		ASSERT_FALSE(child);
+
+		ASSERT_EQ(STATUS_NOT_DIRECTORY, fs.getRootEntry()->getChild("test1.txt")->tryGetChild("foo.txt", child));
+	}
+}
+
+TEST(PhysicalEntryTest, ReadAt)
+{
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system/test1.txt");
+
+		PhysicalEntry* rootDir = fs.getRootEntry();
+
+		char buffer[16] = {};
+
+		ASSERT_EQ(4, rootDir->readAt(4, buffer, 4));
+		ASSERT_STREQ("Test", buffer);
+
+		// Reads are clamped at the end of the file
+		ASSERT_EQ(2, rootDir->readAt(10, buffer, sizeof(buffer)));
+		ASSERT_EQ(0, std::memcmp("st", buffer, 2));
+
+		ASSERT_EQ(0, rootDir->readAt(100, buffer, sizeof(buffer)));
+	}
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system/test1.txt");
+		fs.setAllowedOperations(0);
+
+		char buffer[4];
+
+		ASSERT_THROW(fs.getRootEntry()->readAt(0, buffer, sizeof(buffer)), vfspp::InvalidOperationException);
+	}
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
+
+		char buffer[4];
+
+		ASSERT_THROW(fs.getRootEntry()->readAt(0, buffer, sizeof(buffer)), vfspp::InvalidOperationException);
+	}
+}
+
+#ifndef WIN32
+namespace
+{
+	size_t countOpenFiles()
+	{
+		return std::distance(filesystem::directory_iterator("/proc/self/fd"), filesystem::directory_iterator());
+	}
+}
+
+TEST(PhysicalEntryTest, ReadAtHandleLimit)
+{
+	PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
+
+	size_t openFiles = countOpenFiles();
+
+	std::vector<FileEntryPointer> entries;
+	for (size_t i = 0; i < PhysicalFileSystem::MaxReadHandles * 3; ++i)
+	{
+		entries.push_back(fs.getRootEntry()->getChild("test1.txt"));
+
+		char buffer[4] = {};
+
+		ASSERT_EQ(4, entries.back()->readAt(4, buffer, sizeof(buffer)));
+		ASSERT_EQ(0, std::memcmp("Test", buffer, 4));
+	}
+
+	ASSERT_LE(countOpenFiles(), openFiles + PhysicalFileSystem::MaxReadHandles);
+
+	entries.clear();
+
+	ASSERT_EQ(openFiles, countOpenFiles());
+}
+#endif
+
+TEST(PhysicalEntryTest, GetView)
+{
+	FileView view;
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system/test1.txt");
+
+		ASSERT_TRUE(fs.getRootEntry()->getView(view));
+	}
+
+	// The mapping is kept open by the view
+	ASSERT_EQ("TestTestTest", std::string(view.begin(), view.end()));
+
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
+
+		ASSERT_THROW(fs.getRootEntry()->getView(view), vfspp::InvalidOperationException);
+	}
+}
+
+TEST(PhysicalEntryTest, Stat)
+{
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system/test1.txt");
+
+		EntryStat info = fs.getRootEntry()->stat();
+
+		ASSERT_EQ(vfspp::FILE, info.type);
+		ASSERT_EQ(12, info.size);
+		ASSERT_EQ(fs.getRootEntry()->lastWriteTime(), info.writeTime);
+		ASSERT_FALSE(info.hasPackedSize);
+		ASSERT_FALSE(info.hasCrc);
+	}
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system");
+
+		ASSERT_EQ(vfspp::DIRECTORY, fs.getRootEntry()->stat().type);
+	}
+	{
+		PhysicalFileSystem fs(TEST_RESOURCE_DIR "/system/doesnotexist.txt");
+
+		ASSERT_EQ(vfspp::UNKNOWN, fs.getRootEntry()->stat().type);
+	}
+}
+
 TEST(PhysicalEntryTest, OpenWrite)
 {
 	using namespace boost::filesystem;